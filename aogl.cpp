@@ -7,6 +7,7 @@
 #include <string>
 #include <iostream>
 #include <vector>
+#include <algorithm>
 
 #include <cmath>
 
@@ -24,6 +25,32 @@
 #include "glm/gtc/matrix_transform.hpp" // glm::translate, glm::rotate, glm::scale, glm::perspective
 #include "glm/gtc/type_ptr.hpp" // glm::value_ptr
 
+#include "instances.h"
+#include "vertexpulling.h"
+#include "mesh.h"
+#include "meshbatch.h"
+#include "meshfile.h"
+#include "objimport.h"
+#include "meshopt.h"
+#include "meshlet.h"
+#include "depthpyramid.h"
+#include "renderqueue.h"
+#include "threadpool.h"
+#include "textureloader.h"
+#include "texturestream.h"
+#include "uploader.h"
+#include "texturearray.h"
+#include "virtualtexture.h"
+#include "programcache.h"
+#include "shaderreload.h"
+#include "shadersource.h"
+#include "glstate.h"
+#include "uniformring.h"
+#include "framegraph.h"
+#include "commandlist.h"
+#include "jobsystem.h"
+#include "framearena.h"
+
 #ifndef DEBUG_PRINT
 #define DEBUG_PRINT 1
 #endif
@@ -51,6 +78,7 @@ int check_link_error(GLuint program);
 int check_compile_error(GLuint shader, const char ** sourceBuffer);
 GLuint compile_shader(GLenum shaderType, const char * sourceBuffer, int bufferSize);
 GLuint compile_shader_from_file(GLenum shaderType, const char * fileName);
+GLuint build_program(ProgramCache & cache, std::vector< std::pair<std::string, GLuint> > & shaders, const ProgramStage * stages, int stageCount);
 
 // OpenGL utils
 bool checkError(const char* title);
@@ -108,20 +136,128 @@ struct SpotLight
     }
 };
 
-struct UniformCamera
+// Point lights of a frame, turning on circles, each one is computed on its own so chunks
+// of them can be recorded by different jobs
+struct PointLightParams
 {
-    glm::vec3 _pos;
-    int _padding;
-    glm::mat4 _screenToWorld;
-    glm::mat4 _viewToWorld;
+    float time;
+    float xOffset;
+    float zOffset;
+    float radius; // of the first circle, the next ones are 3 larger
+    float y;
+    float intensity;
+    float attenuation;
+    int count;
+};
 
-    UniformCamera(glm::vec3 pos, glm::mat4 screenToWorld, glm::mat4 viewToWorld){
-        _pos = pos;
-        _screenToWorld = screenToWorld;
-        _viewToWorld = viewToWorld;
+// Light pass commands recorded in a job : the point lights [pointBegin, pointEnd) when
+// points is set, lightCount lights of lightSize bytes from lights otherwise
+struct LightRecording
+{
+    CommandList list; // in the frame arena
+    FrameArena * arena;
+    GLuint program;
+    GLuint vao; // full screen quad
+    GLuint ubo; // Light block
+    GLsizei indexCount;
+    const PointLightParams * points;
+    int pointBegin;
+    int pointEnd;
+    const void * lights;
+    size_t lightSize;
+    int lightCount;
+};
+void record_lights(void * user);
+
+// Per draw data of the geometry pass, indexed by gl_DrawID. Layers and handles are
+// only read with --texture-arrays, the virtual rect with --virtual-texture.
+struct Material
+{
+    glm::vec4 _diffuseColor;
+    float _specularPower;
+    int _diffuseLayer;
+    int _specularLayer;
+    int _padding;
+    GLuint64 _diffuseHandle;
+    GLuint64 _specularHandle; //48
+    glm::vec4 _virtualRect; //64
+
+    Material(glm::vec3 diffuseColor = glm::vec3(1,1,1), float specularPower = 20){
+        _diffuseColor = glm::vec4(diffuseColor, 1);
+        _specularPower = specularPower;
+        _diffuseLayer = _specularLayer = 0;
+        _padding = 0;
+        _diffuseHandle = _specularHandle = 0;
+        _virtualRect = glm::vec4(0, 0, 1, 1);
     }
 };
 
+// How the geometry pass finds the material textures, must match aogl.frag
+enum MaterialTextureMode
+{
+    MATERIAL_TEXTURES_BOUND = 0, // Diffuse and Specular bound before the draws
+    MATERIAL_TEXTURES_ARRAY = 1, // layers of the arrays bound once to the MATERIAL_*_ARRAY_UNIT
+    MATERIAL_TEXTURES_BINDLESS = 2, // layers of the arrays whose handles are in the material
+    MATERIAL_TEXTURES_VIRTUAL = 3 // the virtual rect of the material, pages bound once to the VIRTUAL_*_UNIT
+};
+
+// The G-buffer stays bound to these for every light pass
+enum GBufferUnit
+{
+    GBUFFER_COLOR_UNIT = 8,
+    GBUFFER_NORMAL_UNIT = 9,
+    GBUFFER_DEPTH_UNIT = 10
+};
+
+// Must match MAX_MATERIALS in shaders/tp2/aogl.frag
+const int MATERIAL_MAX = 256;
+
+// Uniform buffer binding points of the Light, Frame and Materials blocks
+enum UniformBinding
+{
+    LIGHT_BINDING_POINT = 0,
+    FRAME_BINDING_POINT = 1,
+    MATERIAL_BINDING_POINT = 2
+};
+
+// Attribute, vertex pulling and depth pre-pass programs share the same uniforms
+const int GEOMETRY_PROGRAM_COUNT = 3;
+const int GEOMETRY_PROGRAMS[GEOMETRY_PROGRAM_COUNT] = {0, 6, 7};
+
+// Locations of the uniforms the frame loop sets, queried again when a program is reloaded
+struct ProgramLocations
+{
+    GLint drawIdOffset[GEOMETRY_PROGRAM_COUNT];
+    GLint rigid[GEOMETRY_PROGRAM_COUNT];
+    GLint pullMesh;
+    GLint instanceOffset;
+};
+
+// Uniforms the programs are given once, at startup and after a reload
+struct ProgramSettings
+{
+    int textureMode; // MaterialTextureMode
+    int virtualPages; // 0 without virtual texturing
+    int virtualLevels;
+    int cachePages;
+};
+void setup_program(const GLuint * programObject, int index, const ProgramSettings & settings, ProgramLocations & locations);
+
+// Frame block of shaders/tp2/frame.glsl, std140 (288 bytes)
+struct UniformFrame
+{
+    glm::mat4 _mvp;
+    glm::mat4 _mv;
+    glm::mat4 _mvInverse;
+    glm::mat4 _screenToWorld; //256
+    glm::vec3 _cameraPosition;
+    float _time; //272
+    float _slider;
+    float _sliderMult;
+    int _instanceNumber;
+    int _padding; //288
+};
+
 struct Camera
 {
     float radius;
@@ -164,6 +300,88 @@ int main( int argc, char **argv )
 
     float fps = 0.f;
 
+    // Command line options
+    bool vertexBenchmark = false;
+    bool vertexPulling = false;
+    bool depthPrepass = false;
+    bool frontToBack = false;
+    const char * scenePath = 0;
+    bool meshletCulling = false;
+    size_t textureBudget = 0;
+    bool uploadThread = false;
+    bool textureArrays = false;
+    const char * virtualTexturePath = 0;
+    bool programCacheEnabled = true;
+    bool shaderReloading = true;
+    bool pinThreads = false;
+    bool jobProfiling = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--bench-vertex") == 0)
+            vertexBenchmark = true;
+        else if (strcmp(argv[i], "--vertex-pulling") == 0)
+            vertexPulling = true;
+        else if (strcmp(argv[i], "--depth-prepass") == 0)
+            depthPrepass = true;
+        else if (strcmp(argv[i], "--front-to-back") == 0)
+            frontToBack = true;
+        else if (strcmp(argv[i], "--mesh") == 0 && i + 1 < argc)
+            scenePath = argv[++i];
+        else if (strcmp(argv[i], "--meshlet-cull") == 0)
+            meshletCulling = true;
+        else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+            textureBudget = size_t(atof(argv[++i]) * 1024. * 1024.);
+        else if (strcmp(argv[i], "--upload-thread") == 0)
+            uploadThread = true;
+        else if (strcmp(argv[i], "--texture-arrays") == 0)
+            textureArrays = true;
+        else if (strcmp(argv[i], "--virtual-texture") == 0 && i + 1 < argc)
+            virtualTexturePath = argv[++i];
+        else if (strcmp(argv[i], "--no-program-cache") == 0)
+            programCacheEnabled = false;
+        else if (strcmp(argv[i], "--no-shader-reload") == 0)
+            shaderReloading = false;
+        else if (strcmp(argv[i], "--pin-threads") == 0)
+            pinThreads = true;
+        else if (strcmp(argv[i], "--job-profile") == 0)
+            jobProfiling = true;
+    }
+
+    // Texture arrays and the virtual texture replace the per texture loading paths
+    if (virtualTexturePath)
+        textureArrays = false;
+    if (textureArrays || virtualTexturePath)
+    {
+        textureBudget = 0;
+        uploadThread = false;
+    }
+    // The stream uploads its mip levels on the render thread, the uploader would sit idle
+    if (textureBudget > 0)
+        uploadThread = false;
+
+    // CPU work of the frame and the texture decodes, with --pin-threads this thread keeps core 0
+    JobSystem jobs;
+    job_system_init(jobs, -1, pinThreads);
+    if (pinThreads && !job_system_pin_thread(0))
+        fprintf(stderr, "Jobs : can not pin the render thread\n");
+    job_system_set_profiling(jobs, jobProfiling);
+    // File reads block, they stay on their own threads
+    ThreadPool workers;
+    thread_pool_init(workers, 0);
+
+    // Start decoding textures right away, they are uploaded once the GL objects are built
+    TextureLoader textureLoader;
+    texture_loader_init(textureLoader, workers, jobs);
+    // With --texture-budget the cooked textures are streamed by mip level instead
+    bool textureStreaming = textureBudget > 0;
+    int diffuseRequest = -1;
+    int specularRequest = -1;
+    if (!textureStreaming && !textureArrays && !virtualTexturePath)
+    {
+        diffuseRequest = texture_loader_request(textureLoader, "textures/spnza_bricks_a_diff.tga", 3);
+        specularRequest = texture_loader_request(textureLoader, "textures/spnza_bricks_a_spec.tga", 1);
+    }
+
     // Initialise GLFW
     if( !glfwInit() )
     {
@@ -209,6 +427,11 @@ int main( int argc, char **argv )
           exit( EXIT_FAILURE );
     }
 
+    // Texture uploads on a second context and thread, the render loop picks them up when ready
+    Uploader uploader;
+    if (uploadThread)
+        uploadThread = uploader_init(uploader, window);
+
     // Ensure we can capture the escape key being pressed below
     glfwSetInputMode( window, GLFW_STICKY_KEYS, GL_TRUE );
 
@@ -223,81 +446,117 @@ int main( int argc, char **argv )
         exit(EXIT_FAILURE);
     }
 
-    GLuint vertShaderId[3];
-    GLuint fragShaderId[6];
-    GLuint programObject[6];
+    // Programs come from the binary cache, only the misses are compiled and linked
+    ProgramCache programCache;
+    program_cache_init(programCache, "programcache", programCacheEnabled);
+    std::vector< std::pair<std::string, GLuint> > shaders;
+    GLuint programObject[10];
+    // Programs rebuilt when their files change, the compute ones only if built
+    ShaderReload shaderReload;
+    shader_reload_init(shaderReload, &programCache);
+    // The wave of the demo never changes, its parameters are folded in the variant of aogl.geom
+    // the geometry programs use. Programs that need to change them would use another variant
+    // with some of them left out, read from uniforms instead.
+    const char * waveConstants = "VISCOSITY=0.0 CURVE=-15.0 INTENSITY=50.0 FREQUENCY=4.0 SPEED=4.0";
 
     // -------------------- Shader0 for Geometry, Normals, and so on
-    vertShaderId[0] = compile_shader_from_file(GL_VERTEX_SHADER, "shaders/tp2/aogl.vert");
-    fragShaderId[0] = compile_shader_from_file(GL_FRAGMENT_SHADER, "shaders/tp2/aogl.frag");
-    GLuint geomShaderId = compile_shader_from_file(GL_GEOMETRY_SHADER, "shaders/tp2/aogl.geom");
-    programObject[0] = glCreateProgram();
-    glAttachShader(programObject[0], vertShaderId[0]);
-    glAttachShader(programObject[0], geomShaderId);
-    glAttachShader(programObject[0], fragShaderId[0]);
-    glLinkProgram(programObject[0]);
-    if (check_link_error(programObject[0]) < 0)
+    ProgramStage geometryStages[] = {{GL_VERTEX_SHADER, "shaders/tp2/aogl.vert", 0}, {GL_GEOMETRY_SHADER, "shaders/tp2/aogl.geom", waveConstants},
+                                     {GL_FRAGMENT_SHADER, "shaders/tp2/aogl.frag", 0}};
+    programObject[0] = build_program(programCache, shaders, geometryStages, 3);
+    if (!programObject[0])
         exit(1);
+    shader_reload_add(shaderReload, 0, geometryStages, 3);
 
     // -------------------- Shader1 for Debug Drawing
-
-    vertShaderId[1] = compile_shader_from_file(GL_VERTEX_SHADER, "shaders/tp2/blit.vert");
-    fragShaderId[1] = compile_shader_from_file(GL_FRAGMENT_SHADER, "shaders/tp2/blit.frag");
-    programObject[1] = glCreateProgram();
-    glAttachShader(programObject[1], vertShaderId[1]);
-    glAttachShader(programObject[1], fragShaderId[1]);
-    glLinkProgram(programObject[1]);
-    if (check_link_error(programObject[1]) < 0)
+    ProgramStage blitStages[] = {{GL_VERTEX_SHADER, "shaders/tp2/blit.vert", 0}, {GL_FRAGMENT_SHADER, "shaders/tp2/blit.frag", 0}};
+    programObject[1] = build_program(programCache, shaders, blitStages, 2);
+    if (!programObject[1])
         exit(1);
+    shader_reload_add(shaderReload, 1, blitStages, 2);
 
     // -------------------- Shader2 for Point Light
-    fragShaderId[2] = compile_shader_from_file(GL_FRAGMENT_SHADER, "shaders/tp2/pointLight.frag");
-    programObject[2] = glCreateProgram();
-    glAttachShader(programObject[2], vertShaderId[1]);
-    glAttachShader(programObject[2], fragShaderId[2]);
-    glLinkProgram(programObject[2]);
-    if (check_link_error(programObject[2]) < 0)
+    ProgramStage pointLightStages[] = {{GL_VERTEX_SHADER, "shaders/tp2/blit.vert", 0}, {GL_FRAGMENT_SHADER, "shaders/tp2/pointLight.frag", 0}};
+    programObject[2] = build_program(programCache, shaders, pointLightStages, 2);
+    if (!programObject[2])
         exit(1);
+    shader_reload_add(shaderReload, 2, pointLightStages, 2);
 
     // -------------------- Shader3 for Directionnal Light
-    fragShaderId[3] = compile_shader_from_file(GL_FRAGMENT_SHADER, "shaders/tp2/directionnalLight.frag");
-    programObject[3] = glCreateProgram();
-    glAttachShader(programObject[3], vertShaderId[1]);
-    glAttachShader(programObject[3], fragShaderId[3]);
-    glLinkProgram(programObject[3]);
-    if (check_link_error(programObject[3]) < 0)
+    ProgramStage directionnalLightStages[] = {{GL_VERTEX_SHADER, "shaders/tp2/blit.vert", 0}, {GL_FRAGMENT_SHADER, "shaders/tp2/directionnalLight.frag", 0}};
+    programObject[3] = build_program(programCache, shaders, directionnalLightStages, 2);
+    if (!programObject[3])
         exit(1);
+    shader_reload_add(shaderReload, 3, directionnalLightStages, 2);
 
     // -------------------- Shader4 for Spot Light
-    fragShaderId[4] = compile_shader_from_file(GL_FRAGMENT_SHADER, "shaders/tp2/spotLight.frag");
-    programObject[4] = glCreateProgram();
-    glAttachShader(programObject[4], vertShaderId[1]);
-    glAttachShader(programObject[4], fragShaderId[4]);
-    glLinkProgram(programObject[4]);
-    if (check_link_error(programObject[4]) < 0)
+    ProgramStage spotLightStages[] = {{GL_VERTEX_SHADER, "shaders/tp2/blit.vert", 0}, {GL_FRAGMENT_SHADER, "shaders/tp2/spotLight.frag", 0}};
+    programObject[4] = build_program(programCache, shaders, spotLightStages, 2);
+    if (!programObject[4])
         exit(1);
+    shader_reload_add(shaderReload, 4, spotLightStages, 2);
 
     // -------------------- Shader5 for Debug Shapes
+    ProgramStage debugStages[] = {{GL_VERTEX_SHADER, "shaders/tp2/debug.vert", 0}, {GL_FRAGMENT_SHADER, "shaders/tp2/debug.frag", 0}};
+    programObject[5] = build_program(programCache, shaders, debugStages, 2);
+    if (!programObject[5])
+        exit(1);
+    shader_reload_add(shaderReload, 5, debugStages, 2);
+
+    // -------------------- Shader6 for Geometry with vertex pulling
+    ProgramStage pullStages[] = {{GL_VERTEX_SHADER, "shaders/tp2/aogl_pull.vert", 0}, {GL_GEOMETRY_SHADER, "shaders/tp2/aogl.geom", waveConstants},
+                                 {GL_FRAGMENT_SHADER, "shaders/tp2/aogl.frag", 0}};
+    programObject[6] = build_program(programCache, shaders, pullStages, 3);
+    if (!programObject[6])
+        exit(1);
+    shader_reload_add(shaderReload, 6, pullStages, 3);
 
-    vertShaderId[2] = compile_shader_from_file(GL_VERTEX_SHADER, "shaders/tp2/debug.vert");
-    fragShaderId[5] = compile_shader_from_file(GL_FRAGMENT_SHADER, "shaders/tp2/debug.frag");
-    programObject[5] = glCreateProgram();
-    glAttachShader(programObject[5], vertShaderId[2]);
-    glAttachShader(programObject[5], fragShaderId[5]);
-    glLinkProgram(programObject[5]);
-    if (check_link_error(programObject[5]) < 0)
+    // -------------------- Shader7 for Depth Pre-pass
+    ProgramStage depthStages[] = {{GL_VERTEX_SHADER, "shaders/tp2/depth.vert", 0}, {GL_GEOMETRY_SHADER, "shaders/tp2/aogl.geom", waveConstants},
+                                  {GL_FRAGMENT_SHADER, "shaders/tp2/depth.frag", 0}};
+    programObject[7] = build_program(programCache, shaders, depthStages, 3);
+    if (!programObject[7])
         exit(1);
-    
+    shader_reload_add(shaderReload, 7, depthStages, 3);
+
+    // -------------------- Shader8 and Shader9 for Meshlet Culling and the Depth Pyramid
+    programObject[8] = programObject[9] = 0;
+    if (meshletCulling && !meshlet_culling_supported())
+    {
+        fprintf(stderr, "Meshlet culling needs compute shaders (GL 4.3), disabled\n");
+        meshletCulling = false;
+    }
+    if (meshletCulling)
+    {
+        ProgramStage cullStages[] = {{GL_COMPUTE_SHADER, "shaders/tp2/meshlet_cull.comp", 0}};
+        programObject[8] = build_program(programCache, shaders, cullStages, 1);
+        if (!programObject[8])
+            exit(1);
+        shader_reload_add(shaderReload, 8, cullStages, 1);
+
+        ProgramStage pyramidStages[] = {{GL_COMPUTE_SHADER, "shaders/tp2/depth_pyramid.comp", 0}};
+        programObject[9] = build_program(programCache, shaders, pyramidStages, 1);
+        if (!programObject[9])
+            exit(1);
+        shader_reload_add(shaderReload, 9, pyramidStages, 1);
+    }
+
+    // The programs keep the shaders they were linked with
+    for (size_t i = 0; i < shaders.size(); ++i)
+        glDeleteShader(shaders[i].second);
+    program_cache_report(programCache);
+    if (shaderReloading)
+        shaderReloading = shader_reload_watch(shaderReload, "shaders");
+
     // Viewport 
     glViewport( 0, 0, width, height );
 
     // Create Vao & vbo -------------------------------------------------------------------------------------------------------------------------------
 
-    GLuint vao[4];
-    glGenVertexArrays(4, vao);
+    GLuint vao[3];
+    glGenVertexArrays(3, vao);
  
-    GLuint vbo[12];
-    glGenBuffers(12, vbo);
+    GLuint vbo[4];
+    glGenBuffers(4, vbo);
 
     // Create Cube -------------------------------------------------------------------------------------------------------------------------------
     int cube_triangleCount = 12;
@@ -306,37 +565,8 @@ int main( int argc, char **argv )
     float cube_vertices[] = {-0.5, -0.5, 0.5, 0.5, -0.5, 0.5, -0.5, 0.5, 0.5, 0.5, 0.5, 0.5, -0.5, 0.5, 0.5, 0.5, 0.5, 0.5, -0.5, 0.5, -0.5, 0.5, 0.5, -0.5, -0.5, 0.5, -0.5, 0.5, 0.5, -0.5, -0.5, -0.5, -0.5, 0.5, -0.5, -0.5, -0.5, -0.5, -0.5, 0.5, -0.5, -0.5, -0.5, -0.5, 0.5, 0.5, -0.5, 0.5, 0.5, -0.5, 0.5, 0.5, -0.5, -0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5, -0.5, -0.5, -0.5, -0.5, -0.5, -0.5, 0.5, -0.5, 0.5, -0.5, -0.5, 0.5, -0.5, -0.5, -0.5, 0.5, -0.5, 0.5, 0.5 };
     float cube_normals[] = {0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, }; 
  
-    // Bind the VAO
-    glBindVertexArray(vao[0]);
- 
-    // Bind indices and upload data
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo[0]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_triangleList), cube_triangleList, GL_STATIC_DRAW);
- 
-    // Bind vertices and upload data
-    glBindBuffer(GL_ARRAY_BUFFER, vbo[1]);
-    glEnableVertexAttribArray(0); 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT)*3, (void*)0);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertices), cube_vertices, GL_STATIC_DRAW);
- 
-    // Bind normals and upload data
-    glBindBuffer(GL_ARRAY_BUFFER, vbo[2]);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT)*3, (void*)0);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cube_normals), cube_normals, GL_STATIC_DRAW);
- 
-    // Bind uv coords and upload data
-    glBindBuffer(GL_ARRAY_BUFFER, vbo[3]);
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT)*2, (void*)0);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cube_uvs), cube_uvs, GL_STATIC_DRAW);
- 
-    // Unbind everything
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-    
+    MeshData cube_data;
+    mesh_data_from_arrays(cube_data, cube_vertices, cube_normals, cube_uvs, 27, cube_triangleList, cube_triangleCount * 3);
 
     // Create Plane -------------------------------------------------------------------------------------------------------------------------------
 
@@ -347,63 +577,268 @@ int main( int argc, char **argv )
     float plane_vertices[] = {-5.0, 0, 5.0, 5.0, 0, 5.0, -5.0, 0, -5.0, 5.0, 0, -5.0};
     float plane_normals[] = {0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0};
 
-    // Bind the VAO
-    glBindVertexArray(vao[1]);
- 
-    // Bind indices and upload data
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo[4]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(plane_triangleList), plane_triangleList, GL_STATIC_DRAW);
- 
-    // Bind vertices and upload data
-    glBindBuffer(GL_ARRAY_BUFFER, vbo[5]);
-    glEnableVertexAttribArray(0); 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT)*3, (void*)0);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(plane_vertices), plane_vertices, GL_STATIC_DRAW);
- 
-    // Bind normals and upload data
-    glBindBuffer(GL_ARRAY_BUFFER, vbo[6]);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT)*3, (void*)0);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(plane_normals), plane_normals, GL_STATIC_DRAW);
- 
-    // Bind uv coords and upload data
-    glBindBuffer(GL_ARRAY_BUFFER, vbo[7]);
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT)*2, (void*)0);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(plane_uvs), plane_uvs, GL_STATIC_DRAW);
- 
-    // Unbind everything
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    MeshData plane_data;
+    mesh_data_from_arrays(plane_data, plane_vertices, plane_normals, plane_uvs, 4, plane_triangleList, plane_triangleCount * 3);
 
+    // Create Instances -------------------------------------------------------------------------------------------------------------------------------
+
+    float instanceNumber = 25000;
 
+    InstanceBuffer instanceBuffer;
+    instance_buffer_init(instanceBuffer, int(instanceNumber) + 1);
+    // Cubes sit on the ground, stored by chunks so they can be drawn front to back
+    std::vector<InstanceChunk> cube_chunks;
+    size_t cube_firstInstance = instances_add_grid_chunks(instanceBuffer, int(instanceNumber), glm::vec3(0, 0.5, 0), 1, 0, 32, cube_chunks);
+    size_t plane_instance = instance_buffer_add(instanceBuffer, Instance(glm::vec3(0, 0, 0), 10));
+    instance_buffer_upload(instanceBuffer);
+
+    // Upload Meshes -------------------------------------------------------------------------------------------------------------------------------
+
+    // Every static mesh shares one interleaved vertex buffer and one index buffer, the
+    // smallest attribute formats and index type valid for all of them are picked at load
+    bool quantizeVertices = true;
+    bool drawPlane = false;
+
+    std::vector<const MeshData *> batchMeshes;
+    batchMeshes.push_back(&cube_data);
+    batchMeshes.push_back(&plane_data);
+    const char * batchMeshNames[] = {"cube", "plane"};
+
+    MeshBatch geometryBatch;
+    mesh_batch_init(geometryBatch, batchMeshes, quantizeVertices);
+    // One draw per chunk of cubes
+    int cube_draw = int(geometryBatch.commands.size());
+    for(size_t i = 0; i < cube_chunks.size(); ++i)
+        mesh_batch_add_draw(geometryBatch, 0, cube_chunks[i].count, cube_chunks[i].first);
+    int plane_draw = mesh_batch_add_draw(geometryBatch, 1, drawPlane ? 1 : 0, plane_instance);
+    mesh_batch_upload(geometryBatch);
+
+    // The batch fetches placements from the instance stream
+    instance_buffer_bind_attributes(instanceBuffer, geometryBatch.vao);
+
+    mesh_batch_print(geometryBatch, batchMeshNames);
+
+    // One material per draw
+    std::vector<Material> drawMaterials;
+    for(size_t i = 0; i < cube_chunks.size(); ++i)
+        drawMaterials.push_back(Material(glm::vec3(1,1,1), 20));
+    drawMaterials.push_back(Material(glm::vec3(1,1,1), 20));
+
+    // Scene Mesh -------------------------------------------------------------------------------------------------------------------------------
+
+    // Optional mesh given with --mesh, either a cooked .aogm file uploaded straight from
+    // its mapping or an .obj parsed, optimized and packed at startup
+    Mesh scene_mesh;
+    bool drawScene = false;
+    int scene_draw = int(drawMaterials.size());
+    float scene_uvDensity = 0.f;
+    size_t scene_instance = 0;
+    std::vector<Meshlet> scene_meshlets;
+    if (scenePath)
+    {
+        double loadStart = glfwGetTime();
+        size_t pathLength = strlen(scenePath);
+        if (pathLength > 4 && strcmp(scenePath + pathLength - 4, ".obj") == 0)
+        {
+            MeshData scene_data;
+            if (obj_load(scenePath, scene_data))
+            {
+                mesh_optimize(scene_data);
+                mesh_init(scene_mesh, scene_data, quantizeVertices);
+                scene_uvDensity = mesh_data_uv_density(scene_data);
+                if (meshletCulling)
+                    meshlets_build(scene_data, scene_meshlets);
+                drawScene = true;
+            }
+        }
+        else
+        {
+            MeshFileView view;
+            if (mesh_file_map(view, scenePath))
+            {
+                mesh_init_packed(scene_mesh, view.header->format, view.header->indexType,
+                                 view.vertices, view.header->vertexCount, view.indices, view.header->indexCount);
+                scene_meshlets.assign(view.meshlets, view.meshlets + view.header->meshletCount);
+                scene_uvDensity = view.header->uvDensity;
+                mesh_file_unmap(view);
+                drawScene = true;
+            }
+        }
+
+        if (drawScene)
+        {
+            // glFinish so the time includes the upload and not only the api calls
+            glFinish();
+            fprintf(stdout, "Scene %s loaded in %.2f ms\n", scenePath, (glfwGetTime() - loadStart) * 1000.);
+            mesh_print_format(scenePath, scene_mesh, 1);
+
+            scene_instance = instance_buffer_add(instanceBuffer, Instance(glm::vec3(0, 0, 0), 1));
+            instance_buffer_upload(instanceBuffer);
+            instance_buffer_bind_attributes(instanceBuffer, scene_mesh.vao);
+            drawMaterials.push_back(Material(glm::vec3(1,1,1), 20));
+        }
+    }
+
+    // Meshlet Culling -------------------------------------------------------------------------------------------------------------------------------
+
+    // The scene mesh is culled by meshlets in a compute pass, against the frustum, the
+    // normal cones and, when the depth pre-pass runs, a depth pyramid of the batch
+    MeshletCuller scene_culler;
+    DepthPyramid depthPyramid;
+    bool cullScene = drawScene && meshletCulling && !scene_meshlets.empty();
+    if (cullScene)
+    {
+        meshlet_culler_init(scene_culler, scene_mesh, scene_meshlets, programObject[8], GLuint(scene_instance));
+        instance_buffer_bind_attributes(instanceBuffer, scene_culler.vao);
+        depth_pyramid_init(depthPyramid, width, height, programObject[9]);
+        fprintf(stdout, "Scene : %d meshlets\n", scene_culler.meshletCount);
+    }
+
+    // Chunk draw order, sorted front to back every frame when enabled
+    std::vector<std::pair<float, int> > cube_chunkOrder(cube_chunks.size());
+
+    // Vertex Pulling -------------------------------------------------------------------------------------------------------------------------------
+
+    // With --vertex-pulling the cube is generated from gl_VertexID and everything else is
+    // fetched from texture buffers, vao[2] stays empty as the core profile needs one bound.
+    // Off by default, the batch draws the same in a single indirect call.
+
+    GLuint instanceTexture = pull_instance_texture_create(instanceBuffer.buffer);
+
+    // Render Queue -------------------------------------------------------------------------------------------------------------------------------
+
+    // Geometry pass draws, rebuilt every frame. The binds a submission does are counted
+    // in push order and after the sort.
+    RenderQueue geometryQueue;
+    RenderQueueStats queueStats[2] = {{0, 0, 0}, {0, 0, 0}};
+
+    // Overdraw Measure -------------------------------------------------------------------------------------------------------------------------------
+
+    // Samples passed in the depth pre-pass and in the G-buffer pass, read back every overdrawPeriod frames
+    GLuint overdrawQueries[2];
+    glGenQueries(2, overdrawQueries);
+    int overdrawFrame = 0;
+    const int overdrawPeriod = 300;
+
+    // Vertex Fetch Benchmark -------------------------------------------------------------------------------------------------------------------------------
+
+    // Alternate the quantized batch with a float one and time the geometry draw on the gpu
+    MeshBatch geometryBatchFloat;
+    GLuint benchmarkQuery;
+    glGenQueries(1, &benchmarkQuery);
+    int benchmarkFrame = 0;
+    const int benchmarkPeriod = 240;
+    double benchmarkTime[2] = {0, 0};
+    int benchmarkSamples[2] = {0, 0};
+    if (vertexBenchmark)
+    {
+        mesh_batch_init(geometryBatchFloat, batchMeshes, false);
+        geometryBatchFloat.commands = geometryBatch.commands;
+        mesh_batch_upload(geometryBatchFloat);
+        instance_buffer_bind_attributes(instanceBuffer, geometryBatchFloat.vao);
+        vertexPulling = false;
+    }
+
+    PulledMesh plane_pulled;
+    pulled_mesh_init(plane_pulled, plane_vertices, plane_normals, plane_uvs, 4, plane_triangleList, plane_triangleCount * 3);
 
     // My GL Textures -------------------------------------------------------------------------------------------------------------------------------
 
-    int x;
-    int y;
-    int comp;
-    unsigned char * diffuse = stbi_load("textures/spnza_bricks_a_diff.tga", &x, &y, &comp, 3);
-    unsigned char * specular = stbi_load("textures/spnza_bricks_a_spec.tga", &x, &y, &comp, 3);
-
-    GLuint texture[2];
-    glGenTextures(2, texture);
-    glBindTexture(GL_TEXTURE_2D, texture[0]);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, x, y, 0, GL_RGB, GL_UNSIGNED_BYTE, diffuse);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    glBindTexture(GL_TEXTURE_2D, texture[1]);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, x, y, 0, GL_RGB, GL_UNSIGNED_BYTE, specular);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    // Streamed textures start with their coarse tail only and change every frame
+    TextureStream textureStream;
+    texture_stream_init(textureStream, workers, textureBudget);
+    GLuint texture[2] = {0, 0};
+    int streamedTexture[2] = {-1, -1};
+    // Material arrays, each material picks its layers, nothing is bound per draw
+    int materialTextureMode = MATERIAL_TEXTURES_BOUND;
+    TextureArraySet diffuseArrays;
+    TextureArraySet specularArrays;
+    // Virtual texture, VRAM stays the same whatever the number of materials
+    VirtualTexture virtualTexture;
+    virtualTexture.file.header = 0;
+    const int virtualCachePages = 16;
+    if (virtualTexturePath)
+    {
+        if (virtual_texture_init(virtualTexture, workers, virtualTexturePath, virtualCachePages, width, height))
+        {
+            materialTextureMode = MATERIAL_TEXTURES_VIRTUAL;
+            glActiveTexture(GL_TEXTURE0 + VIRTUAL_PAGE_TABLE_UNIT);
+            glBindTexture(GL_TEXTURE_2D, virtualTexture.pageTable);
+            glActiveTexture(GL_TEXTURE0 + VIRTUAL_DIFFUSE_CACHE_UNIT);
+            glBindTexture(GL_TEXTURE_2D, virtualTexture.caches[VT_DIFFUSE]);
+            glActiveTexture(GL_TEXTURE0 + VIRTUAL_SPECULAR_CACHE_UNIT);
+            glBindTexture(GL_TEXTURE_2D, virtualTexture.caches[VT_SPECULAR]);
+            glActiveTexture(GL_TEXTURE0);
+            // As with the arrays, the cubes get the first material, the plane and the scene the second one if any
+            int materialCount = int(virtualTexture.file.header->materialCount);
+            for (size_t i = 0; i < drawMaterials.size(); ++i)
+                drawMaterials[i]._virtualRect = virtual_texture_rect(virtualTexture, i < cube_chunks.size() ? 0 : std::min(1, materialCount - 1));
+        }
+        else
+        {
+            fprintf(stderr, "Virtual texture : can not load %s, drawing untextured\n", virtualTexturePath);
+        }
+    }
+    bool virtualTexturing = materialTextureMode == MATERIAL_TEXTURES_VIRTUAL;
+    if (textureArrays)
+    {
+        // The cubes keep the first bricks, the plane and the scene get the second ones
+        TextureArraySlot diffuseSlots[2] = {texture_array_set_add(diffuseArrays, "textures/spnza_bricks_a_diff.ktx"),
+                                            texture_array_set_add(diffuseArrays, "textures/spnza_bricks_b_diff.ktx")};
+        TextureArraySlot specularSlot = texture_array_set_add(specularArrays, "textures/spnza_bricks_a_spec.ktx");
+        bool bindless = GLEW_ARB_bindless_texture != 0;
+        texture_array_set_build(diffuseArrays, bindless);
+        texture_array_set_build(specularArrays, bindless);
+
+        if (diffuseSlots[0].array < 0 || diffuseSlots[1].array < 0 || specularSlot.array < 0)
+            fprintf(stderr, "Texture arrays : missing cooked textures, drawing untextured\n");
+        else if (bindless)
+            materialTextureMode = MATERIAL_TEXTURES_BINDLESS;
+        else if (diffuseArrays.arrays.size() == 1 && specularArrays.arrays.size() == 1)
+            materialTextureMode = MATERIAL_TEXTURES_ARRAY;
+        else
+            fprintf(stderr, "Texture arrays : textures of different formats need GL_ARB_bindless_texture, drawing untextured\n");
+
+        if (materialTextureMode == MATERIAL_TEXTURES_ARRAY)
+        {
+            glActiveTexture(GL_TEXTURE0 + MATERIAL_DIFFUSE_ARRAY_UNIT);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, diffuseArrays.arrays[0].texture);
+            glActiveTexture(GL_TEXTURE0 + MATERIAL_SPECULAR_ARRAY_UNIT);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, specularArrays.arrays[0].texture);
+            glActiveTexture(GL_TEXTURE0);
+        }
+        if (materialTextureMode != MATERIAL_TEXTURES_BOUND)
+        {
+            for (size_t i = 0; i < drawMaterials.size(); ++i)
+            {
+                const TextureArraySlot & diffuse = diffuseSlots[i < cube_chunks.size() ? 0 : 1];
+                drawMaterials[i]._diffuseLayer = diffuse.layer;
+                drawMaterials[i]._specularLayer = specularSlot.layer;
+                drawMaterials[i]._diffuseHandle = diffuseArrays.arrays[diffuse.array].handle;
+                drawMaterials[i]._specularHandle = specularArrays.arrays[specularSlot.array].handle;
+            }
+        }
+    }
+    else if (textureStreaming)
+    {
+        streamedTexture[0] = texture_stream_add(textureStream, "textures/spnza_bricks_a_diff.ktx");
+        streamedTexture[1] = texture_stream_add(textureStream, "textures/spnza_bricks_a_spec.ktx");
+    }
+    else if (uploadThread)
+    {
+        texture_loader_attach(textureLoader, uploader);
+    }
+    else
+    {
+        texture_loader_upload(textureLoader);
+        texture[0] = texture_loader_texture(textureLoader, diffuseRequest);
+        texture[1] = texture_loader_texture(textureLoader, specularRequest);
+    }
+    int texturesPending = uploadThread ? int(textureLoader.requests.size()) : 0;
+
+    // Texel density of each textured mesh, divided by the instance scale when used
+    float cube_uvDensity = mesh_data_uv_density(cube_data);
+    float plane_uvDensity = mesh_data_uv_density(plane_data);
 
     // My Lights -------------------------------------------------------------------------------------------------------------------------------
 
@@ -425,116 +860,69 @@ int main( int argc, char **argv )
 
     // My Uniforms -------------------------------------------------------------------------------------------------------------------------------
 
-    // ---------------------- For Geometry Shading
-    GLuint mvpLocation = glGetUniformLocation(programObject[0], "MVP");
-    GLuint mvLocation = glGetUniformLocation(programObject[0], "MV");
-
-    GLuint mvInverseLocation = glGetUniformLocation(programObject[1], "MVInverse");
-
     float t = 0;
-    GLuint timeLocation = glGetUniformLocation(programObject[0], "Time");
-
     float SliderValue = 0.3;
-    GLuint sliderLocation = glGetUniformLocation(programObject[0], "Slider");
-
     float SliderMult = 80;
-    GLuint sliderMultLocation = glGetUniformLocation(programObject[0], "SliderMult");   
-
-    float specularPower = 20;
-    GLuint specularPowerLocation = glGetUniformLocation(programObject[0], "SpecularPower");
 
-    GLuint diffuseLocation = glGetUniformLocation(programObject[0], "Diffuse");
-    glProgramUniform1i(programObject[0], diffuseLocation, 0);
+    ProgramSettings programSettings;
+    programSettings.textureMode = materialTextureMode;
+    programSettings.virtualPages = virtualTexturing ? int(virtualTexture.file.header->pages) : 0;
+    programSettings.virtualLevels = virtualTexturing ? int(virtualTexture.file.header->levelCount) : 0;
+    programSettings.cachePages = virtualCachePages;
 
-    GLuint specularLocation = glGetUniformLocation(programObject[0], "Specular");
-    glProgramUniform1i(programObject[0], specularLocation, 1);
-
-    float instanceNumber = 25000;
-    GLuint instanceNumberLocation = glGetUniformLocation(programObject[0], "InstanceNumber");
-    glProgramUniform1i(programObject[0], instanceNumberLocation, int(instanceNumber));
+    ProgramLocations locations;
+    for(int i = 0; i < 8; ++i)
+        setup_program(programObject, i, programSettings, locations);
 
     if (!checkError("Uniforms"))
         exit(1);
 
-    // ---------------------- For Light Pass Shading
-
-    for(int i = 2; i < 5; ++i){
-        GLuint colorBufferLocation = glGetUniformLocation(programObject[i], "ColorBuffer");
-        glProgramUniform1i(programObject[i], colorBufferLocation, 0);
-
-        GLuint normalBufferLocation = glGetUniformLocation(programObject[i], "NormalBuffer");
-        glProgramUniform1i(programObject[i], normalBufferLocation, 1);
-
-        GLuint depthBufferLocation = glGetUniformLocation(programObject[i], "DepthBuffer");
-        glProgramUniform1i(programObject[i], depthBufferLocation, 2);
-    }
-
-    if (!checkError("Uniforms"))
-        exit(1);
 
-    // ---------------------- For Debug Shading
-
-    GLuint mvpDebugLocation = glGetUniformLocation(programObject[5], "MVP");
-
-    if (!checkError("Uniforms"))
-        exit(1);
-
-
-    // My FBO -------------------------------------------------------------------------------------------------------------------------------
-
-    // Framebuffer object handle
-    GLuint gbufferFbo;
-    // Texture handles
-    GLuint gbufferTextures[3];
-    glGenTextures(3, gbufferTextures);
-    // 2 draw buffers for color and normal
-    GLuint gbufferDrawBuffers[2];
-
-    // Create color texture
-    glBindTexture(GL_TEXTURE_2D, gbufferTextures[0]);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    // Create normal texture
-    glBindTexture(GL_TEXTURE_2D, gbufferTextures[1]);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_FLOAT, 0);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    // Create depth texture
-    glBindTexture(GL_TEXTURE_2D, gbufferTextures[2]);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    // Create Framebuffer Object
-    glGenFramebuffers(1, &gbufferFbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, gbufferFbo);
-    // Initialize DrawBuffers
-    gbufferDrawBuffers[0] = GL_COLOR_ATTACHMENT0;
-    gbufferDrawBuffers[1] = GL_COLOR_ATTACHMENT1;
-    glDrawBuffers(2, gbufferDrawBuffers);
-
-    // Attach textures to framebuffer
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gbufferTextures[0], 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gbufferTextures[1], 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gbufferTextures[2], 0);
-
-    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    // Frame Graph -------------------------------------------------------------------------------------------------------------------------------
+
+    // The G-buffer targets are transients of the graph, a new pass declares what it reads and writes
+    FrameGraph frameGraph;
+    frame_graph_init(frameGraph);
+    FrameGraphTextureDesc gbufferColorDesc = {width, height, GL_RGBA8};
+    FrameGraphTextureDesc gbufferDepthDesc = {width, height, GL_DEPTH_COMPONENT24};
+    int gbufferColor = frame_graph_create_texture(frameGraph, "gbuffer color", gbufferColorDesc);
+    int gbufferNormal = frame_graph_create_texture(frameGraph, "gbuffer normal", gbufferColorDesc);
+    int gbufferDepth = frame_graph_create_texture(frameGraph, "gbuffer depth", gbufferDepthDesc);
+    int backBuffer = frame_graph_import_texture(frameGraph, "back buffer", 0);
+
+    // Depth pre-pass, scene culling and geometry, color and normal then the virtual texture feedback
+    int gbufferPass = frame_graph_add_pass(frameGraph, "gbuffer");
+    frame_graph_write(frameGraph, gbufferPass, gbufferColor);
+    frame_graph_write(frameGraph, gbufferPass, gbufferNormal);
+    if(virtualTexturing)
+        frame_graph_write(frameGraph, gbufferPass, frame_graph_import_texture(frameGraph, "virtual feedback", virtualTexture.feedbackTexture));
+    frame_graph_write(frameGraph, gbufferPass, gbufferDepth);
+
+    int lightPass = frame_graph_add_pass(frameGraph, "lights");
+    frame_graph_read(frameGraph, lightPass, gbufferColor);
+    frame_graph_read(frameGraph, lightPass, gbufferNormal);
+    frame_graph_read(frameGraph, lightPass, gbufferDepth);
+    frame_graph_write(frameGraph, lightPass, backBuffer);
+
+    if(!frame_graph_compile(frameGraph))
     {
         fprintf(stderr, "Error on building framebuffer\n");
         exit( EXIT_FAILURE );
     }
+    frame_graph_report(frameGraph);
 
-    // Back to the default framebuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLuint gbufferFbo = frame_graph_framebuffer(frameGraph, gbufferPass);
+    GLuint gbufferTextures[3];
+    gbufferTextures[0] = frame_graph_texture(frameGraph, gbufferColor);
+    gbufferTextures[1] = frame_graph_texture(frameGraph, gbufferNormal);
+    gbufferTextures[2] = frame_graph_texture(frameGraph, gbufferDepth);
+
+    // The light passes sample the G-buffer from units nothing else binds, once for all
+    for(int i = 0; i < 3; ++i){
+        glActiveTexture(GL_TEXTURE0 + GBUFFER_COLOR_UNIT + i);
+        glBindTexture(GL_TEXTURE_2D, gbufferTextures[i]);
+    }
+    glActiveTexture(GL_TEXTURE0);
 
     // Create Quad for FBO -------------------------------------------------------------------------------------------------------------------------------
 
@@ -543,12 +931,12 @@ int main( int argc, char **argv )
     float quad_vertices[] =  {-1.0, -1.0, 1.0, -1.0, -1.0, 1.0, 1.0, 1.0};
 
     // Quad
-    glBindVertexArray(vao[2]);
+    glBindVertexArray(vao[0]);
     // Bind indices and upload data
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo[8]);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo[0]);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(quad_triangleList), quad_triangleList, GL_STATIC_DRAW);
     // Bind vertices and upload data
-    glBindBuffer(GL_ARRAY_BUFFER, vbo[9]);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo[1]);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT)*2, (void*)0);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vertices), quad_vertices, GL_STATIC_DRAW);
@@ -574,12 +962,12 @@ int main( int argc, char **argv )
                              };
 
     // Quad
-    glBindVertexArray(vao[3]);
+    glBindVertexArray(vao[1]);
     // Bind indices and upload data
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo[10]);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo[2]);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(debug_triangleList), debug_triangleList, GL_STATIC_DRAW);
     // Bind vertices and upload data
-    glBindBuffer(GL_ARRAY_BUFFER, vbo[11]);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo[3]);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT)*3, (void*)0);
     glBufferData(GL_ARRAY_BUFFER, sizeof(debug_vertices), debug_vertices, GL_STATIC_DRAW);
@@ -590,20 +978,14 @@ int main( int argc, char **argv )
 
     // Create UBO For Light Structures -------------------------------------------------------------------------------------------------------------------------------
 
-    // Create two ubo for light and camera
+    // Create two ubo for light and materials, the frame constants go through a ring
     GLuint ubo[2];
     glGenBuffers(2, ubo);
 
-    // LIGHT
-    GLuint PointLightUniformIndex = glGetUniformBlockIndex(programObject[2], "Light");
-    GLuint DirectionnalLightUniformIndex = glGetUniformBlockIndex(programObject[3], "Light");
-    GLuint SpotLightUniformIndex = glGetUniformBlockIndex(programObject[4], "Light");
+    // The programs bind their blocks to these points in setup_program
 
-    GLuint LightBindingPoint = 0;
-      
-    glUniformBlockBinding(programObject[2], PointLightUniformIndex, LightBindingPoint);
-    glUniformBlockBinding(programObject[3], DirectionnalLightUniformIndex, LightBindingPoint);
-    glUniformBlockBinding(programObject[4], SpotLightUniformIndex, LightBindingPoint);
+    // LIGHT
+    GLuint LightBindingPoint = LIGHT_BINDING_POINT;
 
     glBindBuffer(GL_UNIFORM_BUFFER, ubo[0]);
     glBufferData(GL_UNIFORM_BUFFER, sizeof(SpotLight), 0, GL_DYNAMIC_DRAW);
@@ -611,22 +993,34 @@ int main( int argc, char **argv )
 
     glBindBufferRange(GL_UNIFORM_BUFFER, LightBindingPoint, ubo[0], 0, sizeof(SpotLight));
 
-    // CAM
-    GLuint CamUniformIndex1 = glGetUniformBlockIndex(programObject[2], "Camera");
-    GLuint CamUniformIndex2 = glGetUniformBlockIndex(programObject[3], "Camera");
-    GLuint CamUniformIndex3 = glGetUniformBlockIndex(programObject[4], "Camera");
+    // FRAME, bound to its slot each frame
+    UniformRing frameRing;
+    uniform_ring_init(frameRing, sizeof(UniformFrame));
 
-    GLuint CameraBindingPoint = 1;
-      
-    glUniformBlockBinding(programObject[2], CamUniformIndex1, CameraBindingPoint);
-    glUniformBlockBinding(programObject[3], CamUniformIndex2, CameraBindingPoint);
-    glUniformBlockBinding(programObject[4], CamUniformIndex3, CameraBindingPoint);
+    // MATERIALS
+    GLuint MaterialBindingPoint = MATERIAL_BINDING_POINT;
 
     glBindBuffer(GL_UNIFORM_BUFFER, ubo[1]);
-    glBufferData(GL_UNIFORM_BUFFER, sizeof(UniformCamera), 0, GL_DYNAMIC_DRAW);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(Material) * MATERIAL_MAX, 0, GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Material) * drawMaterials.size(), &drawMaterials[0]);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
-    glBindBufferRange(GL_UNIFORM_BUFFER, CameraBindingPoint, ubo[1], 0, sizeof(UniformCamera));
+    glBindBufferRange(GL_UNIFORM_BUFFER, MaterialBindingPoint, ubo[1], 0, sizeof(Material) * MATERIAL_MAX);
+
+    // Light Commands ----------------------------------------------------------------------------------------------------------------------
+
+    // Recorded by jobs each frame, replayed in this order by the light pass
+    const int POINT_LIGHT_CHUNK_COUNT = 4;
+    const int LIGHT_RECORDING_COUNT = POINT_LIGHT_CHUNK_COUNT + 2;
+    LightRecording lightRecordings[LIGHT_RECORDING_COUNT];
+    JobCounter lightRecording;
+    job_counter_init(lightRecording);
+
+    // Transient data of the frame, the light commands for now
+    const size_t FRAME_ARENA_BYTES = 1024 * 1024;
+    FrameArena frameArena;
+    frame_arena_init(frameArena, FRAME_ARENA_BYTES);
+    PointLightParams pointLightParams;
 
     // Viewer Structures ----------------------------------------------------------------------------------------------------------------------
     Camera camera;
@@ -648,10 +1042,34 @@ int main( int argc, char **argv )
     //*********************************************************************************************
     //***************************************** MAIN LOOP *****************************************
     //*********************************************************************************************
+    // Binds and states of the frame loop go through the cache, calls into the modules that
+    // set state themselves are followed by an invalidation
+    GlState glState;
+    gl_state_init(glState);
+    GlStateStats glStateStats = {0, 0};
+
+    std::vector<int> reloadedPrograms;
     do
     {
         t = glfwGetTime();
 
+        // Programs rebuilt since last frame replace the old ones before anything is drawn
+        if(shaderReloading){
+            reloadedPrograms.clear();
+            shader_reload_update(shaderReload, programObject, reloadedPrograms);
+            for(size_t i = 0; i < reloadedPrograms.size(); ++i){
+                int index = reloadedPrograms[i];
+                if(index < 8)
+                    setup_program(programObject, index, programSettings, locations);
+                else if(index == 8 && cullScene)
+                    meshlet_culler_set_program(scene_culler, programObject[8]);
+                else if(index == 9 && cullScene)
+                    depth_pyramid_set_program(depthPyramid, programObject[9]);
+            }
+            if(!reloadedPrograms.empty())
+                gl_state_invalidate(glState);
+        }
+
         // Mouse states
         int leftButton = glfwGetMouseButton( window, GLFW_MOUSE_BUTTON_LEFT );
         int rightButton = glfwGetMouseButton( window, GLFW_MOUSE_BUTTON_RIGHT );
@@ -729,30 +1147,148 @@ int main( int argc, char **argv )
         glm::mat4 mv = worldToView * objectToWorld;
         glm::mat4 mvInverse = glm::inverse(mv);
 
+        // The texture loader, streaming and virtual texturing bind textures on the active unit
+        bool texturesUpdated = texturesPending > 0 || textureStreaming || virtualTexturing;
+
+        // Textures from the upload thread, drawn untextured until they arrive
+        if(texturesPending > 0){
+            texturesPending = texture_loader_poll(textureLoader);
+            texture[0] = texture_loader_texture(textureLoader, diffuseRequest);
+            texture[1] = texture_loader_texture(textureLoader, specularRequest);
+        }
+
+        // Texture streaming : every draw samples both textures, the nearest surface of each
+        // draw gives the finest level it needs
+        if(textureStreaming){
+            float pixelsPerRadian = heightf / glm::radians(45.f);
+            // Nearest point of the cube chunks, 32 x 32 cubes of size 1 standing on the ground
+            float cubeDistance = 1e30f;
+            for(size_t i = 0; i < cube_chunks.size(); ++i){
+                glm::vec3 extent(16.f, 0.5f, 16.f);
+                glm::vec3 nearest = glm::clamp(camera.eye, cube_chunks[i].center - extent, cube_chunks[i].center + extent);
+                cubeDistance = std::min(cubeDistance, glm::distance(camera.eye, nearest));
+            }
+            for(int k = 0; k < 2; ++k){
+                if(streamedTexture[k] < 0)
+                    continue;
+                int level = texture_stream_level_for(textureStream, streamedTexture[k], cube_uvDensity, cubeDistance, pixelsPerRadian);
+                if(drawPlane){
+                    const Instance & plane = instanceBuffer.instances[plane_instance];
+                    float distance = std::fabs(camera.eye.y - plane._pos.y);
+                    level = std::min(level, texture_stream_level_for(textureStream, streamedTexture[k], plane_uvDensity / plane._scale, distance, pixelsPerRadian));
+                }
+                if(drawScene){
+                    // The distance to the instance, the scene bounds are not kept
+                    float distance = glm::distance(camera.eye, instanceBuffer.instances[scene_instance]._pos);
+                    level = std::min(level, texture_stream_level_for(textureStream, streamedTexture[k], scene_uvDensity, distance, pixelsPerRadian));
+                }
+                texture_stream_use(textureStream, streamedTexture[k], level);
+            }
+            texture_stream_update(textureStream);
+            for(int k = 0; k < 2; ++k)
+                texture[k] = streamedTexture[k] < 0 ? 0 : texture_stream_texture(textureStream, streamedTexture[k]);
+        }
+
+        // Virtual texture : pages asked by the feedback of a few frames ago
+        if(virtualTexturing)
+            virtual_texture_update(virtualTexture);
+
         //****************************************** RENDER *******************************************
 
+        if(texturesUpdated)
+            gl_state_invalidate(glState);
+
         // Default states
-        glEnable(GL_DEPTH_TEST);
+        gl_state_enable(glState, GL_DEPTH_TEST, true);
         // Clear the front buffer
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Select shader
-        glUseProgram(programObject[0]);
-
         //-------------------------------------Upload Uniforms
 
-        glProgramUniformMatrix4fv(programObject[0], mvpLocation, 1, 0, glm::value_ptr(mvp));
-        glProgramUniformMatrix4fv(programObject[5], mvpDebugLocation, 1, 0, glm::value_ptr(mvp));
-        glProgramUniformMatrix4fv(programObject[0], mvLocation, 1, 0, glm::value_ptr(mv));
-        glProgramUniformMatrix4fv(programObject[1], mvInverseLocation, 1, 0, glm::value_ptr(mvInverse));
+        // One upload for every program of the frame, geometry, debug, blit and light passes
+        UniformFrame frame;
+        frame._mvp = mvp;
+        frame._mv = mv;
+        frame._mvInverse = mvInverse;
+        frame._screenToWorld = glm::inverse(mvp);
+        frame._cameraPosition = camera.eye;
+        frame._time = t;
+        frame._slider = SliderValue;
+        frame._sliderMult = SliderMult;
+        frame._instanceNumber = int(instanceNumber);
+        frame._padding = 0;
+        GLintptr frameOffset = uniform_ring_push(frameRing, &frame);
+        gl_state_bind_buffer_range(glState, GL_UNIFORM_BUFFER, FRAME_BINDING_POINT, frameRing.buffer, frameOffset, sizeof(UniformFrame));
+
+        //-------------------------------------Record Light Commands
+
+        // Jobs record the light passes while this thread draws the G-buffer
+        frame_arena_begin_frame(frameArena);
+        pointLightParams.time = t;
+        pointLightParams.xOffset = glm::sqrt(float(instanceNumber))/2;
+        pointLightParams.zOffset = glm::sqrt(float(instanceNumber))/2;
+        pointLightParams.radius = sqrt(pointLightParams.xOffset*2 + pointLightParams.zOffset*2);
+        pointLightParams.y = pointLightsYOffset;
+        pointLightParams.intensity = lightIntensity;
+        pointLightParams.attenuation = lightAttenuation;
+        pointLightParams.count = 30;
+
+        spotLights[0]._pos = camera.eye;
 
-        // Upload value
-        glProgramUniform1f(programObject[0], timeLocation, t);
-        glProgramUniform1f(programObject[0], sliderLocation, SliderValue);
-        glProgramUniform1f(programObject[0], sliderMultLocation, SliderMult);
+        for(int i = 0; i < LIGHT_RECORDING_COUNT; ++i){
+            LightRecording & recording = lightRecordings[i];
+            recording.arena = &frameArena;
+            recording.vao = vao[0];
+            recording.ubo = ubo[0];
+            recording.indexCount = quad_triangleCount * 3;
+            recording.points = 0;
+            recording.pointBegin = recording.pointEnd = 0;
+            recording.lights = 0;
+            recording.lightSize = 0;
+            recording.lightCount = 0;
+            if(i < POINT_LIGHT_CHUNK_COUNT){
+                recording.program = programObject[2];
+                recording.points = &pointLightParams;
+                recording.pointBegin = pointLightParams.count * i / POINT_LIGHT_CHUNK_COUNT;
+                recording.pointEnd = pointLightParams.count * (i + 1) / POINT_LIGHT_CHUNK_COUNT;
+            }
+            else if(i == POINT_LIGHT_CHUNK_COUNT){
+                recording.program = programObject[3];
+                recording.lights = directionnalLights.empty() ? 0 : &directionnalLights[0];
+                recording.lightSize = sizeof(Light);
+                recording.lightCount = int(directionnalLights.size());
+            }
+            else{
+                recording.program = programObject[4];
+                recording.lights = spotLights.empty() ? 0 : &spotLights[0];
+                recording.lightSize = sizeof(SpotLight);
+                recording.lightCount = int(spotLights.size());
+            }
+            job_system_run(jobs, "record lights", record_lights, &recording, &lightRecording);
+        }
 
-        glProgramUniform1f(programObject[0], specularPowerLocation,specularPower);
-        glProgramUniform1i(programObject[0], instanceNumberLocation, int(instanceNumber));
+        // Send the instances edited since last frame
+        instance_buffer_upload(instanceBuffer);
+
+        // Coarse front to back order : nearest chunk first, the cubes of a chunk keep their order.
+        // Every cube chunk has the same material so the per draw materials do not move.
+        // The float batch of the benchmark gets the same order so both halves have the same overdraw.
+        if(frontToBack){
+            for(size_t i = 0; i < cube_chunks.size(); ++i)
+                cube_chunkOrder[i] = std::make_pair(glm::distance(camera.eye, cube_chunks[i].center), int(i));
+            std::sort(cube_chunkOrder.begin(), cube_chunkOrder.end());
+            for(size_t i = 0; i < cube_chunks.size(); ++i){
+                const InstanceChunk & chunk = cube_chunks[cube_chunkOrder[i].second];
+                DrawElementsIndirectCommand & command = mesh_batch_edit_draw(geometryBatch, cube_draw + int(i));
+                command.instanceCount = GLuint(chunk.count);
+                command.baseInstance = GLuint(chunk.first);
+                if(vertexBenchmark)
+                    mesh_batch_edit_draw(geometryBatchFloat, cube_draw + int(i)) = command;
+            }
+            mesh_batch_upload(geometryBatch);
+            if(vertexBenchmark)
+                mesh_batch_upload(geometryBatchFloat);
+        }
 
         //******************************************************* FIRST PASS
 
@@ -761,116 +1297,240 @@ int main( int argc, char **argv )
         glBindFramebuffer(GL_FRAMEBUFFER, gbufferFbo);
         // Clear the gbuffer
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // glClear is undefined on integer buffers, the feedback is cleared on its own
+        if(virtualTexturing){
+            GLuint noPage[4] = {VIRTUAL_FEEDBACK_NONE, 0, 0, 0};
+            glClearBufferuiv(GL_COLOR, 2, noPage);
+        }
 
-        //-------------------------------------Render Cubes
-
-        glBindVertexArray(vao[0]);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture[1]);
-        glDrawElementsInstanced(GL_TRIANGLES, cube_triangleCount * 3, GL_UNSIGNED_INT, (void*)0, int(instanceNumber));
-
-        //-------------------------------------Render Plane
-
-//        glProgramUniform1i(programObject[0], instanceNumberLocation, -1);
-//
-//        glBindVertexArray(vao[1]);
-//        glActiveTexture(GL_TEXTURE0);
-//        glBindTexture(GL_TEXTURE_2D, texture[0]);
-//        glActiveTexture(GL_TEXTURE1);
-//        glBindTexture(GL_TEXTURE_2D, texture[1]);
-//        glDrawElements(GL_TRIANGLES, plane_triangleCount * 3, GL_UNSIGNED_INT, (void*)0);
-//        glBindTexture(GL_TEXTURE_2D, 0);
-
-        //-------------------------------------Unbind the frambuffer
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        //******************************************************* SECOND PASS
-
-        //-------------------------------------Light Draw
-
-        // Set a full screen viewport
-        glViewport( 0, 0, width, height );
-
-        // Disable the depth test
-        glDisable(GL_DEPTH_TEST);
-        // Enable blending
-        glEnable(GL_BLEND);
-        // Setup additive blending
-        glBlendFunc(GL_ONE, GL_ONE);
-
-        // Update Camera pos and screenToWorld matrix to all light shaders
-        UniformCamera cam(camera.eye, glm::inverse(mvp), mvInverse);
-
-        glBindBuffer(GL_UNIFORM_BUFFER, ubo[1]);
-        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(UniformCamera), &cam);
-        glBindBuffer(GL_UNIFORM_BUFFER, 0); 
+        //-------------------------------------Depth Pre-pass
+
+        // Only for the batch, the vertex pulling path draws directly
+        bool prepass = depthPrepass && !vertexPulling;
+
+        MeshletCullParams sceneCullParams;
+        if(cullScene){
+            const Instance & instance = instanceBuffer.instances[scene_instance];
+            sceneCullParams.worldToView = worldToView;
+            sceneCullParams.projection = projection;
+            sceneCullParams.cameraPosition = camera.eye;
+            sceneCullParams.instanceTransform = glm::vec4(instance._pos, instance._scale);
+            sceneCullParams.instanceRotation = instance._rotation;
+            sceneCullParams.coneCulling = true;
+            sceneCullParams.depthPyramid = 0;
+            // Without the pre-pass there is no depth yet this frame, cull before the G-buffer pass
+            if(!prepass){
+                meshlet_culler_cull(scene_culler, sceneCullParams);
+                gl_state_invalidate(glState);
+            }
+        }
+        if(prepass){
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            gl_state_use_program(glState, programObject[7]);
+            glBeginQuery(GL_SAMPLES_PASSED, overdrawQueries[0]);
+            gl_state_bind_vertex_array(glState, geometryBatch.vao);
+            mesh_batch_submit(geometryBatch, programObject[7], -1);
+            if(cullScene){
+                // The batch depth is the occluder of the scene meshlets
+                depth_pyramid_build(depthPyramid, gbufferTextures[2], width, height);
+                sceneCullParams.depthPyramid = &depthPyramid;
+                meshlet_culler_cull(scene_culler, sceneCullParams);
+                gl_state_invalidate(glState);
+                gl_state_use_program(glState, programObject[7]);
+            }
+            if(drawScene){
+                glProgramUniform1i(programObject[7], locations.rigid[2], 1);
+                if(cullScene){
+                    meshlet_culler_draw(scene_culler);
+                    gl_state_invalidate(glState);
+                }
+                else{
+                    gl_state_bind_vertex_array(glState, scene_mesh.vao);
+                    glDrawElementsInstancedBaseInstance(GL_TRIANGLES, scene_mesh.indexCount, scene_mesh.indexType, 0, 1, GLuint(scene_instance));
+                }
+                glProgramUniform1i(programObject[7], locations.rigid[2], 0);
+            }
+            glEndQuery(GL_SAMPLES_PASSED);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
-        //------------------------------------ Point Lights
+            // Only the nearest fragment of each pixel gets shaded
+            gl_state_depth_func(glState, GL_EQUAL);
+            gl_state_depth_mask(glState, false);
+        }
 
-        // point light shaders
-        glUseProgram(programObject[2]);
+        //-------------------------------------Render Cubes
 
-        // Bind quad vao
-        glBindVertexArray(vao[2]);
-        
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, gbufferTextures[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, gbufferTextures[1]);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, gbufferTextures[2]);
+        glBeginQuery(GL_SAMPLES_PASSED, overdrawQueries[1]);
 
-        unsigned int nbLightsByCircle[] = {6, 12, 18, 24, 30, 36, 42, 48, 54, 60, 66, 72, 78};
-        int counterCircle = 0;
-        unsigned int nbPointLights = 30;
-        float xOffset = glm::sqrt(float(instanceNumber))/2;
-        float zOffset = glm::sqrt(float(instanceNumber))/2;
+        if(vertexPulling){
+            gl_state_bind_texture(glState, 0, GL_TEXTURE_2D, texture[0]);
+            gl_state_bind_texture(glState, 1, GL_TEXTURE_2D, texture[1]);
 
-        float rayon = sqrt(xOffset*2 + zOffset*2);
+            gl_state_use_program(glState, programObject[6]);
+            gl_state_bind_vertex_array(glState, vao[2]);
+            gl_state_bind_texture(glState, PULL_INSTANCES_UNIT, GL_TEXTURE_BUFFER, instanceTexture);
 
+            glProgramUniform1i(programObject[6], locations.pullMesh, 0);
+            glProgramUniform1i(programObject[6], locations.instanceOffset, int(cube_firstInstance));
+            glProgramUniform1i(programObject[6], locations.drawIdOffset[1], cube_draw);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, PULL_CUBE_VERTEX_COUNT, int(instanceNumber));
 
-        int cptVisiblePointLight = 0;
+            if(drawPlane){
+                pulled_mesh_bind(plane_pulled);
+                gl_state_invalidate(glState);
+                glProgramUniform1i(programObject[6], locations.pullMesh, 1);
+                glProgramUniform1i(programObject[6], locations.instanceOffset, int(plane_instance));
+                glProgramUniform1i(programObject[6], locations.drawIdOffset[1], plane_draw);
+                glDrawArraysInstanced(GL_TRIANGLES, 0, plane_pulled.indexCount, 1);
+            }
+        }
 
-        std::vector<Light> lights;
+        // Every attribute path draw goes through the queue, sorted by state
+        render_queue_clear(geometryQueue);
+        int benchmarkFloat = vertexBenchmark ? (benchmarkFrame / benchmarkPeriod) % 2 : 0;
+        if(!vertexPulling){
+            // Cubes and plane in a single indirect draw
+            RenderDraw draw = RenderDraw();
+            draw.type = RENDER_DRAW_BATCH;
+            draw.batch = benchmarkFloat ? &geometryBatchFloat : &geometryBatch;
+            draw.program = programObject[0];
+            draw.vao = draw.batch->vao;
+            draw.textures[0] = texture[0];
+            draw.textures[1] = texture[1];
+            draw.drawIdLocation = locations.drawIdOffset[0];
+            draw.rigidLocation = locations.rigid[0];
+            draw.rigid = 0;
+            // The batch spans the whole grid, it has no meaningful depth
+            render_queue_push(geometryQueue, RENDER_PASS_GBUFFER, draw, 0.f);
+        }
+        if(drawScene){
+            RenderDraw draw = RenderDraw();
+            draw.type = cullScene ? RENDER_DRAW_INDIRECT : RENDER_DRAW_ELEMENTS;
+            draw.program = programObject[0];
+            draw.vao = cullScene ? scene_culler.vao : scene_mesh.vao;
+            draw.textures[0] = texture[0];
+            draw.textures[1] = texture[1];
+            draw.drawIdLocation = locations.drawIdOffset[0];
+            draw.drawId = scene_draw;
+            draw.rigidLocation = locations.rigid[0];
+            draw.rigid = 1;
+            draw.indexType = cullScene ? GL_UNSIGNED_INT : scene_mesh.indexType;
+            draw.count = scene_mesh.indexCount;
+            draw.instanceCount = 1;
+            draw.baseInstance = GLuint(scene_instance);
+            draw.indirectBuffer = cullScene ? scene_culler.buffers[2] : 0;
+            render_queue_push(geometryQueue, RENDER_PASS_GBUFFER, draw, glm::distance(camera.eye, instanceBuffer.instances[scene_instance]._pos));
+        }
+        queueStats[0] = render_queue_stats(geometryQueue);
+        render_queue_sort(geometryQueue);
+        queueStats[1] = render_queue_stats(geometryQueue);
+
+        // With --mesh the scene draw is timed along with the batch
+        if(vertexBenchmark)
+            glBeginQuery(GL_TIME_ELAPSED, benchmarkQuery);
+
+        render_queue_submit(geometryQueue, glState);
+
+        if(vertexBenchmark){
+            glEndQuery(GL_TIME_ELAPSED);
+            // Waiting on the result only stalls the cpu, the measured gpu time is unaffected
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(benchmarkQuery, GL_QUERY_RESULT, &elapsed);
+            // Skip the first frames of each period to let the pipeline settle
+            if(benchmarkFrame % benchmarkPeriod > 10){
+                benchmarkTime[benchmarkFloat] += elapsed * 1e-6;
+                ++benchmarkSamples[benchmarkFloat];
+            }
+            ++benchmarkFrame;
+            if(benchmarkFrame % (2 * benchmarkPeriod) == 0){
+                double packedTime = benchmarkTime[0] / benchmarkSamples[0];
+                double floatTime = benchmarkTime[1] / benchmarkSamples[1];
+                fprintf(stdout, "Vertex fetch : quantized %d bytes %.3f ms, float %d bytes %.3f ms (%.1f%% faster)\n",
+                        geometryBatch.format.stride, packedTime, geometryBatchFloat.format.stride, floatTime,
+                        100. * (floatTime - packedTime) / floatTime);
+            }
+        }
 
-        for(size_t i = 0; i < nbPointLights; ++i){
+        glEndQuery(GL_SAMPLES_PASSED);
 
-            Light light(glm::vec3(0,0,0), glm::vec3(1,1,1), lightIntensity, lightAttenuation);
+        if(prepass){
+            gl_state_depth_func(glState, GL_LESS);
+            gl_state_depth_mask(glState, true);
+        }
 
-            if( i == nbLightsByCircle[counterCircle] ){
-              counterCircle++;
-              rayon += 3; 
-            } 
+        //-------------------------------------Overdraw
+
+        if(++overdrawFrame % overdrawPeriod == 0){
+            GLuint shadedSamples = 0;
+            glGetQueryObjectuiv(overdrawQueries[1], GL_QUERY_RESULT, &shadedSamples);
+            float pixels = widthf * heightf;
+            if(prepass){
+                // The pre-pass sees the overdraw the G-buffer pass would have had without it
+                GLuint depthSamples = 0;
+                glGetQueryObjectuiv(overdrawQueries[0], GL_QUERY_RESULT, &depthSamples);
+                fprintf(stdout, "Overdraw : %.2f samples per pixel without pre-pass, %.2f shaded with pre-pass%s\n",
+                        depthSamples / pixels, shadedSamples / pixels, frontToBack ? " (front to back)" : "");
+            }
+            else{
+                fprintf(stdout, "Overdraw : %.2f shaded samples per pixel%s\n",
+                        shadedSamples / pixels, frontToBack ? " (front to back)" : "");
+            }
+            fprintf(stdout, "Render queue : %d items, binds unsorted %d programs %d vaos %d textures, sorted %d programs %d vaos %d textures\n",
+                    int(geometryQueue.items.size()),
+                    queueStats[0].programs, queueStats[0].vaos, queueStats[0].textures,
+                    queueStats[1].programs, queueStats[1].vaos, queueStats[1].textures);
+            fprintf(stdout, "GL state : %d calls issued, %d redundant ones elided last frame\n", glStateStats.issued, glStateStats.elided);
+            if(jobProfiling)
+                job_system_report(jobs);
+            FrameArenaStats arenaStats = frame_arena_stats(frameArena);
+            fprintf(stdout, "Frame arena : %.1f KB used and %.1f KB on the heap last frame, %.1f KB at most, %.1f KB per frame, %d allocations overflowed\n",
+                    arenaStats.used / 1024., arenaStats.overflowBytes / 1024., arenaStats.highWater / 1024., arenaStats.capacity / 1024., arenaStats.overflows);
+            if(textureStreaming){
+                TextureStreamStats streamStats = texture_stream_stats(textureStream);
+                fprintf(stdout, "Texture streaming : %.2f of %.2f MB resident, %d levels streamed in, %d evicted\n",
+                        streamStats.residentBytes / (1024. * 1024.), textureBudget / (1024. * 1024.), streamStats.uploads, streamStats.evictions);
+            }
+            if(virtualTexturing){
+                VirtualTextureStats virtualStats = virtual_texture_stats(virtualTexture);
+                fprintf(stdout, "Virtual texture : %d of %d cache slots used, %d pages asked, %d uploaded, %d evicted\n",
+                        virtualStats.residentPages, virtualStats.cacheSlots, virtualStats.requests, virtualStats.uploads, virtualStats.evictions);
+            }
+            if(cullScene){
+                int visibleIndices = meshlet_culler_visible_indices(scene_culler);
+                fprintf(stdout, "Meshlets : %d of %d scene triangles drawn%s\n",
+                        visibleIndices / 3, scene_culler.indexCount / 3, prepass ? " (with occlusion)" : "");
+            }
+        }
 
+        //-------------------------------------Virtual Texture Feedback
 
-            float coeff = rayon * sin(t);
-            float w = t + t;
+        if(virtualTexturing)
+            virtual_texture_feedback(virtualTexture);
 
-//            coeff = 20;
-//            w = 0;
+        //-------------------------------------Bind the light framebuffer
 
-            light._pos = glm::vec3(
-                coeff * cos(i+ M_PI /nbPointLights) + xOffset,
-                pointLightsYOffset,
-                coeff * sin(i+ M_PI /nbPointLights) + zOffset);
+        glBindFramebuffer(GL_FRAMEBUFFER, frame_graph_framebuffer(frameGraph, lightPass));
 
-            light._color.x = cos(i);
-            light._color.y = sin(3*i);
-            light._color.y = cos(i*2);
+        //******************************************************* SECOND PASS
 
+        //-------------------------------------Light Draw
 
-            glBindBuffer(GL_UNIFORM_BUFFER, ubo[0]);
-            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Light), &light);
-            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        // Set a full screen viewport
+        glViewport( 0, 0, width, height );
 
-            glDrawElements(GL_TRIANGLES, quad_triangleCount * 3, GL_UNSIGNED_INT, (void*)0);
+        // Disable the depth test
+        gl_state_enable(glState, GL_DEPTH_TEST, false);
+        // Enable blending
+        gl_state_enable(glState, GL_BLEND, true);
+        // Setup additive blending
+        gl_state_blend_func(glState, GL_ONE, GL_ONE);
 
-            lights.push_back(light);
+        //------------------------------------ Lights
 
-        }
+        // Point, directionnal then spot lights, the G-buffer is already bound to its units
+        job_system_wait(jobs, lightRecording);
+        for(int i = 0; i < LIGHT_RECORDING_COUNT; ++i)
+            command_list_execute(lightRecordings[i].list, glState);
 
         //------------------------------------ Debug Shape Drawing
 
@@ -879,7 +1539,7 @@ int main( int argc, char **argv )
 //
 //        glUseProgram(programObject[5]);
 //        glPointSize(5);
-//        glBindVertexArray(vao[3]);
+//        glBindVertexArray(vao[1]);
 //        for(size_t i = 0; i < nbPointLights; ++i){
 //
 //            float light_vertices[] =  {
@@ -896,64 +1556,14 @@ int main( int argc, char **argv )
 //                                        lights[i]._pos.x         , lights[i]._pos.y, lights[i]._pos.z         ,         // light pos
 //                                      };
 //
-//            glBindBuffer(GL_ARRAY_BUFFER, vbo[11]);
+//            glBindBuffer(GL_ARRAY_BUFFER, vbo[3]);
 //            glBufferData(GL_ARRAY_BUFFER, sizeof(light_vertices), light_vertices, GL_STATIC_DRAW);
 //
 //            glDrawElements(GL_POINTS, 9, GL_UNSIGNED_INT, (void*)0);
 //        }
 
-        //------------------------------------ Directionnal Lights
-
-        //directionnal light shaders
-        glUseProgram(programObject[3]);
-
-        // Bind quad vao
-        glBindVertexArray(vao[2]);
-        
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, gbufferTextures[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, gbufferTextures[1]);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, gbufferTextures[2]);
-
-        for(size_t i = 0; i < directionnalLights.size(); ++i){
-
-            glBindBuffer(GL_UNIFORM_BUFFER, ubo[0]);
-            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Light), &directionnalLights[i]);
-            glBindBuffer(GL_UNIFORM_BUFFER, 0); 
-
-            glDrawElements(GL_TRIANGLES, quad_triangleCount * 3, GL_UNSIGNED_INT, (void*)0);
-        }
-
-//        ------------------------------------ Spot Lights
-
-         // spot light shaders
-         glUseProgram(programObject[4]);
-
-         // Bind quad vao
-         glBindVertexArray(vao[2]);
-        
-         glActiveTexture(GL_TEXTURE0);
-         glBindTexture(GL_TEXTURE_2D, gbufferTextures[0]);
-         glActiveTexture(GL_TEXTURE1);
-         glBindTexture(GL_TEXTURE_2D, gbufferTextures[1]);
-         glActiveTexture(GL_TEXTURE2);
-         glBindTexture(GL_TEXTURE_2D, gbufferTextures[2]);
-
-
-        spotLights[0]._pos = camera.eye;
-
-         for(size_t i = 0; i < spotLights.size(); ++i){
-             glBindBuffer(GL_UNIFORM_BUFFER, ubo[0]);
-             glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(SpotLight), &spotLights[i]);
-             glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
-             glDrawElements(GL_TRIANGLES, quad_triangleCount * 3, GL_UNSIGNED_INT, (void*)0);
-         }
-
         // Disable blending
-        glDisable(GL_BLEND);
+        gl_state_enable(glState, GL_BLEND, false);
 
 
 //        //-------------------------------------Debug Draw
@@ -968,7 +1578,7 @@ int main( int argc, char **argv )
 //        // --------------- Color Buffer
 //
 //        // Bind quad VAO
-//        glBindVertexArray(vao[2]);
+//        glBindVertexArray(vao[0]);
 //
 //        glActiveTexture(GL_TEXTURE0);
 //        // Bind gbuffer color texture
@@ -980,7 +1590,7 @@ int main( int argc, char **argv )
 //        glViewport( width/4, 0, width/4, height/4 );
 //
 //        // Bind quad VAO
-//        glBindVertexArray(vao[2]);
+//        glBindVertexArray(vao[0]);
 //
 //        glActiveTexture(GL_TEXTURE0);
 //        // Bind gbuffer color texture
@@ -992,7 +1602,7 @@ int main( int argc, char **argv )
 //        glViewport( 2*width/4, 0, width/4, height/4 );
 //
 //        // Bind quad VAO
-//        glBindVertexArray(vao[2]);
+//        glBindVertexArray(vao[0]);
 //
 //        glActiveTexture(GL_TEXTURE0);
 //        // Bind gbuffer color texture
@@ -1004,9 +1614,9 @@ int main( int argc, char **argv )
         //****************************************** EVENTS *******************************************
 #if 1
         // Draw UI
-        glDisable(GL_DEPTH_TEST);
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        gl_state_enable(glState, GL_DEPTH_TEST, false);
+        gl_state_enable(glState, GL_BLEND, true);
+        gl_state_blend_func(glState, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         glViewport(0, 0, width, height);
 
         unsigned char mbut = 0;
@@ -1033,7 +1643,6 @@ int main( int argc, char **argv )
 //        imguiSlider("Slider", &SliderValue, 0.0, 1.0, 0.001);
 //        imguiSlider("SliderMultiply", &SliderMult, 0.0, 1000.0, 0.1);
 //        imguiSlider("InstanceNumber", &instanceNumber, 100, 100000, 1);
-//        imguiSlider("Specular Power", &specularPower, 0, 100, 0.1);
 //        imguiSlider("Attenuation", &lightAttenuation, 0, 16, 0.1);
 //        imguiSlider("Intensity", &lightIntensity, 0, 10, 0.1);
 //        imguiSlider("Threshold", &lightAttenuationThreshold, 0, 0.5, 0.0001);
@@ -1058,10 +1667,12 @@ int main( int argc, char **argv )
 //        imguiEndFrame();
 //        imguiRenderGLDraw(width, height);
 
-        glDisable(GL_BLEND);
+        gl_state_enable(glState, GL_BLEND, false);
 #endif
         // Check for errors
         checkError("End loop");
+        uniform_ring_fence(frameRing);
+        glStateStats = gl_state_frame(glState);
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -1075,6 +1686,36 @@ int main( int argc, char **argv )
     //************************************* MAIN LOOP END *****************************************
     //*********************************************************************************************
 
+    shader_reload_release(shaderReload);
+    pulled_mesh_release(plane_pulled);
+    mesh_batch_release(geometryBatch);
+    if (cullScene)
+    {
+        meshlet_culler_release(scene_culler);
+        depth_pyramid_release(depthPyramid);
+    }
+    if (drawScene)
+        mesh_release(scene_mesh);
+    if (vertexBenchmark)
+        mesh_batch_release(geometryBatchFloat);
+    glDeleteQueries(1, &benchmarkQuery);
+    glDeleteQueries(2, overdrawQueries);
+    glDeleteTextures(1, &instanceTexture);
+    instance_buffer_release(instanceBuffer);
+    uniform_ring_release(frameRing);
+    frame_graph_release(frameGraph);
+    glDeleteBuffers(2, ubo);
+    texture_stream_release(textureStream);
+    texture_array_set_release(diffuseArrays);
+    texture_array_set_release(specularArrays);
+    virtual_texture_release(virtualTexture);
+    texture_loader_release(textureLoader);
+    if (uploadThread)
+        uploader_release(uploader);
+    thread_pool_release(workers);
+    job_system_release(jobs);
+    frame_arena_release(frameArena);
+
     // Close OpenGL window and terminate GLFW
     glfwTerminate();
 
@@ -1117,13 +1758,15 @@ int check_compile_error(GLuint shader, const char ** sourceBuffer)
         char * log = new char[logLength];
         glGetShaderInfoLog(shader, logLength, &logLength, log);
         char *token, *string;
-        string = strdup(sourceBuffer[0]);
+        char * source = strdup(sourceBuffer[0]);
+        string = source;
         int lc = 0;
         while ((token = strsep_custom(&string, "\n")) != NULL) {
            printf("%3d : %s\n", lc, token);
            ++lc;
         }
         fprintf(stderr, "Compile : %s", log);
+        free(source);
         delete[] log;
     }
     // If an error happend quit
@@ -1183,6 +1826,151 @@ GLuint compile_shader_from_file(GLenum shaderType, const char * path)
     return shaderObject;
 }
 
+// Program of stages from the binary cache, or compiled, linked and stored on a miss. Shader
+// variants are expanded and compiled the first time a missing program needs them, then kept
+// in shaders, by path and defines, for the next programs that need them.
+GLuint build_program(ProgramCache & cache, std::vector< std::pair<std::string, GLuint> > & shaders, const ProgramStage * stages, int stageCount)
+{
+    unsigned long long key;
+    GLuint program = program_cache_load(cache, stages, stageCount, key);
+    if (program)
+        return program;
+
+    double start = glfwGetTime();
+    program = glCreateProgram();
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    for (int i = 0; i < stageCount; ++i)
+    {
+        std::string variant = std::string(stages[i].path) + " " + (stages[i].defines ? stages[i].defines : "");
+        GLuint shader = 0;
+        for (size_t s = 0; s < shaders.size() && !shader; ++s)
+            if (shaders[s].first == variant)
+                shader = shaders[s].second;
+        if (!shader)
+        {
+            std::string source;
+            std::vector<std::string> files;
+            if (!shader_source_expand(stages[i].path, stages[i].defines, source, files))
+                return 0;
+            shader = compile_shader(stages[i].type, source.c_str(), int(source.size()));
+            shaders.push_back(std::make_pair(variant, shader));
+        }
+        glAttachShader(program, shader);
+    }
+    glLinkProgram(program);
+    if (check_link_error(program) < 0)
+        return 0;
+    program_cache_store(cache, key, program, (glfwGetTime() - start) * 1000.0);
+    return program;
+}
+
+// Give programObject[index] the uniforms and blocks that do not change and query the
+// locations the frame loop sets, at startup and each time the program is reloaded
+void setup_program(const GLuint * programObject, int index, const ProgramSettings & settings, ProgramLocations & locations)
+{
+    GLuint program = programObject[index];
+
+    // Every program but the compute ones reads the Frame block
+    GLuint frameIndex = glGetUniformBlockIndex(program, "Frame");
+    if (frameIndex != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, frameIndex, FRAME_BINDING_POINT);
+
+    // Geometry Shading
+    for (int i = 0; i < GEOMETRY_PROGRAM_COUNT; ++i)
+    {
+        if (GEOMETRY_PROGRAMS[i] != index)
+            continue;
+        locations.drawIdOffset[i] = glGetUniformLocation(program, "DrawIdOffset");
+        locations.rigid[i] = glGetUniformLocation(program, "Rigid");
+
+        glProgramUniform1i(program, glGetUniformLocation(program, "Diffuse"), 0);
+        glProgramUniform1i(program, glGetUniformLocation(program, "Specular"), 1);
+        glProgramUniform1i(program, glGetUniformLocation(program, "DiffuseArray"), MATERIAL_DIFFUSE_ARRAY_UNIT);
+        glProgramUniform1i(program, glGetUniformLocation(program, "SpecularArray"), MATERIAL_SPECULAR_ARRAY_UNIT);
+        glProgramUniform1i(program, glGetUniformLocation(program, "TextureMode"), settings.textureMode);
+        glProgramUniform1i(program, glGetUniformLocation(program, "PageTable"), VIRTUAL_PAGE_TABLE_UNIT);
+        glProgramUniform1i(program, glGetUniformLocation(program, "DiffuseCache"), VIRTUAL_DIFFUSE_CACHE_UNIT);
+        glProgramUniform1i(program, glGetUniformLocation(program, "SpecularCache"), VIRTUAL_SPECULAR_CACHE_UNIT);
+        if (settings.virtualPages > 0)
+        {
+            glProgramUniform1i(program, glGetUniformLocation(program, "VirtualPages"), settings.virtualPages);
+            glProgramUniform1i(program, glGetUniformLocation(program, "VirtualLevels"), settings.virtualLevels);
+            glProgramUniform1i(program, glGetUniformLocation(program, "CachePages"), settings.cachePages);
+        }
+
+        // The depth pre-pass has no materials
+        GLuint materialIndex = glGetUniformBlockIndex(program, "Materials");
+        if (materialIndex != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, materialIndex, MATERIAL_BINDING_POINT);
+    }
+
+    // Vertex Pulling
+    if (index == 6)
+    {
+        glProgramUniform1i(program, glGetUniformLocation(program, "Instances"), PULL_INSTANCES_UNIT);
+        glProgramUniform1i(program, glGetUniformLocation(program, "MeshVertices"), PULL_MESH_VERTICES_UNIT);
+        glProgramUniform1i(program, glGetUniformLocation(program, "MeshIndices"), PULL_MESH_INDICES_UNIT);
+        locations.pullMesh = glGetUniformLocation(program, "PullMesh");
+        locations.instanceOffset = glGetUniformLocation(program, "InstanceOffset");
+    }
+
+    // Light Pass Shading
+    if (index >= 2 && index < 5)
+    {
+        glProgramUniform1i(program, glGetUniformLocation(program, "ColorBuffer"), GBUFFER_COLOR_UNIT);
+        glProgramUniform1i(program, glGetUniformLocation(program, "NormalBuffer"), GBUFFER_NORMAL_UNIT);
+        glProgramUniform1i(program, glGetUniformLocation(program, "DepthBuffer"), GBUFFER_DEPTH_UNIT);
+        glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Light"), LIGHT_BINDING_POINT);
+    }
+}
+
+// Same circles as the serial loop had : the radius grows by 3 at each count of nbLightsByCircle
+static Light point_light(const PointLightParams & params, int i)
+{
+    static const int nbLightsByCircle[] = {6, 12, 18, 24, 30, 36, 42, 48, 54, 60, 66, 72, 78};
+    float rayon = params.radius;
+    for (int c = 0; c < 13 && nbLightsByCircle[c] <= i; ++c)
+        rayon += 3;
+
+    Light light(glm::vec3(0,0,0), glm::vec3(1,1,1), params.intensity, params.attenuation);
+    float coeff = rayon * sin(params.time);
+    light._pos = glm::vec3(
+        coeff * cos(i+ M_PI /params.count) + params.xOffset,
+        params.y,
+        coeff * sin(i+ M_PI /params.count) + params.zOffset);
+
+    light._color.x = cos(i);
+    light._color.y = sin(3*i);
+    light._color.y = cos(i*2);
+    return light;
+}
+
+static void record_light_draw(LightRecording & recording, const void * light, size_t size)
+{
+    command_list_buffer_sub_data(recording.list, GL_UNIFORM_BUFFER, recording.ubo, 0, size, light);
+    command_list_draw_elements(recording.list, GL_TRIANGLES, recording.indexCount, GL_UNSIGNED_INT, 0, 1, 0);
+}
+
+// Job, records into its own list and makes no GL call
+void record_lights(void * user)
+{
+    LightRecording & recording = *(LightRecording *)user;
+    int drawCount = recording.points ? recording.pointEnd - recording.pointBegin : recording.lightCount;
+    size_t lightSize = recording.points ? sizeof(Light) : recording.lightSize;
+    command_list_reset(recording.list, recording.arena, 2 + 2 * drawCount, drawCount * lightSize);
+    command_list_use_program(recording.list, recording.program);
+    command_list_bind_vertex_array(recording.list, recording.vao);
+    if (recording.points)
+    {
+        for (int i = recording.pointBegin; i < recording.pointEnd; ++i)
+        {
+            Light light = point_light(*recording.points, i);
+            record_light_draw(recording, &light, sizeof(Light));
+        }
+    }
+    for (int i = 0; i < recording.lightCount; ++i)
+        record_light_draw(recording, (const unsigned char *)recording.lights + i * recording.lightSize, recording.lightSize);
+}
 
 bool checkError(const char* title)
 {
@@ -118,6 +118,10 @@
 // compiling these strings at all, and STBI_FAILURE_USERMSG to get slightly
 // more user-friendly ones.
 //
+// Decoding keeps no shared mutable state, the failure reason is kept per
+// thread, so several threads may load images at once. The global settings
+// below (iphone conversion, unpremultiply) should be set before they start.
+//
 // Paletted PNG, BMP, GIF, and PIC images are automatically depalettized.
 //
 // ===========================================================================
@@ -378,6 +382,18 @@ typedef unsigned char validate_uint32[sizeof(uint32)==4 ? 1 : -1];
 #define STBI_HAS_LROTL
 #endif
 
+// per thread decoder state, so several images can be decoded at once
+#ifdef _MSC_VER
+#define STBI_THREAD_LOCAL __declspec(thread)
+#else
+#define STBI_THREAD_LOCAL __thread
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STBI_SSE2
+#include <emmintrin.h>
+#endif
+
 #ifdef STBI_HAS_LROTL
    #define stbi_lrot(x,y)  _lrotl(x,y)
 #else
@@ -492,8 +508,8 @@ static stbi_uc *stbi_gif_load(stbi *s, int *x, int *y, int *comp, int req_comp);
 static int      stbi_gif_info(stbi *s, int *x, int *y, int *comp);
 
 
-// this is not threadsafe
-static const char *failure_reason;
+// one per thread, stbi_failure_reason reports the last failure of the calling thread
+static STBI_THREAD_LOCAL const char *failure_reason;
 
 const char *stbi_failure_reason(void)
 {
@@ -1954,6 +1970,7 @@ static int stbi_jpeg_info(stbi *s, int *x, int *y, int *comp)
 
 // zlib-style huffman encoding
 // (jpegs packs from left, zlib from right, so can't share code)
+// fast entries hold (code size << ZFAST_BITS) | symbol, 0 when the code is longer
 typedef struct
 {
    uint16 fast[1 << ZFAST_BITS];
@@ -1988,7 +2005,7 @@ static int zbuild_huffman(zhuffman *z, uint8 *sizelist, int num)
 
    // DEFLATE spec for generating codes
    memset(sizes, 0, sizeof(sizes));
-   memset(z->fast, 255, sizeof(z->fast));
+   memset(z->fast, 0, sizeof(z->fast));
    for (i=0; i < num; ++i) 
       ++sizes[sizelist[i]];
    sizes[0] = 0;
@@ -2016,7 +2033,7 @@ static int zbuild_huffman(zhuffman *z, uint8 *sizelist, int num)
          if (s <= ZFAST_BITS) {
             int k = bit_reverse(next_code[s],s);
             while (k < (1 << ZFAST_BITS)) {
-               z->fast[k] = (uint16) c;
+               z->fast[k] = (uint16) ((s << ZFAST_BITS) | i);
                k += (1 << s);
             }
          }
@@ -2076,11 +2093,11 @@ stbi_inline static int zhuffman_decode(zbuf *a, zhuffman *z)
    int b,s,k;
    if (a->num_bits < 16) fill_bits(a);
    b = z->fast[a->code_buffer & ZFAST_MASK];
-   if (b < 0xffff) {
-      s = z->size[b];
+   if (b) {
+      s = b >> ZFAST_BITS;
       a->code_buffer >>= s;
       a->num_bits -= s;
-      return z->value[b];
+      return b & ZFAST_MASK;
    }
 
    // not resolved by fast table, so compute it the slow way
@@ -2131,16 +2148,24 @@ static int dist_extra[32] =
 
 static int parse_huffman_block(zbuf *a)
 {
+   char *zout = a->zout; // kept in a register, written back around expand
    for(;;) {
       int z = zhuffman_decode(a, &a->z_length);
       if (z < 256) {
          if (z < 0) return e("bad huffman code","Corrupt PNG"); // error in huffman codes
-         if (a->zout >= a->zout_end) if (!expand(a, 1)) return 0;
-         *a->zout++ = (char) z;
+         if (zout >= a->zout_end) {
+            a->zout = zout;
+            if (!expand(a, 1)) return 0;
+            zout = a->zout;
+         }
+         *zout++ = (char) z;
       } else {
          uint8 *p;
          int len,dist;
-         if (z == 256) return 1;
+         if (z == 256) {
+            a->zout = zout;
+            return 1;
+         }
          z -= 257;
          len = length_base[z];
          if (length_extra[z]) len += zreceive(a, length_extra[z]);
@@ -2148,11 +2173,29 @@ static int parse_huffman_block(zbuf *a)
          if (z < 0) return e("bad huffman code","Corrupt PNG");
          dist = dist_base[z];
          if (dist_extra[z]) dist += zreceive(a, dist_extra[z]);
-         if (a->zout - a->zout_start < dist) return e("bad dist","Corrupt PNG");
-         if (a->zout + len > a->zout_end) if (!expand(a, len)) return 0;
-         p = (uint8 *) (a->zout - dist);
-         while (len--)
-            *a->zout++ = *p++;
+         if (zout - a->zout_start < dist) return e("bad dist","Corrupt PNG");
+         if (zout + len > a->zout_end) {
+            a->zout = zout;
+            if (!expand(a, len)) return 0;
+            zout = a->zout;
+         }
+         p = (uint8 *) (zout - dist);
+         if (dist == 1) { // run of a single byte
+            memset(zout, *p, len);
+            zout += len;
+         } else if (dist >= 8 && zout + len + 8 <= a->zout_end) {
+            // source 8 bytes behind at least, copy words, the last one may run up to 7 bytes past len
+            char *end = zout + len;
+            do {
+               memcpy(zout, p, 8);
+               zout += 8;
+               p += 8;
+            } while (zout < end);
+            zout = end;
+         } else {
+            while (len--)
+               *zout++ = *p++;
+         }
       }
    }
 }
@@ -2245,20 +2288,21 @@ static int parse_zlib_header(zbuf *a)
    return 1;
 }
 
-// @TODO: should statically initialize these for optimal thread safety
-static uint8 default_length[288], default_distance[32];
-static void init_defaults(void)
+// fixed code lengths of the spec, initialized statically so threads never race on them
+#define R4(v)  v,v,v,v
+#define R16(v) R4(v),R4(v),R4(v),R4(v)
+static uint8 default_length[288] =
 {
-   int i;   // use <= to match clearly with spec
-   for (i=0; i <= 143; ++i)     default_length[i]   = 8;
-   for (   ; i <= 255; ++i)     default_length[i]   = 9;
-   for (   ; i <= 279; ++i)     default_length[i]   = 7;
-   for (   ; i <= 287; ++i)     default_length[i]   = 8;
-
-   for (i=0; i <=  31; ++i)     default_distance[i] = 5;
-}
+   R16(8),R16(8),R16(8),R16(8),R16(8),R16(8),R16(8),R16(8),R16(8), // 0..143
+   R16(9),R16(9),R16(9),R16(9),R16(9),R16(9),R16(9),                // 144..255
+   R16(7),R4(7),R4(7),                                              // 256..279
+   R4(8),R4(8)                                                      // 280..287
+};
+static uint8 default_distance[32] = { R16(5),R16(5) };
+#undef R16
+#undef R4
 
-int stbi_png_partial; // a quick hack to only allow decoding some of a PNG... I should implement real streaming support instead
+static STBI_THREAD_LOCAL int stbi_png_partial; // a quick hack to only allow decoding some of a PNG... I should implement real streaming support instead
 static int parse_zlib(zbuf *a, int parse_header)
 {
    int final, type;
@@ -2276,7 +2320,6 @@ static int parse_zlib(zbuf *a, int parse_header)
       } else {
          if (type == 1) {
             // use fixed code lengths
-            if (!default_distance[31]) init_defaults();
             if (!zbuild_huffman(&a->z_length  , default_length  , 288)) return 0;
             if (!zbuild_huffman(&a->z_distance, default_distance,  32)) return 0;
          } else {
@@ -2428,17 +2471,93 @@ static uint8 first_row_filter[5] =
    F_none, F_sub, F_none, F_avg_first, F_paeth_first
 };
 
-static int paeth(int a, int b, int c)
+// same choice as comparing |p-a|, |p-b| and |p-c| with p = a+b-c, without the
+// unpredictable branches: a wins below thresh, b above it, c in between
+stbi_inline static int paeth(int a, int b, int c)
 {
-   int p = a + b - c;
-   int pa = abs(p-a);
-   int pb = abs(p-b);
-   int pc = abs(p-c);
-   if (pa <= pb && pa <= pc) return a;
-   if (pb <= pc) return b;
-   return c;
+   int thresh = c*3 - (a + b);
+   int lo = a < b ? a : b;
+   int hi = a < b ? b : a;
+   int t0 = (hi <= thresh) ? lo : c;
+   int t1 = (thresh <= lo) ? hi : t0;
+   return t1;
+}
+
+#ifdef STBI_SSE2
+stbi_inline static __m128i load_pixel(const uint8 *p, int n)
+{
+   uint32 v = 0;
+   memcpy(&v, p, n);
+   return _mm_cvtsi32_si128((int) v);
 }
 
+stbi_inline static void store_pixel(uint8 *p, __m128i x, int n)
+{
+   uint32 v = (uint32) _mm_cvtsi128_si32(x);
+   memcpy(p, &v, n);
+}
+
+// unfilter the pixels after the first of a row with 3 or 4 channels, or any row filtered
+// with up; each pixel depends on the one to its left so only up goes 16 bytes at a time
+static void unfilter_row_sse2(int filter, uint8 *cur, uint8 *prior, uint8 *raw, uint32 count, int n)
+{
+   uint32 i;
+   __m128i zero = _mm_setzero_si128();
+   __m128i a, b, c, x;
+   if (filter == F_up) {
+      uint32 bytes = count * n;
+      for (i=0; i + 16 <= bytes; i += 16) {
+         x = _mm_add_epi8(_mm_loadu_si128((__m128i *) (raw+i)), _mm_loadu_si128((__m128i *) (prior+i)));
+         _mm_storeu_si128((__m128i *) (cur+i), x);
+      }
+      for (; i < bytes; ++i)
+         cur[i] = raw[i] + prior[i];
+      return;
+   }
+   a = load_pixel(cur - n, n);
+   switch (filter) {
+      case F_sub:
+         for (i=0; i < count; ++i, raw+=n, cur+=n) {
+            a = _mm_add_epi8(load_pixel(raw, n), a);
+            store_pixel(cur, a, n);
+         }
+         break;
+      case F_avg:
+         for (i=0; i < count; ++i, raw+=n, cur+=n, prior+=n) {
+            b = load_pixel(prior, n);
+            // avg_epu8 rounds up, take the carry back to get (a+b)>>1
+            x = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+            a = _mm_add_epi8(load_pixel(raw, n), x);
+            store_pixel(cur, a, n);
+         }
+         break;
+      case F_paeth:
+         a = _mm_unpacklo_epi8(a, zero);
+         c = _mm_unpacklo_epi8(load_pixel(prior - n, n), zero);
+         for (i=0; i < count; ++i, raw+=n, cur+=n, prior+=n) {
+            __m128i pa, pb, pc, t, a_loses, b_loses;
+            b = _mm_unpacklo_epi8(load_pixel(prior, n), zero);
+            // with p = a+b-c: |p-a| = |b-c|, |p-b| = |a-c|, |p-c| = |a+b-2c|
+            pa = _mm_sub_epi16(b, c);
+            pb = _mm_sub_epi16(a, c);
+            pc = _mm_add_epi16(pa, pb);
+            pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+            pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+            pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+            a_loses = _mm_cmpgt_epi16(pa, _mm_min_epi16(pb, pc));
+            b_loses = _mm_cmpgt_epi16(pb, pc); // to c
+            t = _mm_or_si128(_mm_and_si128(b_loses, c), _mm_andnot_si128(b_loses, b));
+            t = _mm_or_si128(_mm_and_si128(a_loses, t), _mm_andnot_si128(a_loses, a));
+            x = _mm_add_epi8(load_pixel(raw, n), _mm_packus_epi16(t, zero));
+            store_pixel(cur, x, n);
+            a = _mm_unpacklo_epi8(x, zero);
+            c = b;
+         }
+         break;
+   }
+}
+#endif
+
 // create the png data from post-deflated data
 static int create_png_image_raw(png *a, uint8 *raw, uint32 raw_len, int out_n, uint32 x, uint32 y)
 {
@@ -2480,6 +2599,14 @@ static int create_png_image_raw(png *a, uint8 *raw, uint32 raw_len, int out_n, u
       raw += img_n;
       cur += out_n;
       prior += out_n;
+      #ifdef STBI_SSE2
+      if (img_n == out_n && x > 1 && (filter == F_up ||
+          ((img_n == 3 || img_n == 4) && (filter == F_sub || filter == F_avg || filter == F_paeth)))) {
+         unfilter_row_sse2(filter, cur, prior, raw, x-1, img_n);
+         raw += (x-1)*img_n;
+         continue;
+      }
+      #endif
       // this is a little gross, so that we don't switch per-pixel or per-component
       if (img_n == out_n) {
          #define CASE(f) \
@@ -5,13 +5,15 @@ solution "aogl"
    project "aogl"
       kind "ConsoleApp"
       language "C++"
-      files { "aogl.cpp"}
+      files { "aogl.cpp", "src/*.cpp", "src/*.h" }
       includedirs { "lib/glfw/include", "src", "common", "lib/" }
       links {"glfw", "glew", "stb", "imgui"}
       defines { "GLEW_STATIC" }
+      buildoptions { "-std=c++11" }
      
       configuration { "linux" }
          links {"X11","Xrandr", "Xi", "Xxf86vm", "rt", "GL", "GLU", "pthread"}
+         buildoptions { "-pthread" }
        
       configuration { "windows" }
          links {"glu32","opengl32", "gdi32", "winmm", "user32"}
@@ -29,6 +31,100 @@ solution "aogl"
          defines { "NDEBUG" }
          flags { "Optimize"}    
 
+   -- Mesh cooker, converts OBJ files into the binary format aogl maps at startup
+   project "meshcook"
+      kind "ConsoleApp"
+      language "C++"
+      files { "tools/meshcook.cpp", "src/objimport.*", "src/meshfile.*", "src/meshopt.*", "src/meshletbuild.cpp", "src/meshlet.h", "src/depthpyramid.h", "src/meshpack.cpp", "src/mappedfile.*", "src/mesh.h" }
+      includedirs { "lib/glfw/include", "src", "lib/" }
+      defines { "GLEW_STATIC" }
+      buildoptions { "-std=c++11" }
+
+      configuration "Debug"
+         defines { "DEBUG" }
+         flags {"ExtraWarnings", "Symbols" }
+         targetsuffix "_d"
+
+      configuration "Release"
+         defines { "NDEBUG" }
+         flags { "Optimize"}    
+
+   -- Texture cooker, compresses images into the .ktx files aogl uploads as is
+   project "texcook"
+      kind "ConsoleApp"
+      language "C++"
+      files { "tools/texcook.cpp", "src/texcompress.*", "src/ktx.*", "src/mappedfile.*" }
+      includedirs { "lib/glfw/include", "src", "lib/" }
+      links {"stb"}
+      defines { "GLEW_STATIC" }
+      buildoptions { "-std=c++11" }
+
+      configuration "Debug"
+         defines { "DEBUG" }
+         flags {"ExtraWarnings", "Symbols" }
+         targetsuffix "_d"
+
+      configuration "Release"
+         defines { "NDEBUG" }
+         flags { "Optimize"}    
+
+   project "vtcook"
+      kind "ConsoleApp"
+      language "C++"
+      files { "tools/vtcook.cpp", "src/vtfile.*", "src/ktx.*", "src/mappedfile.*" }
+      includedirs { "lib/glfw/include", "src", "lib/" }
+      defines { "GLEW_STATIC" }
+      buildoptions { "-std=c++11" }
+
+      configuration "Debug"
+         defines { "DEBUG" }
+         flags {"ExtraWarnings", "Symbols" }
+         targetsuffix "_d"
+
+      configuration "Release"
+         defines { "NDEBUG" }
+         flags { "Optimize"}    
+
+   project "pngbench"
+      kind "ConsoleApp"
+      language "C++"
+      files { "tools/pngbench.cpp", "src/threadpool.*" }
+      includedirs { "src", "lib/" }
+      links {"stb"}
+      buildoptions { "-std=c++11" }
+
+      configuration { "linux" }
+         links {"pthread"}
+
+      configuration "Debug"
+         defines { "DEBUG" }
+         flags {"ExtraWarnings", "Symbols" }
+         targetsuffix "_d"
+
+      configuration "Release"
+         defines { "NDEBUG" }
+         flags { "Optimize"}    
+
+   -- Job system scalability from 1 to N cores
+   project "jobbench"
+      kind "ConsoleApp"
+      language "C++"
+      files { "tools/jobbench.cpp", "src/jobsystem.*" }
+      includedirs { "src" }
+      buildoptions { "-std=c++11" }
+
+      configuration { "linux" }
+         links {"pthread"}
+
+      configuration "Debug"
+         defines { "DEBUG" }
+         flags {"ExtraWarnings", "Symbols" }
+         targetsuffix "_d"
+
+      configuration "Release"
+         defines { "NDEBUG" }
+         flags { "Optimize"}    
+
    -- GLFW Library
    project "glfw"
       kind "StaticLib"
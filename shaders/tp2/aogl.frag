@@ -1,4 +1,5 @@
 #version 410 core
+#extension GL_ARB_bindless_texture : enable
 
 #define M_PI 3.14159265359
 
@@ -6,24 +7,68 @@
 #define NORMAL		1
 #define TEXCOORD	2
 #define FRAG_COLOR	0
+#define MAX_MATERIALS	256
 
 precision highp int;
 
+#define TEXTURES_BOUND		0
+#define TEXTURES_ARRAY		1
+#define TEXTURES_BINDLESS	2
+#define TEXTURES_VIRTUAL	3
+
+// Must match VT_PAGE_* in src/vtfile.h
+#define PAGE_TEXELS	128
+#define PAGE_BORDER	4
+#define PAGE_SIZE	(PAGE_TEXELS + 2 * PAGE_BORDER)
+
 uniform sampler2D Diffuse;
 uniform sampler2D Specular;
+uniform sampler2DArray DiffuseArray;
+uniform sampler2DArray SpecularArray;
+// Where the material textures are, TEXTURES_*
+uniform int TextureMode;
+
+// Virtual texture : slot x, slot y and level of the page to sample for each page of each level
+uniform usampler2D PageTable;
+uniform sampler2D DiffuseCache;
+uniform sampler2D SpecularCache;
+// Side of the virtual texture in pages at level 0, its level count and the side of the caches in slots
+uniform int VirtualPages;
+uniform int VirtualLevels;
+uniform int CachePages;
 
-uniform float SpecularPower;
+struct Material
+{
+	vec4 DiffuseColor;
+	float SpecularPower;
+	int DiffuseLayer;
+	int SpecularLayer;
+	// Array handles, the same for every material of a format so they stay dynamically uniform
+	uvec2 DiffuseHandle;
+	uvec2 SpecularHandle;
+	// Offset and scale of the material in the virtual texture
+	vec4 VirtualRect;
+};
+
+// One material per draw, indexed by DrawId
+layout(std140) uniform Materials
+{
+	Material materials[MAX_MATERIALS];
+};
 
-uniform mat4 MV;
+#include "frame.glsl"
 
 layout(location = 0) out vec4 Color;
 layout(location = 1) out vec4 Normal;
+// Page wanted by the pixel, x | y << 12 | level << 24, only attached with the virtual texture
+layout(location = 2) out uint Feedback;
 
 in block
 {
 	vec2 TexCoord;
 	vec3 Normal;
 	vec3 Position;
+	flat int DrawId;
 } In;
 
 vec3 encodeNormal(vec4 n)
@@ -35,11 +80,56 @@ vec3 encodeNormal(vec4 n)
     return vec3(enc, 0);
 }
 
+void sampleVirtual(vec4 rect, out vec3 diffuse, out float specular)
+{
+	// Footprint from the unwrapped coordinates, fract breaks the derivatives at the edges
+	vec2 texels = In.TexCoord * rect.zw * float(VirtualPages * PAGE_TEXELS);
+	vec2 dx = dFdx(texels);
+	vec2 dy = dFdy(texels);
+	float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8));
+	int level = clamp(int(lod), 0, VirtualLevels - 1);
+
+	vec2 uv = rect.xy + fract(In.TexCoord) * rect.zw;
+	int pages = VirtualPages >> level;
+	ivec2 page = min(ivec2(uv * float(pages)), ivec2(pages - 1));
+	Feedback = uint(page.x) | (uint(page.y) << 12) | (uint(level) << 24);
+
+	// The page itself or its nearest resident ancestor, each sampled without mips
+	uvec4 entry = texelFetch(PageTable, page, level);
+	vec2 inPage = fract(uv * float(VirtualPages >> int(entry.z)));
+	vec2 cacheUv = (vec2(entry.xy) * float(PAGE_SIZE) + float(PAGE_BORDER) + inPage * float(PAGE_TEXELS)) / float(CachePages * PAGE_SIZE);
+	diffuse = textureLod(DiffuseCache, cacheUv, 0).rgb;
+	specular = textureLod(SpecularCache, cacheUv, 0).r;
+}
+
 void main()
 {	
-	vec3 diffuse = texture(Diffuse, In.TexCoord).rgb;
-	vec3 specular = texture(Specular, In.TexCoord).rgb;
-	Color = vec4(diffuse, specular.x);
+	Material material = materials[In.DrawId];
+	vec3 diffuse;
+	// Single channel, cooked as BC4
+	float specular;
+	if (TextureMode == TEXTURES_VIRTUAL)
+	{
+		sampleVirtual(material.VirtualRect, diffuse, specular);
+	}
+	else if (TextureMode == TEXTURES_ARRAY)
+	{
+		diffuse = texture(DiffuseArray, vec3(In.TexCoord, material.DiffuseLayer)).rgb;
+		specular = texture(SpecularArray, vec3(In.TexCoord, material.SpecularLayer)).r;
+	}
+#ifdef GL_ARB_bindless_texture
+	else if (TextureMode == TEXTURES_BINDLESS)
+	{
+		diffuse = texture(sampler2DArray(material.DiffuseHandle), vec3(In.TexCoord, material.DiffuseLayer)).rgb;
+		specular = texture(sampler2DArray(material.SpecularHandle), vec3(In.TexCoord, material.SpecularLayer)).r;
+	}
+#endif
+	else
+	{
+		diffuse = texture(Diffuse, In.TexCoord).rgb;
+		specular = texture(Specular, In.TexCoord).r;
+	}
+	Color = vec4(diffuse * material.DiffuseColor.rgb, specular);
 	vec4 normal = MV * vec4(In.Normal, 0);
-	Normal = vec4(encodeNormal(normal), SpecularPower/100);
+	Normal = vec4(encodeNormal(normal), material.SpecularPower/100);
 }
@@ -1,20 +1,27 @@
 #version 410 core
+#extension GL_ARB_shader_draw_parameters : enable
 
 #define POSITION	0
 #define NORMAL		1
 #define TEXCOORD	2
 #define FRAG_COLOR	0
+#define INSTANCE_TRANSFORM	3
+#define INSTANCE_ROTATION	4
+#define INSTANCE_MATERIAL	5
 
 
 precision highp float;
 precision highp int;
 
-uniform int InstanceNumber;
-
 layout(location = POSITION) in vec3 Position;
 layout(location = NORMAL) in vec3 Normal;
 layout(location = TEXCOORD) in vec2 TexCoord;
 
+// Per instance stream : xyz position and w uniform scale, rotation quaternion, material
+layout(location = INSTANCE_TRANSFORM) in vec4 InstanceTransform;
+layout(location = INSTANCE_ROTATION) in vec4 InstanceRotation;
+layout(location = INSTANCE_MATERIAL) in uint InstanceMaterial;
+
 in int gl_VertexID;
 in int gl_InstanceID;
 
@@ -23,39 +30,33 @@ out block
 	vec2 TexCoord;
 	vec3 Normal;
 	vec3 Position;
+	flat int DrawId;
 } Out;
 
-// If there is geometry shader, comment this
-uniform mat4 MVP;
-uniform mat4 MV;
+#include "frame.glsl"
+
+// Added to gl_DrawIDARB, or used alone when draws are issued one by one
+uniform int DrawIdOffset;
+
+vec3 rotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
 
 void main()
 {	
-	float xValue=0;
-	float yValue=0;
-	float zValue=0;
-
-	//if it's a cube
-	if(InstanceNumber!=-1){
-		xValue = mod(gl_InstanceID, sqrt(InstanceNumber));
-		zValue = gl_InstanceID / int(sqrt(InstanceNumber));
-	}
-
-	vec3 pos = vec3(xValue, 0, zValue);
-	vec3 worldPos = Position + pos;
-
-	if(InstanceNumber==-1){
-		worldPos.xz *= 10;
-	}
-	else{
-		worldPos.y += 0.5;
-	}
+	// precise : must match the depth pre-pass (depth.vert) bit for bit
+	precise vec3 worldPos = rotate(InstanceRotation, Position * InstanceTransform.w) + InstanceTransform.xyz;
 	
 	Out.TexCoord = TexCoord;
-	Out.Normal = Normal;
+	Out.Normal = rotate(InstanceRotation, Normal);
 	Out.Position = worldPos;
+#ifdef GL_ARB_shader_draw_parameters
+	Out.DrawId = gl_DrawIDARB + DrawIdOffset;
+#else
+	Out.DrawId = DrawIdOffset;
+#endif
 
 	// If there is geometry shader, comment this
 	gl_Position = MVP*vec4(worldPos, 1);
 }
-
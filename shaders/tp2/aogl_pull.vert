@@ -0,0 +1,83 @@
+#version 410 core
+
+#define INSTANCE_TEXELS	3
+#define MESH_TEXELS	2
+
+precision highp float;
+precision highp int;
+
+// Instance data, 3 texels per instance : position + scale, rotation, material
+uniform samplerBuffer Instances;
+// Packed mesh, 2 texels per vertex : position + u, normal + v
+uniform samplerBuffer MeshVertices;
+uniform usamplerBuffer MeshIndices;
+
+// 0 : procedural cube from gl_VertexID, 1 : pull from MeshVertices/MeshIndices
+uniform int PullMesh;
+// gl_InstanceID does not include the base instance
+uniform int InstanceOffset;
+// Index of the per draw data
+uniform int DrawIdOffset;
+
+in int gl_VertexID;
+in int gl_InstanceID;
+
+out block
+{
+	vec2 TexCoord;
+	vec3 Normal;
+	vec3 Position;
+	flat int DrawId;
+} Out;
+
+#include "frame.glsl"
+
+// Each face is spanned by A and B, with cross(A, B) == Normal so corners 0 1 2 are counter clockwise
+const vec3 faceNormal[6] = vec3[](vec3(0, 0, 1), vec3(0, 1, 0), vec3(0, 0, -1), vec3(0, -1, 0), vec3(1, 0, 0), vec3(-1, 0, 0));
+const vec3 faceA[6] = vec3[](vec3(1, 0, 0), vec3(1, 0, 0), vec3(1, 0, 0), vec3(1, 0, 0), vec3(0, 0, -1), vec3(0, 0, 1));
+const vec3 faceB[6] = vec3[](vec3(0, 1, 0), vec3(0, 0, -1), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 1, 0), vec3(0, 1, 0));
+const int faceCorner[6] = int[](0, 1, 2, 2, 1, 3);
+
+vec3 rotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main()
+{
+	vec3 position;
+	vec3 normal;
+	vec2 texCoord;
+
+	if (PullMesh == 0)
+	{
+		int face = gl_VertexID / 6;
+		int corner = faceCorner[gl_VertexID % 6];
+		vec2 c = vec2(corner & 1, corner >> 1);
+		position = 0.5 * faceNormal[face] + (c.x - 0.5) * faceA[face] + (c.y - 0.5) * faceB[face];
+		normal = faceNormal[face];
+		texCoord = c.yx;
+	}
+	else
+	{
+		int index = int(texelFetch(MeshIndices, gl_VertexID).r);
+		vec4 v0 = texelFetch(MeshVertices, index * MESH_TEXELS);
+		vec4 v1 = texelFetch(MeshVertices, index * MESH_TEXELS + 1);
+		position = v0.xyz;
+		normal = v1.xyz;
+		texCoord = vec2(v0.w, v1.w);
+	}
+
+	int instance = (gl_InstanceID + InstanceOffset) * INSTANCE_TEXELS;
+	vec4 transform = texelFetch(Instances, instance);
+	vec4 rotation = texelFetch(Instances, instance + 1);
+
+	vec3 worldPos = rotate(rotation, position * transform.w) + transform.xyz;
+
+	Out.TexCoord = texCoord;
+	Out.Normal = rotate(rotation, normal);
+	Out.Position = worldPos;
+	Out.DrawId = DrawIdOffset;
+
+	gl_Position = MVP*vec4(worldPos, 1);
+}
@@ -4,7 +4,7 @@ in block
     vec2 Texcoord;
 } In; 
 uniform sampler2D Texture;
-uniform mat4 MVInverse;
+#include "frame.glsl"
 
 layout(location = 0, index = 0) out vec4  Color;
 
@@ -12,7 +12,7 @@ in int gl_InstanceID;
 
 out vec3 WorldPosition;
 
-uniform mat4 MVP;
+#include "frame.glsl"
 
 void main()
 {	
@@ -0,0 +1,8 @@
+#version 410 core
+
+precision highp int;
+
+// Depth only, no color output
+void main()
+{
+}
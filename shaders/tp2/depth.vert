@@ -0,0 +1,37 @@
+#version 410 core
+
+#define POSITION	0
+#define INSTANCE_TRANSFORM	3
+#define INSTANCE_ROTATION	4
+
+precision highp float;
+precision highp int;
+
+// Position only version of aogl.vert for the depth pre-pass, the world position
+// must be computed exactly as aogl.vert does so the G-buffer pass passes GL_EQUAL
+layout(location = POSITION) in vec3 Position;
+layout(location = INSTANCE_TRANSFORM) in vec4 InstanceTransform;
+layout(location = INSTANCE_ROTATION) in vec4 InstanceRotation;
+
+out block
+{
+	vec2 TexCoord;
+	vec3 Normal;
+	vec3 Position;
+	flat int DrawId;
+} Out;
+
+vec3 rotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main()
+{
+	precise vec3 worldPos = rotate(InstanceRotation, Position * InstanceTransform.w) + InstanceTransform.xyz;
+
+	Out.TexCoord = vec2(0);
+	Out.Normal = vec3(0);
+	Out.Position = worldPos;
+	Out.DrawId = 0;
+}
@@ -0,0 +1,15 @@
+// Per frame and per view constants, uploaded once a frame and shared by every program.
+// The layout must match UniformFrame in aogl.cpp.
+
+layout(std140) uniform Frame
+{
+	mat4 MVP;
+	mat4 MV;
+	mat4 MVInverse;		// view to world, for normals
+	mat4 ScreenToWorld;
+	vec3 CameraPosition;
+	float Time;
+	float Slider;
+	float SliderMult;
+	int InstanceNumber;
+};
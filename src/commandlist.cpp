@@ -0,0 +1,105 @@
+#include "commandlist.h"
+
+#include <string.h>
+
+static Command & push_command(CommandList & list, CommandType type)
+{
+    Command command;
+    memset(&command, 0, sizeof(command));
+    command.type = type;
+    list.commands.push_back(command);
+    return list.commands.back();
+}
+
+void command_list_clear(CommandList & list)
+{
+    list.commands.clear();
+    list.data.clear();
+}
+
+void command_list_reset(CommandList & list, FrameArena * arena, size_t commandCount, size_t dataBytes)
+{
+    list.commands = CommandVector(FrameAllocator<Command>(arena));
+    list.data = CommandData(FrameAllocator<unsigned char>(arena));
+    list.commands.reserve(commandCount);
+    list.data.reserve(dataBytes);
+}
+
+void command_list_use_program(CommandList & list, GLuint program)
+{
+    push_command(list, COMMAND_USE_PROGRAM).object = program;
+}
+
+void command_list_bind_vertex_array(CommandList & list, GLuint vertexArray)
+{
+    push_command(list, COMMAND_BIND_VERTEX_ARRAY).object = vertexArray;
+}
+
+void command_list_bind_texture(CommandList & list, GLuint unit, GLenum target, GLuint texture)
+{
+    Command & command = push_command(list, COMMAND_BIND_TEXTURE);
+    command.unit = GLint(unit);
+    command.target = target;
+    command.object = texture;
+}
+
+void command_list_buffer_sub_data(CommandList & list, GLenum target, GLuint buffer, size_t offset, size_t size, const void * data)
+{
+    Command & command = push_command(list, COMMAND_BUFFER_SUB_DATA);
+    command.target = target;
+    command.object = buffer;
+    command.offset = offset;
+    command.count = GLsizei(size);
+    command.payload = list.data.size();
+    list.data.insert(list.data.end(), (const unsigned char *)data, (const unsigned char *)data + size);
+}
+
+void command_list_program_uniform_1i(CommandList & list, GLuint program, GLint location, GLint value)
+{
+    Command & command = push_command(list, COMMAND_PROGRAM_UNIFORM_1I);
+    command.object = program;
+    command.unit = location;
+    command.value = value;
+}
+
+void command_list_draw_elements(CommandList & list, GLenum mode, GLsizei count, GLenum indexType, size_t offset, GLsizei instanceCount, GLuint baseInstance)
+{
+    Command & command = push_command(list, COMMAND_DRAW_ELEMENTS);
+    command.target = mode;
+    command.count = count;
+    command.indexType = indexType;
+    command.offset = offset;
+    command.instanceCount = instanceCount;
+    command.baseInstance = baseInstance;
+}
+
+void command_list_execute(const CommandList & list, GlState & state)
+{
+    for (size_t i = 0; i < list.commands.size(); ++i)
+    {
+        const Command & command = list.commands[i];
+        switch (command.type)
+        {
+        case COMMAND_USE_PROGRAM:
+            gl_state_use_program(state, command.object);
+            break;
+        case COMMAND_BIND_VERTEX_ARRAY:
+            gl_state_bind_vertex_array(state, command.object);
+            break;
+        case COMMAND_BIND_TEXTURE:
+            gl_state_bind_texture(state, GLuint(command.unit), command.target, command.object);
+            break;
+        case COMMAND_BUFFER_SUB_DATA:
+            gl_state_bind_buffer(state, command.target, command.object);
+            glBufferSubData(command.target, GLintptr(command.offset), command.count, &list.data[command.payload]);
+            break;
+        case COMMAND_PROGRAM_UNIFORM_1I:
+            glProgramUniform1i(command.object, command.unit, command.value);
+            break;
+        case COMMAND_DRAW_ELEMENTS:
+            glDrawElementsInstancedBaseInstance(command.target, command.count, command.indexType, (const void *)command.offset,
+                                                command.instanceCount, command.baseInstance);
+            break;
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef AOGL_COMMANDLIST_H
+#define AOGL_COMMANDLIST_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "glew/glew.h"
+
+#include "glstate.h"
+#include "framearena.h"
+
+enum CommandType
+{
+    COMMAND_USE_PROGRAM,
+    COMMAND_BIND_VERTEX_ARRAY,
+    COMMAND_BIND_TEXTURE,
+    COMMAND_BUFFER_SUB_DATA,
+    COMMAND_PROGRAM_UNIFORM_1I,
+    COMMAND_DRAW_ELEMENTS
+};
+
+struct Command
+{
+    CommandType type;
+    GLenum target; // texture or buffer target, primitive mode of the draws
+    GLuint object; // program, vertex array, texture or buffer
+    GLint unit; // texture unit, uniform location
+    GLint value; // uniform value
+    GLenum indexType;
+    GLsizei count; // indices drawn, bytes of the buffer update
+    GLsizei instanceCount;
+    GLuint baseInstance;
+    size_t offset; // in the buffer updated, of the first index drawn
+    size_t payload; // of the buffer update in CommandList::data
+};
+
+typedef std::vector<Command, FrameAllocator<Command> > CommandVector;
+typedef std::vector<unsigned char, FrameAllocator<unsigned char> > CommandData;
+
+// GL calls recorded as plain data, so any thread can build a list while only the
+// thread owning the context replays it. Buffer updates copy their bytes into the list.
+// A list is recorded by one thread at a time, the lists of a frame are replayed in order.
+struct CommandList
+{
+    CommandVector commands;
+    CommandData data;
+};
+
+// Keeps the storage for the next recording
+void command_list_clear(CommandList & list);
+// Start a recording in storage from arena, with room for commandCount commands and dataBytes
+// of buffer updates. The storage is gone two frames later, reset the list every frame.
+void command_list_reset(CommandList & list, FrameArena * arena, size_t commandCount, size_t dataBytes);
+void command_list_use_program(CommandList & list, GLuint program);
+void command_list_bind_vertex_array(CommandList & list, GLuint vertexArray);
+void command_list_bind_texture(CommandList & list, GLuint unit, GLenum target, GLuint texture);
+// Copies size bytes of data now, glBufferSubData at replay
+void command_list_buffer_sub_data(CommandList & list, GLenum target, GLuint buffer, size_t offset, size_t size, const void * data);
+void command_list_program_uniform_1i(CommandList & list, GLuint program, GLint location, GLint value);
+void command_list_draw_elements(CommandList & list, GLenum mode, GLsizei count, GLenum indexType, size_t offset, GLsizei instanceCount, GLuint baseInstance);
+// Binds through state, must run on the GL thread. Leaves what the last commands bound.
+void command_list_execute(const CommandList & list, GlState & state);
+
+#endif // AOGL_COMMANDLIST_H
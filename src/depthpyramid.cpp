@@ -0,0 +1,73 @@
+#include "depthpyramid.h"
+
+static int depth_pyramid_level_size(int size, int level)
+{
+    size >>= level;
+    return size > 1 ? size : 1;
+}
+
+void depth_pyramid_init(DepthPyramid & pyramid, int depthWidth, int depthHeight, GLuint program)
+{
+    pyramid.width = depthWidth / 2 > 1 ? depthWidth / 2 : 1;
+    pyramid.height = depthHeight / 2 > 1 ? depthHeight / 2 : 1;
+    pyramid.levels = 1;
+    while ((pyramid.width >> pyramid.levels) > 0 || (pyramid.height >> pyramid.levels) > 0)
+        ++pyramid.levels;
+
+    glGenTextures(1, &pyramid.texture);
+    glBindTexture(GL_TEXTURE_2D, pyramid.texture);
+    glTexStorage2D(GL_TEXTURE_2D, pyramid.levels, GL_R32F, pyramid.width, pyramid.height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    depth_pyramid_set_program(pyramid, program);
+}
+
+void depth_pyramid_set_program(DepthPyramid & pyramid, GLuint program)
+{
+    pyramid.program = program;
+    pyramid.sourceLocation = glGetUniformLocation(program, "Source");
+    pyramid.sourceLevelLocation = glGetUniformLocation(program, "SourceLevel");
+    pyramid.sourceSizeLocation = glGetUniformLocation(program, "SourceSize");
+    pyramid.destinationSizeLocation = glGetUniformLocation(program, "DestinationSize");
+}
+
+void depth_pyramid_release(DepthPyramid & pyramid)
+{
+    glDeleteTextures(1, &pyramid.texture);
+    pyramid.texture = 0;
+}
+
+void depth_pyramid_build(DepthPyramid & pyramid, GLuint depthTexture, int depthWidth, int depthHeight)
+{
+    glUseProgram(pyramid.program);
+    glProgramUniform1i(pyramid.program, pyramid.sourceLocation, DEPTH_PYRAMID_SOURCE_UNIT);
+    glActiveTexture(GL_TEXTURE0 + DEPTH_PYRAMID_SOURCE_UNIT);
+
+    int sourceWidth = depthWidth;
+    int sourceHeight = depthHeight;
+    for (int level = 0; level < pyramid.levels; ++level)
+    {
+        int width = depth_pyramid_level_size(pyramid.width, level);
+        int height = depth_pyramid_level_size(pyramid.height, level);
+
+        // Level 0 reads the depth buffer, the others the level above. Reading one level
+        // while writing another of the same texture is fine, they are distinct images.
+        glBindTexture(GL_TEXTURE_2D, level == 0 ? depthTexture : pyramid.texture);
+        glProgramUniform1i(pyramid.program, pyramid.sourceLevelLocation, level == 0 ? 0 : level - 1);
+        glProgramUniform2i(pyramid.program, pyramid.sourceSizeLocation, sourceWidth, sourceHeight);
+        glProgramUniform2i(pyramid.program, pyramid.destinationSizeLocation, width, height);
+        glBindImageTexture(0, pyramid.texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+        glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        sourceWidth = width;
+        sourceHeight = height;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,37 @@
+#ifndef AOGL_DEPTHPYRAMID_H
+#define AOGL_DEPTHPYRAMID_H
+
+#include "glew/glew.h"
+
+// Texture units used while building and sampling the pyramid
+enum DepthPyramidUnit
+{
+    DEPTH_PYRAMID_SOURCE_UNIT = 6,
+    DEPTH_PYRAMID_UNIT = 7
+};
+
+// Hierarchical depth : R32F mip chain where every texel holds the farthest depth of the
+// texels it covers in the level above, level 0 is half the size of the depth buffer
+struct DepthPyramid
+{
+    GLuint texture;
+    int width;
+    int height;
+    int levels;
+
+    GLuint program;
+    GLint sourceLocation;
+    GLint sourceLevelLocation;
+    GLint sourceSizeLocation;
+    GLint destinationSizeLocation;
+};
+
+// program is depth_pyramid.comp
+void depth_pyramid_init(DepthPyramid & pyramid, int depthWidth, int depthHeight, GLuint program);
+void depth_pyramid_release(DepthPyramid & pyramid);
+// Use another build of depth_pyramid.comp, after a reload
+void depth_pyramid_set_program(DepthPyramid & pyramid, GLuint program);
+// Reduce depthTexture into the pyramid, depthTexture must not be written by the bound framebuffer meanwhile
+void depth_pyramid_build(DepthPyramid & pyramid, GLuint depthTexture, int depthWidth, int depthHeight);
+
+#endif // AOGL_DEPTHPYRAMID_H
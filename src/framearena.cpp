@@ -0,0 +1,82 @@
+#include "framearena.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <algorithm>
+
+static void free_overflow(FrameArena & arena, int buffer)
+{
+    for (size_t i = 0; i < arena.overflow[buffer].size(); ++i)
+        free(arena.overflow[buffer][i]);
+    arena.overflow[buffer].clear();
+}
+
+void frame_arena_init(FrameArena & arena, size_t capacity)
+{
+    arena.capacity = capacity;
+    for (int i = 0; i < FRAME_ARENA_BUFFER_COUNT; ++i)
+        arena.buffers[i] = (unsigned char *)malloc(capacity);
+    arena.current = 0;
+    arena.used = 0;
+    arena.overflowBytes = 0;
+    arena.lastUsed = 0;
+    arena.lastOverflowBytes = 0;
+    arena.highWater = 0;
+    arena.overflows = 0;
+}
+
+void frame_arena_release(FrameArena & arena)
+{
+    for (int i = 0; i < FRAME_ARENA_BUFFER_COUNT; ++i)
+    {
+        free_overflow(arena, i);
+        free(arena.buffers[i]);
+        arena.buffers[i] = 0;
+    }
+}
+
+void frame_arena_begin_frame(FrameArena & arena)
+{
+    arena.lastUsed = arena.used;
+    arena.lastOverflowBytes = arena.overflowBytes;
+    arena.highWater = std::max(arena.highWater, arena.lastUsed + arena.lastOverflowBytes);
+    arena.current = (arena.current + 1) % FRAME_ARENA_BUFFER_COUNT;
+    free_overflow(arena, arena.current);
+    arena.used = 0;
+    arena.overflowBytes = 0;
+}
+
+void * frame_arena_alloc(FrameArena & arena, size_t size, size_t alignment)
+{
+    // Reserve room for the worst alignment, the buffer start is only malloc aligned.
+    // used only moves when the block fits, smaller allocations may still fit after one overflowed.
+    size_t reserved = size + alignment - 1;
+    size_t begin = arena.used;
+    while (reserved <= arena.capacity && begin <= arena.capacity - reserved)
+    {
+        if (arena.used.compare_exchange_weak(begin, begin + reserved))
+        {
+            uintptr_t address = uintptr_t(arena.buffers[arena.current] + begin);
+            address = (address + alignment - 1) / alignment * alignment;
+            return (void *)address;
+        }
+    }
+    arena.overflowBytes += reserved;
+    // malloc is aligned for any fundamental type
+    void * p = malloc(size);
+    std::lock_guard<std::mutex> lock(arena.overflowMutex);
+    arena.overflow[arena.current].push_back(p);
+    ++arena.overflows;
+    return p;
+}
+
+FrameArenaStats frame_arena_stats(const FrameArena & arena)
+{
+    FrameArenaStats stats;
+    stats.used = arena.lastUsed;
+    stats.overflowBytes = arena.lastOverflowBytes;
+    stats.highWater = arena.highWater;
+    stats.capacity = arena.capacity;
+    stats.overflows = arena.overflows;
+    return stats;
+}
@@ -0,0 +1,91 @@
+#ifndef AOGL_FRAMEARENA_H
+#define AOGL_FRAMEARENA_H
+
+#include <stddef.h>
+#include <new>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <type_traits>
+
+// Allocations of a frame stay valid during the next one too
+const int FRAME_ARENA_BUFFER_COUNT = 2;
+
+struct FrameArenaStats
+{
+    size_t used; // bytes taken in the buffer during the last frame, alignment included
+    size_t overflowBytes; // bytes that went to the heap during the last frame
+    size_t highWater; // most asked by a frame so far, buffer and heap together
+    size_t capacity; // of each buffer
+    int overflows; // allocations that did not fit and went to the heap
+};
+
+// Bump allocator for the transient data of a frame, nothing is freed on its own : each
+// frame takes the buffer of the frame before last and starts it over, so what a frame
+// allocated can still be read by the next one, like data the GPU consumes a frame later.
+// Any thread may allocate. When a buffer is full the allocation goes to the heap and is
+// freed with the buffer, the high water mark tells what capacity would have been enough.
+struct FrameArena
+{
+    unsigned char * buffers[FRAME_ARENA_BUFFER_COUNT];
+    size_t capacity;
+    int current;
+    std::atomic<size_t> used;
+    std::atomic<size_t> overflowBytes;
+    size_t lastUsed;
+    size_t lastOverflowBytes;
+    size_t highWater;
+    std::mutex overflowMutex;
+    std::vector<void *> overflow[FRAME_ARENA_BUFFER_COUNT];
+    int overflows;
+};
+
+void frame_arena_init(FrameArena & arena, size_t capacity);
+void frame_arena_release(FrameArena & arena);
+// Start a frame, the allocations of the frame before last are gone
+void frame_arena_begin_frame(FrameArena & arena);
+void * frame_arena_alloc(FrameArena & arena, size_t size, size_t alignment);
+FrameArenaStats frame_arena_stats(const FrameArena & arena);
+
+// STL allocator on a frame arena, without arena it allocates on the heap. Containers only
+// keep their storage until the frame after next, deallocate does nothing.
+template <typename T>
+struct FrameAllocator
+{
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    FrameArena * arena;
+
+    FrameAllocator(FrameArena * arena = 0) : arena(arena) {}
+    template <typename U>
+    FrameAllocator(const FrameAllocator<U> & other) : arena(other.arena) {}
+
+    T * allocate(size_t n)
+    {
+        if (!arena)
+            return static_cast<T *>(::operator new(n * sizeof(T)));
+        return static_cast<T *>(frame_arena_alloc(*arena, n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T * p, size_t)
+    {
+        if (!arena)
+            ::operator delete(p);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const FrameAllocator<T> & a, const FrameAllocator<U> & b)
+{
+    return a.arena == b.arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const FrameAllocator<T> & a, const FrameAllocator<U> & b)
+{
+    return a.arena != b.arena;
+}
+
+#endif // AOGL_FRAMEARENA_H
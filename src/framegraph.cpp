@@ -0,0 +1,361 @@
+#include "framegraph.h"
+
+#include <stdio.h>
+
+static const int FRAME_GRAPH_MAX_COLOR_ATTACHMENTS = 8;
+
+static bool is_depth_format(GLenum format)
+{
+    return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32 ||
+           format == GL_DEPTH_COMPONENT32F || format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+}
+
+// Depth stencil formats sit in the attachment of that name
+static bool is_stencil_format(GLenum format)
+{
+    return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+}
+
+// What drivers usually allocate, 24 bit formats are padded to 32
+static size_t texel_bytes(GLenum format)
+{
+    switch (format)
+    {
+    case GL_R8: return 1;
+    case GL_RG8: case GL_R16F: case GL_DEPTH_COMPONENT16: return 2;
+    case GL_RGBA16F: case GL_RG32F: case GL_RG32UI: case GL_DEPTH32F_STENCIL8: return 8;
+    case GL_RGBA32F: case GL_RGBA32UI: return 16;
+    default: return 4;
+    }
+}
+
+static size_t texture_bytes(const FrameGraphTextureDesc & desc)
+{
+    return size_t(desc.width) * desc.height * texel_bytes(desc.internalFormat);
+}
+
+static bool same_desc(const FrameGraphTextureDesc & a, const FrameGraphTextureDesc & b)
+{
+    return a.width == b.width && a.height == b.height && a.internalFormat == b.internalFormat;
+}
+
+static void release_framebuffers(FrameGraph & graph)
+{
+    for (size_t i = 0; i < graph.passes.size(); ++i)
+    {
+        if (graph.passes[i].framebuffer)
+            glDeleteFramebuffers(1, &graph.passes[i].framebuffer);
+        graph.passes[i].framebuffer = 0;
+    }
+}
+
+// Walk back from the imported writes : a pass lives if a later live pass reads what it writes
+static void cull_passes(FrameGraph & graph)
+{
+    std::vector<bool> needed(graph.resources.size(), false);
+    for (size_t r = 0; r < graph.resources.size(); ++r)
+        needed[r] = graph.resources[r].imported;
+    for (int p = int(graph.passes.size()) - 1; p >= 0; --p)
+    {
+        FrameGraphPass & pass = graph.passes[p];
+        pass.culled = true;
+        for (size_t i = 0; i < pass.writes.size(); ++i)
+            if (needed[pass.writes[i]])
+                pass.culled = false;
+        if (pass.culled)
+            continue;
+        for (size_t i = 0; i < pass.reads.size(); ++i)
+            needed[pass.reads[i]] = true;
+    }
+}
+
+// A read of a transient nothing wrote before is a declaration mistake
+static bool check_reads(const FrameGraph & graph)
+{
+    std::vector<bool> written(graph.resources.size(), false);
+    for (size_t i = 0; i < graph.order.size(); ++i)
+    {
+        const FrameGraphPass & pass = graph.passes[graph.order[i]];
+        for (size_t j = 0; j < pass.reads.size(); ++j)
+        {
+            const FrameGraphResource & resource = graph.resources[pass.reads[j]];
+            if (!resource.imported && !written[pass.reads[j]])
+            {
+                fprintf(stderr, "Frame graph : pass %s reads %s before any pass writes it\n", pass.name.c_str(), resource.name.c_str());
+                return false;
+            }
+        }
+        for (size_t j = 0; j < pass.writes.size(); ++j)
+            written[pass.writes[j]] = true;
+    }
+    return true;
+}
+
+static void compute_lifetimes(FrameGraph & graph)
+{
+    for (size_t r = 0; r < graph.resources.size(); ++r)
+    {
+        graph.resources[r].firstUse = graph.resources[r].lastUse = -1;
+        graph.resources[r].physical = -1;
+    }
+    for (size_t i = 0; i < graph.order.size(); ++i)
+    {
+        const FrameGraphPass & pass = graph.passes[graph.order[i]];
+        for (int k = 0; k < 2; ++k)
+        {
+            const std::vector<int> & used = k == 0 ? pass.reads : pass.writes;
+            for (size_t j = 0; j < used.size(); ++j)
+            {
+                FrameGraphResource & resource = graph.resources[used[j]];
+                if (resource.firstUse < 0)
+                    resource.firstUse = int(i);
+                resource.lastUse = int(i);
+            }
+        }
+    }
+}
+
+// Pool slots for the transients, a slot is free again after the last use of its transient.
+// The outputs of a pass are taken before its inputs are freed, so they never share a slot.
+static void assign_slots(FrameGraph & graph, std::vector<FrameGraphTextureDesc> & slots)
+{
+    std::vector<bool> busy;
+    for (size_t i = 0; i < graph.order.size(); ++i)
+    {
+        for (size_t r = 0; r < graph.resources.size(); ++r)
+        {
+            FrameGraphResource & resource = graph.resources[r];
+            if (resource.imported || resource.firstUse != int(i))
+                continue;
+            for (size_t s = 0; s < slots.size() && resource.physical < 0; ++s)
+                if (!busy[s] && same_desc(slots[s], resource.desc))
+                    resource.physical = int(s);
+            if (resource.physical < 0)
+            {
+                resource.physical = int(slots.size());
+                slots.push_back(resource.desc);
+                busy.push_back(false);
+            }
+            busy[resource.physical] = true;
+        }
+        for (size_t r = 0; r < graph.resources.size(); ++r)
+            if (!graph.resources[r].imported && graph.resources[r].lastUse == int(i))
+                busy[graph.resources[r].physical] = false;
+    }
+}
+
+// Keep the pool textures that still fit a slot, leaves the last one bound on the active unit
+static void build_pool(FrameGraph & graph, const std::vector<FrameGraphTextureDesc> & slots)
+{
+    std::vector<FrameGraphTexture> previous;
+    previous.swap(graph.pool);
+    for (size_t s = 0; s < slots.size(); ++s)
+    {
+        FrameGraphTexture texture;
+        texture.desc = slots[s];
+        texture.texture = 0;
+        for (size_t i = 0; i < previous.size() && !texture.texture; ++i)
+        {
+            if (previous[i].texture && same_desc(previous[i].desc, slots[s]))
+            {
+                texture.texture = previous[i].texture;
+                previous[i].texture = 0;
+            }
+        }
+        if (!texture.texture)
+        {
+            glGenTextures(1, &texture.texture);
+            glBindTexture(GL_TEXTURE_2D, texture.texture);
+            glTexStorage2D(GL_TEXTURE_2D, 1, slots[s].internalFormat, slots[s].width, slots[s].height);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        graph.pool.push_back(texture);
+    }
+    for (size_t i = 0; i < previous.size(); ++i)
+        if (previous[i].texture)
+            glDeleteTextures(1, &previous[i].texture);
+}
+
+// Passes writing the default framebuffer draw to it, they can not write anything else
+static bool build_framebuffer(FrameGraph & graph, FrameGraphPass & pass)
+{
+    bool backBuffer = false;
+    for (size_t i = 0; i < pass.writes.size(); ++i)
+    {
+        const FrameGraphResource & resource = graph.resources[pass.writes[i]];
+        backBuffer = backBuffer || (resource.imported && resource.texture == 0);
+    }
+    if (backBuffer)
+    {
+        if (pass.writes.size() > 1)
+        {
+            fprintf(stderr, "Frame graph : pass %s writes the default framebuffer and other textures\n", pass.name.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    glGenFramebuffers(1, &pass.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+    GLenum drawBuffers[FRAME_GRAPH_MAX_COLOR_ATTACHMENTS];
+    int colorCount = 0;
+    for (size_t i = 0; i < pass.writes.size(); ++i)
+    {
+        GLuint texture = frame_graph_texture(graph, pass.writes[i]);
+        GLenum format = graph.resources[pass.writes[i]].desc.internalFormat;
+        GLenum attachment;
+        if (is_stencil_format(format))
+            attachment = GL_DEPTH_STENCIL_ATTACHMENT;
+        else if (is_depth_format(format))
+            attachment = GL_DEPTH_ATTACHMENT;
+        else if (colorCount < FRAME_GRAPH_MAX_COLOR_ATTACHMENTS)
+        {
+            attachment = GL_COLOR_ATTACHMENT0 + colorCount;
+            drawBuffers[colorCount] = attachment;
+            ++colorCount;
+        }
+        else
+            continue;
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+    }
+    if (colorCount > 0)
+        glDrawBuffers(colorCount, drawBuffers);
+    else
+        glDrawBuffer(GL_NONE);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete)
+        fprintf(stderr, "Frame graph : framebuffer of pass %s is incomplete\n", pass.name.c_str());
+    return complete;
+}
+
+void frame_graph_init(FrameGraph & graph)
+{
+    graph.resources.clear();
+    graph.passes.clear();
+    graph.order.clear();
+    graph.pool.clear();
+    graph.stats.passes = graph.stats.culled = 0;
+    graph.stats.transients = graph.stats.textures = 0;
+    graph.stats.bytes = graph.stats.aliasedBytes = 0;
+}
+
+void frame_graph_release(FrameGraph & graph)
+{
+    release_framebuffers(graph);
+    for (size_t i = 0; i < graph.pool.size(); ++i)
+        glDeleteTextures(1, &graph.pool[i].texture);
+    graph.pool.clear();
+}
+
+int frame_graph_create_texture(FrameGraph & graph, const char * name, const FrameGraphTextureDesc & desc)
+{
+    FrameGraphResource resource;
+    resource.name = name;
+    resource.desc = desc;
+    resource.imported = false;
+    resource.texture = 0;
+    resource.physical = -1;
+    resource.firstUse = resource.lastUse = -1;
+    graph.resources.push_back(resource);
+    return int(graph.resources.size()) - 1;
+}
+
+int frame_graph_import_texture(FrameGraph & graph, const char * name, GLuint texture)
+{
+    FrameGraphTextureDesc desc = {0, 0, GL_NONE};
+    int resource = frame_graph_create_texture(graph, name, desc);
+    graph.resources[resource].imported = true;
+    graph.resources[resource].texture = texture;
+    return resource;
+}
+
+int frame_graph_add_pass(FrameGraph & graph, const char * name)
+{
+    FrameGraphPass pass;
+    pass.name = name;
+    pass.culled = false;
+    pass.framebuffer = 0;
+    graph.passes.push_back(pass);
+    return int(graph.passes.size()) - 1;
+}
+
+void frame_graph_read(FrameGraph & graph, int pass, int resource)
+{
+    graph.passes[pass].reads.push_back(resource);
+}
+
+void frame_graph_write(FrameGraph & graph, int pass, int resource)
+{
+    graph.passes[pass].writes.push_back(resource);
+}
+
+bool frame_graph_compile(FrameGraph & graph)
+{
+    release_framebuffers(graph);
+    cull_passes(graph);
+    // Every dependency points from a pass to a later one, the declaration order is valid
+    graph.order.clear();
+    for (size_t p = 0; p < graph.passes.size(); ++p)
+        if (!graph.passes[p].culled)
+            graph.order.push_back(int(p));
+    if (!check_reads(graph))
+        return false;
+
+    compute_lifetimes(graph);
+    std::vector<FrameGraphTextureDesc> slots;
+    assign_slots(graph, slots);
+    build_pool(graph, slots);
+
+    graph.stats.passes = int(graph.passes.size());
+    graph.stats.culled = int(graph.passes.size() - graph.order.size());
+    graph.stats.transients = 0;
+    graph.stats.textures = int(graph.pool.size());
+    graph.stats.bytes = graph.stats.aliasedBytes = 0;
+    for (size_t r = 0; r < graph.resources.size(); ++r)
+    {
+        if (graph.resources[r].physical < 0)
+            continue;
+        ++graph.stats.transients;
+        graph.stats.bytes += texture_bytes(graph.resources[r].desc);
+    }
+    // What stays allocated : the pool, textures of different descriptions can not share memory
+    for (size_t s = 0; s < graph.pool.size(); ++s)
+        graph.stats.aliasedBytes += texture_bytes(graph.pool[s].desc);
+
+    bool complete = true;
+    for (size_t i = 0; i < graph.order.size(); ++i)
+        complete = build_framebuffer(graph, graph.passes[graph.order[i]]) && complete;
+    return complete;
+}
+
+GLuint frame_graph_texture(const FrameGraph & graph, int resource)
+{
+    const FrameGraphResource & r = graph.resources[resource];
+    if (r.imported)
+        return r.texture;
+    return r.physical < 0 ? 0 : graph.pool[r.physical].texture;
+}
+
+GLuint frame_graph_framebuffer(const FrameGraph & graph, int pass)
+{
+    return graph.passes[pass].framebuffer;
+}
+
+bool frame_graph_culled(const FrameGraph & graph, int pass)
+{
+    return graph.passes[pass].culled;
+}
+
+void frame_graph_report(const FrameGraph & graph)
+{
+    const FrameGraphStats & stats = graph.stats;
+    fprintf(stdout, "Frame graph : %d passes, %d culled, %d transient targets in %d textures, %.2f MB without aliasing, %.2f MB with\n",
+            stats.passes, stats.culled, stats.transients, stats.textures,
+            stats.bytes / (1024. * 1024.), stats.aliasedBytes / (1024. * 1024.));
+    for (size_t i = 0; i < graph.order.size(); ++i)
+        fprintf(stdout, "Frame graph : %d %s\n", int(i), graph.passes[graph.order[i]].name.c_str());
+}
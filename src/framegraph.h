@@ -0,0 +1,88 @@
+#ifndef AOGL_FRAMEGRAPH_H
+#define AOGL_FRAMEGRAPH_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "glew/glew.h"
+
+struct FrameGraphTextureDesc
+{
+    int width;
+    int height;
+    GLenum internalFormat; // depth formats are attached as the depth buffer
+};
+
+// Texture a pass reads or writes. Transient ones are allocated by the graph and only
+// live between their first and last use, imported ones are owned by someone else.
+struct FrameGraphResource
+{
+    std::string name;
+    FrameGraphTextureDesc desc;
+    bool imported;
+    GLuint texture; // imported texture, 0 is the default framebuffer
+    int physical; // pool texture of a transient, -1 when culled
+    int firstUse; // index in order of the first and last live pass using it
+    int lastUse;
+};
+
+struct FrameGraphPass
+{
+    std::string name;
+    std::vector<int> reads;
+    std::vector<int> writes; // color attachments in this order, then the depth one
+    bool culled;
+    GLuint framebuffer;
+};
+
+// Texture of the pool, shared by the transients whose lifetimes do not overlap
+struct FrameGraphTexture
+{
+    FrameGraphTextureDesc desc;
+    GLuint texture;
+};
+
+struct FrameGraphStats
+{
+    int passes;
+    int culled;
+    int transients; // transient resources allocated
+    int textures; // pool textures backing them
+    size_t bytes; // one texture per transient
+    size_t aliasedBytes; // the pool textures, shared between transients
+};
+
+// Passes declare the textures they read and write, in submission order. Compiling culls
+// the passes whose writes nothing reads, imported textures always count as read, keeps
+// the others in submission order, then gives each transient a pool texture. GL 4.2 can
+// not place textures of different formats in the same memory, so aliasing means two
+// transients with the same description share one texture when the last use of the first
+// comes before the first use of the second. Each live pass gets a framebuffer with its
+// writes attached.
+struct FrameGraph
+{
+    std::vector<FrameGraphResource> resources;
+    std::vector<FrameGraphPass> passes;
+    std::vector<int> order; // live passes in execution order
+    std::vector<FrameGraphTexture> pool;
+    FrameGraphStats stats;
+};
+
+void frame_graph_init(FrameGraph & graph);
+// Delete the pool textures and the framebuffers
+void frame_graph_release(FrameGraph & graph);
+int frame_graph_create_texture(FrameGraph & graph, const char * name, const FrameGraphTextureDesc & desc);
+int frame_graph_import_texture(FrameGraph & graph, const char * name, GLuint texture);
+int frame_graph_add_pass(FrameGraph & graph, const char * name);
+void frame_graph_read(FrameGraph & graph, int pass, int resource);
+void frame_graph_write(FrameGraph & graph, int pass, int resource);
+// Call again after the passes or the descriptions changed, the pool textures are kept
+// when the new transients fit them. False if a resource is read before any write.
+bool frame_graph_compile(FrameGraph & graph);
+GLuint frame_graph_texture(const FrameGraph & graph, int resource);
+GLuint frame_graph_framebuffer(const FrameGraph & graph, int pass);
+bool frame_graph_culled(const FrameGraph & graph, int pass);
+void frame_graph_report(const FrameGraph & graph);
+
+#endif // AOGL_FRAMEGRAPH_H
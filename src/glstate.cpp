@@ -0,0 +1,155 @@
+#include "glstate.h"
+
+static const GLenum TEXTURE_TARGETS[GL_STATE_TEXTURE_TARGETS] = { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BUFFER };
+static const GLenum BUFFER_TARGETS[GL_STATE_BUFFER_TARGETS] = { GL_UNIFORM_BUFFER };
+static const GLenum CAPABILITIES[GL_STATE_CAPABILITIES] = { GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE };
+
+// Index of value in values, -1 if it is not there
+static int find_enum(const GLenum * values, int count, GLenum value)
+{
+    for (int i = 0; i < count; ++i)
+        if (values[i] == value)
+            return i;
+    return -1;
+}
+
+// True if shadow must be sent, shadow is then value
+static bool changes(GlState & state, GLuint & shadow, GLuint value)
+{
+    if (shadow == value)
+    {
+        ++state.stats.elided;
+        return false;
+    }
+    shadow = value;
+    ++state.stats.issued;
+    return true;
+}
+
+void gl_state_init(GlState & state)
+{
+    gl_state_invalidate(state);
+    state.stats.issued = state.stats.elided = 0;
+}
+
+void gl_state_invalidate(GlState & state)
+{
+    state.program = GL_STATE_UNKNOWN;
+    state.vertexArray = GL_STATE_UNKNOWN;
+    state.activeUnit = GL_STATE_UNKNOWN;
+    for (int i = 0; i < GL_STATE_TEXTURE_UNITS; ++i)
+        for (int j = 0; j < GL_STATE_TEXTURE_TARGETS; ++j)
+            state.textures[i][j] = GL_STATE_UNKNOWN;
+    for (int i = 0; i < GL_STATE_BUFFER_TARGETS; ++i)
+        state.buffers[i] = GL_STATE_UNKNOWN;
+    for (int i = 0; i < GL_STATE_CAPABILITIES; ++i)
+        state.capabilities[i] = GL_STATE_UNKNOWN;
+    state.blendSource = state.blendDestination = GL_STATE_UNKNOWN;
+    state.depthFunc = GL_STATE_UNKNOWN;
+    state.depthMask = GL_STATE_UNKNOWN;
+}
+
+void gl_state_use_program(GlState & state, GLuint program)
+{
+    if (changes(state, state.program, program))
+        glUseProgram(program);
+}
+
+void gl_state_bind_vertex_array(GlState & state, GLuint vertexArray)
+{
+    if (changes(state, state.vertexArray, vertexArray))
+        glBindVertexArray(vertexArray);
+}
+
+void gl_state_active_texture(GlState & state, GLuint unit)
+{
+    if (changes(state, state.activeUnit, unit))
+        glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void gl_state_bind_texture(GlState & state, GLuint unit, GLenum target, GLuint texture)
+{
+    int t = find_enum(TEXTURE_TARGETS, GL_STATE_TEXTURE_TARGETS, target);
+    if (unit >= GLuint(GL_STATE_TEXTURE_UNITS) || t < 0)
+    {
+        state.activeUnit = unit;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+        state.stats.issued += 2;
+        return;
+    }
+    if (state.textures[unit][t] == texture)
+    {
+        ++state.stats.elided;
+        return;
+    }
+    gl_state_active_texture(state, unit);
+    changes(state, state.textures[unit][t], texture);
+    glBindTexture(target, texture);
+}
+
+void gl_state_bind_buffer(GlState & state, GLenum target, GLuint buffer)
+{
+    int b = find_enum(BUFFER_TARGETS, GL_STATE_BUFFER_TARGETS, target);
+    if (b < 0)
+    {
+        ++state.stats.issued;
+        glBindBuffer(target, buffer);
+    }
+    else if (changes(state, state.buffers[b], buffer))
+        glBindBuffer(target, buffer);
+}
+
+void gl_state_bind_buffer_range(GlState & state, GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    int b = find_enum(BUFFER_TARGETS, GL_STATE_BUFFER_TARGETS, target);
+    if (b >= 0)
+        state.buffers[b] = buffer;
+    ++state.stats.issued;
+    glBindBufferRange(target, index, buffer, offset, size);
+}
+
+void gl_state_enable(GlState & state, GLenum capability, bool enabled)
+{
+    int c = find_enum(CAPABILITIES, GL_STATE_CAPABILITIES, capability);
+    if (c >= 0 && !changes(state, state.capabilities[c], enabled ? GL_TRUE : GL_FALSE))
+        return;
+    if (c < 0)
+        ++state.stats.issued;
+    if (enabled)
+        glEnable(capability);
+    else
+        glDisable(capability);
+}
+
+void gl_state_blend_func(GlState & state, GLenum source, GLenum destination)
+{
+    if (state.blendSource == source && state.blendDestination == destination)
+    {
+        ++state.stats.elided;
+        return;
+    }
+    state.blendSource = source;
+    state.blendDestination = destination;
+    ++state.stats.issued;
+    glBlendFunc(source, destination);
+}
+
+void gl_state_depth_func(GlState & state, GLenum func)
+{
+    if (changes(state, state.depthFunc, func))
+        glDepthFunc(func);
+}
+
+void gl_state_depth_mask(GlState & state, bool mask)
+{
+    if (changes(state, state.depthMask, mask ? GL_TRUE : GL_FALSE))
+        glDepthMask(mask ? GL_TRUE : GL_FALSE);
+}
+
+GlStateStats gl_state_frame(GlState & state)
+{
+    GlStateStats stats = state.stats;
+    state.stats.issued = state.stats.elided = 0;
+    return stats;
+}
@@ -0,0 +1,58 @@
+#ifndef AOGL_GLSTATE_H
+#define AOGL_GLSTATE_H
+
+#include "glew/glew.h"
+
+const int GL_STATE_TEXTURE_UNITS = 16;
+const int GL_STATE_TEXTURE_TARGETS = 3; // 2D, 2D array and buffer, other targets are not shadowed
+// Uniform buffers only, the modules bind the other targets themselves and leave them at 0
+const int GL_STATE_BUFFER_TARGETS = 1;
+const int GL_STATE_CAPABILITIES = 3; // depth test, blend and cull face
+// Shadowed value that does not match any real one, the next call is always issued
+const GLuint GL_STATE_UNKNOWN = 0xFFFFFFFF;
+
+// GL calls made through the cache since the last gl_state_frame
+struct GlStateStats
+{
+    int issued;
+    int elided; // already in that state, not sent
+};
+
+// Shadow of the binds and fixed function state the frame loop changes, calls that would
+// set what is already set are dropped. Only the calls made through the cache keep it
+// right : after code that binds or enables anything itself, call gl_state_invalidate.
+// Element array buffers are vertex array state and are never shadowed.
+struct GlState
+{
+    GLuint program;
+    GLuint vertexArray;
+    GLuint activeUnit;
+    GLuint textures[GL_STATE_TEXTURE_UNITS][GL_STATE_TEXTURE_TARGETS];
+    GLuint buffers[GL_STATE_BUFFER_TARGETS];
+    GLuint capabilities[GL_STATE_CAPABILITIES]; // GL_TRUE, GL_FALSE or GL_STATE_UNKNOWN
+    GLenum blendSource;
+    GLenum blendDestination;
+    GLenum depthFunc;
+    GLuint depthMask;
+    GlStateStats stats;
+};
+
+void gl_state_init(GlState & state);
+// Forget the shadowed state, the next call of each kind is issued
+void gl_state_invalidate(GlState & state);
+void gl_state_use_program(GlState & state, GLuint program);
+void gl_state_bind_vertex_array(GlState & state, GLuint vertexArray);
+void gl_state_active_texture(GlState & state, GLuint unit);
+// Leaves unit active
+void gl_state_bind_texture(GlState & state, GLuint unit, GLenum target, GLuint texture);
+void gl_state_bind_buffer(GlState & state, GLenum target, GLuint buffer);
+// Indexed binds are not shadowed, always issued, but they also bind the generic target
+void gl_state_bind_buffer_range(GlState & state, GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+void gl_state_enable(GlState & state, GLenum capability, bool enabled);
+void gl_state_blend_func(GlState & state, GLenum source, GLenum destination);
+void gl_state_depth_func(GlState & state, GLenum func);
+void gl_state_depth_mask(GlState & state, bool mask);
+// Calls issued and elided since the last call, once per frame
+GlStateStats gl_state_frame(GlState & state);
+
+#endif // AOGL_GLSTATE_H
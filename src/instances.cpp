@@ -0,0 +1,152 @@
+#include "instances.h"
+
+#include <cmath>
+
+void instance_buffer_init(InstanceBuffer & ib, size_t capacity)
+{
+    glGenBuffers(1, &ib.buffer);
+    ib.capacity = capacity > 0 ? capacity : 1;
+    ib.instances.reserve(ib.capacity);
+    ib.dirtyBegin = 0;
+    ib.dirtyEnd = 0;
+
+    glBindBuffer(GL_ARRAY_BUFFER, ib.buffer);
+    glBufferData(GL_ARRAY_BUFFER, ib.capacity * sizeof(Instance), 0, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void instance_buffer_release(InstanceBuffer & ib)
+{
+    glDeleteBuffers(1, &ib.buffer);
+    ib.buffer = 0;
+    ib.capacity = 0;
+    ib.instances.clear();
+    ib.dirtyBegin = ib.dirtyEnd = 0;
+}
+
+void instance_buffer_mark_dirty(InstanceBuffer & ib, size_t begin, size_t end)
+{
+    if (begin >= end)
+        return;
+    if (ib.dirtyBegin == ib.dirtyEnd)
+    {
+        ib.dirtyBegin = begin;
+        ib.dirtyEnd = end;
+        return;
+    }
+    ib.dirtyBegin = begin < ib.dirtyBegin ? begin : ib.dirtyBegin;
+    ib.dirtyEnd = end > ib.dirtyEnd ? end : ib.dirtyEnd;
+}
+
+size_t instance_buffer_add(InstanceBuffer & ib, const Instance & instance)
+{
+    size_t index = ib.instances.size();
+    ib.instances.push_back(instance);
+    instance_buffer_mark_dirty(ib, index, index + 1);
+    return index;
+}
+
+Instance & instance_buffer_edit(InstanceBuffer & ib, size_t index)
+{
+    instance_buffer_mark_dirty(ib, index, index + 1);
+    return ib.instances[index];
+}
+
+void instance_buffer_upload(InstanceBuffer & ib)
+{
+    if (ib.dirtyBegin == ib.dirtyEnd)
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, ib.buffer);
+    if (ib.instances.size() > ib.capacity)
+    {
+        // Grow the storage, the buffer name stays the same so vaos keep working
+        while (ib.capacity < ib.instances.size())
+            ib.capacity *= 2;
+        glBufferData(GL_ARRAY_BUFFER, ib.capacity * sizeof(Instance), 0, GL_DYNAMIC_DRAW);
+        ib.dirtyBegin = 0;
+        ib.dirtyEnd = ib.instances.size();
+    }
+    glBufferSubData(GL_ARRAY_BUFFER,
+                    ib.dirtyBegin * sizeof(Instance),
+                    (ib.dirtyEnd - ib.dirtyBegin) * sizeof(Instance),
+                    &ib.instances[ib.dirtyBegin]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    ib.dirtyBegin = ib.dirtyEnd = 0;
+}
+
+void instance_buffer_bind_attributes(const InstanceBuffer & ib, GLuint vao)
+{
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, ib.buffer);
+
+    glEnableVertexAttribArray(INSTANCE_TRANSFORM);
+    glVertexAttribPointer(INSTANCE_TRANSFORM, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)0);
+    glVertexAttribDivisor(INSTANCE_TRANSFORM, 1);
+
+    glEnableVertexAttribArray(INSTANCE_ROTATION);
+    glVertexAttribPointer(INSTANCE_ROTATION, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(sizeof(float)*4));
+    glVertexAttribDivisor(INSTANCE_ROTATION, 1);
+
+    glEnableVertexAttribArray(INSTANCE_MATERIAL);
+    glVertexAttribIPointer(INSTANCE_MATERIAL, 1, GL_UNSIGNED_INT, sizeof(Instance), (void*)(sizeof(float)*8));
+    glVertexAttribDivisor(INSTANCE_MATERIAL, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+size_t instances_add_grid(InstanceBuffer & ib, int count, glm::vec3 origin, float spacing, GLuint materialId)
+{
+    size_t first = ib.instances.size();
+    int side = int(std::sqrt(float(count)));
+    if (side < 1)
+        side = 1;
+    for (int i = 0; i < count; ++i)
+    {
+        glm::vec3 pos = origin + glm::vec3(i % side, 0, i / side) * spacing;
+        ib.instances.push_back(Instance(pos, 1, glm::quat(), materialId));
+    }
+    instance_buffer_mark_dirty(ib, first, ib.instances.size());
+    return first;
+}
+
+size_t instances_add_grid_chunks(InstanceBuffer & ib, int count, glm::vec3 origin, float spacing, GLuint materialId,
+                                 int chunkSize, std::vector<InstanceChunk> & chunks)
+{
+    size_t first = ib.instances.size();
+    int side = int(std::sqrt(float(count)));
+    if (side < 1)
+        side = 1;
+    int rows = (count + side - 1) / side;
+
+    // Same cells as instances_add_grid, visited tile by tile
+    for (int tz = 0; tz < rows; tz += chunkSize)
+    {
+        for (int tx = 0; tx < side; tx += chunkSize)
+        {
+            InstanceChunk chunk;
+            chunk.first = ib.instances.size();
+            chunk.center = glm::vec3(0, 0, 0);
+            for (int z = tz; z < tz + chunkSize && z < rows; ++z)
+            {
+                for (int x = tx; x < tx + chunkSize && x < side; ++x)
+                {
+                    if (z * side + x >= count)
+                        continue;
+                    glm::vec3 pos = origin + glm::vec3(x, 0, z) * spacing;
+                    ib.instances.push_back(Instance(pos, 1, glm::quat(), materialId));
+                    chunk.center += pos;
+                }
+            }
+            chunk.count = ib.instances.size() - chunk.first;
+            if (chunk.count == 0)
+                continue;
+            chunk.center /= float(chunk.count);
+            chunks.push_back(chunk);
+        }
+    }
+    instance_buffer_mark_dirty(ib, first, ib.instances.size());
+    return first;
+}
@@ -0,0 +1,72 @@
+#ifndef AOGL_INSTANCES_H
+#define AOGL_INSTANCES_H
+
+#include <vector>
+
+#include "glew/glew.h"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp" // glm::quat
+
+// Vertex attribute locations used by the per-instance stream, must match the
+// INSTANCE_* defines of the geometry pass vertex shaders
+enum InstanceAttribute
+{
+    INSTANCE_TRANSFORM = 3, // xyz position, w uniform scale
+    INSTANCE_ROTATION = 4,  // quaternion
+    INSTANCE_MATERIAL = 5
+};
+
+// One instance as seen by the GPU (48 bytes)
+struct Instance
+{
+    glm::vec3 _pos;
+    float _scale; //16
+    glm::quat _rotation; //32
+    GLuint _materialId;
+    int _padding[3]; //48
+
+    Instance(glm::vec3 pos = glm::vec3(0,0,0), float scale = 1, glm::quat rotation = glm::quat(), GLuint materialId = 0){
+        _pos = pos;
+        _scale = scale;
+        _rotation = rotation;
+        _materialId = materialId;
+        _padding[0] = _padding[1] = _padding[2] = 0;
+    }
+};
+
+// CPU owned copy of the instance data and its GPU mirror. Edits only widen
+// the [dirtyBegin, dirtyEnd) range, the upload sends that range and nothing else.
+struct InstanceBuffer
+{
+    GLuint buffer;
+    size_t capacity;
+    std::vector<Instance> instances;
+    size_t dirtyBegin;
+    size_t dirtyEnd;
+};
+
+void instance_buffer_init(InstanceBuffer & ib, size_t capacity);
+void instance_buffer_release(InstanceBuffer & ib);
+size_t instance_buffer_add(InstanceBuffer & ib, const Instance & instance);
+Instance & instance_buffer_edit(InstanceBuffer & ib, size_t index);
+void instance_buffer_mark_dirty(InstanceBuffer & ib, size_t begin, size_t end);
+void instance_buffer_upload(InstanceBuffer & ib);
+// Bind the instance stream to the INSTANCE_* attributes of vao
+void instance_buffer_bind_attributes(const InstanceBuffer & ib, GLuint vao);
+
+// Contiguous run of instances close to each other, drawn with one command
+struct InstanceChunk
+{
+    size_t first;
+    size_t count;
+    glm::vec3 center;
+};
+
+// Append count instances laid out on a square grid in the xz plane, returns the first index
+size_t instances_add_grid(InstanceBuffer & ib, int count, glm::vec3 origin, float spacing, GLuint materialId);
+// Same grid stored as chunkSize x chunkSize tiles, each tile contiguous in the buffer
+size_t instances_add_grid_chunks(InstanceBuffer & ib, int count, glm::vec3 origin, float spacing, GLuint materialId,
+                                 int chunkSize, std::vector<InstanceChunk> & chunks);
+
+#endif // AOGL_INSTANCES_H
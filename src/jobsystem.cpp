@@ -0,0 +1,287 @@
+#include "jobsystem.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Queue of the calling thread, 0 on every thread that is not a worker
+static thread_local int jobThreadIndex = 0;
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Newest job of the own queue, else the oldest of another one
+static bool pop_job(JobSystem & system, int self, Job & job)
+{
+    int queueCount = int(system.queues.size());
+    for (int i = 0; i < queueCount; ++i)
+    {
+        JobQueue & queue = *system.queues[(self + i) % queueCount];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty())
+            continue;
+        if (i == 0)
+        {
+            job = queue.jobs.back();
+            queue.jobs.pop_back();
+        }
+        else
+        {
+            job = queue.jobs.front();
+            queue.jobs.pop_front();
+        }
+        --system.queued;
+        return true;
+    }
+    return false;
+}
+
+static void run_job(JobSystem & system, int self, const Job & job)
+{
+    if (system.profiling)
+    {
+        JobMarker marker;
+        marker.name = job.name;
+        marker.thread = self;
+        marker.start = elapsed_ms(system.start);
+        job.function(job.user);
+        marker.end = elapsed_ms(system.start);
+        JobQueue & queue = *system.queues[self];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.markers.push_back(marker);
+    }
+    else
+        job.function(job.user);
+    // Taking the lock orders the decrement before the check of a waiter going to sleep
+    if (job.counter && --job.counter->pending == 0)
+    {
+        std::lock_guard<std::mutex> lock(system.doneMutex);
+        system.counterDone.notify_all();
+    }
+}
+
+static void job_worker(JobSystem * system, int index, bool pin)
+{
+    jobThreadIndex = index;
+    if (pin)
+        job_system_pin_thread(index);
+    for (;;)
+    {
+        Job job;
+        if (pop_job(*system, index, job))
+        {
+            run_job(*system, index, job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(system->sleepMutex);
+        while (system->queued == 0 && !system->stop)
+            system->jobAdded.wait(lock);
+        if (system->queued == 0 && system->stop)
+            return;
+    }
+}
+
+void job_system_init(JobSystem & system, int threadCount, bool pinWorkers)
+{
+    if (threadCount < 0)
+    {
+        threadCount = int(std::thread::hardware_concurrency()) - 1;
+        if (threadCount < 1)
+            threadCount = 1;
+    }
+    system.queued = 0;
+    system.stop = false;
+    system.profiling = false;
+    system.start = std::chrono::steady_clock::now();
+    for (int i = 0; i <= threadCount; ++i)
+        system.queues.push_back(new JobQueue);
+    for (int i = 1; i <= threadCount; ++i)
+        system.threads.push_back(std::thread(job_worker, &system, i, pinWorkers));
+}
+
+void job_system_release(JobSystem & system)
+{
+    {
+        std::lock_guard<std::mutex> lock(system.sleepMutex);
+        system.stop = true;
+    }
+    system.jobAdded.notify_all();
+    for (size_t i = 0; i < system.threads.size(); ++i)
+        system.threads[i].join();
+    system.threads.clear();
+    for (size_t i = 0; i < system.queues.size(); ++i)
+        delete system.queues[i];
+    system.queues.clear();
+}
+
+bool job_system_pin_thread(int core)
+{
+#ifdef __linux__
+    int coreCount = int(std::thread::hardware_concurrency());
+    if (coreCount < 1)
+        return false;
+    cpu_set_t cores;
+    CPU_ZERO(&cores);
+    CPU_SET(core % coreCount, &cores);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cores), &cores) == 0;
+#else
+    (void)core;
+    return false;
+#endif
+}
+
+void job_counter_init(JobCounter & counter)
+{
+    counter.pending = 0;
+}
+
+void job_system_run(JobSystem & system, const char * name, JobFunction function, void * user, JobCounter * counter)
+{
+    Job job = {function, user, counter, name};
+    if (counter)
+        ++counter->pending;
+    {
+        JobQueue & queue = *system.queues[jobThreadIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(job);
+    }
+    ++system.queued;
+    // Taking the lock orders the increment before the check of a worker going to sleep
+    {
+        std::lock_guard<std::mutex> lock(system.sleepMutex);
+    }
+    system.jobAdded.notify_one();
+}
+
+// A job of counter at the end of a queue the caller would pop from : the newest of its
+// own queue, the oldest of the others. The children a thread waits on are pushed to its
+// own queue, so they sit at the back unless another thread took them. Without workers
+// any job is taken, nobody else would run it.
+static bool pop_counter_job(JobSystem & system, int self, JobCounter & counter, Job & job)
+{
+    if (system.threads.empty())
+        return pop_job(system, self, job);
+    int queueCount = int(system.queues.size());
+    for (int i = 0; i < queueCount; ++i)
+    {
+        JobQueue & queue = *system.queues[(self + i) % queueCount];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty())
+            continue;
+        if (i == 0 && queue.jobs.back().counter == &counter)
+        {
+            job = queue.jobs.back();
+            queue.jobs.pop_back();
+        }
+        else if (i > 0 && queue.jobs.front().counter == &counter)
+        {
+            job = queue.jobs.front();
+            queue.jobs.pop_front();
+        }
+        else
+            continue;
+        --system.queued;
+        return true;
+    }
+    return false;
+}
+
+void job_system_wait(JobSystem & system, JobCounter & counter)
+{
+    int self = jobThreadIndex;
+    while (counter.pending > 0)
+    {
+        Job job;
+        if (pop_counter_job(system, self, counter, job))
+        {
+            run_job(system, self, job);
+            continue;
+        }
+        // The rest runs on other threads, sleep until a counter reaches zero and look again
+        std::unique_lock<std::mutex> lock(system.doneMutex);
+        if (counter.pending > 0)
+            system.counterDone.wait(lock);
+    }
+}
+
+struct JobRange
+{
+    JobRangeFunction function;
+    void * user;
+    int begin;
+    int end;
+};
+
+static void range_job(void * user)
+{
+    JobRange & range = *(JobRange *)user;
+    range.function(range.user, range.begin, range.end);
+}
+
+void job_system_parallel_for(JobSystem & system, const char * name, int count, int grain, JobRangeFunction function, void * user)
+{
+    if (count <= 0)
+        return;
+    grain = std::max(grain, 1);
+    std::vector<JobRange> ranges((count + grain - 1) / grain);
+    JobCounter counter;
+    job_counter_init(counter);
+    // The calling thread takes the first range itself
+    for (size_t i = 0; i < ranges.size(); ++i)
+    {
+        JobRange range = {function, user, int(i) * grain, std::min(int(i + 1) * grain, count)};
+        ranges[i] = range;
+        if (i > 0)
+            job_system_run(system, name, range_job, &ranges[i], &counter);
+    }
+    range_job(&ranges[0]);
+    job_system_wait(system, counter);
+}
+
+void job_system_set_profiling(JobSystem & system, bool profiling)
+{
+    system.profiling = profiling;
+}
+
+void job_system_markers(JobSystem & system, std::vector<JobMarker> & markers)
+{
+    markers.clear();
+    for (size_t i = 0; i < system.queues.size(); ++i)
+    {
+        JobQueue & queue = *system.queues[i];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        markers.insert(markers.end(), queue.markers.begin(), queue.markers.end());
+        queue.markers.clear();
+    }
+}
+
+void job_system_report(JobSystem & system)
+{
+    std::vector<JobMarker> markers;
+    job_system_markers(system, markers);
+    std::vector<const char *> names;
+    std::vector<int> counts;
+    std::vector<double> times;
+    for (size_t i = 0; i < markers.size(); ++i)
+    {
+        size_t n = 0;
+        while (n < names.size() && strcmp(names[n], markers[i].name) != 0)
+            ++n;
+        if (n == names.size())
+        {
+            names.push_back(markers[i].name);
+            counts.push_back(0);
+            times.push_back(0.0);
+        }
+        ++counts[n];
+        times[n] += markers[i].end - markers[i].start;
+    }
+    for (size_t n = 0; n < names.size(); ++n)
+        fprintf(stdout, "Jobs : %s ran %d times, %.3f ms in all, %.3f ms each\n", names[n], counts[n], times[n], times[n] / counts[n]);
+}
@@ -0,0 +1,88 @@
+#ifndef AOGL_JOBSYSTEM_H
+#define AOGL_JOBSYSTEM_H
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+
+typedef void (*JobFunction)(void * user);
+// Runs the items [begin, end) of a parallel for
+typedef void (*JobRangeFunction)(void * user, int begin, int end);
+
+// Jobs of a parent not done yet. A job can run children on its own counter and wait
+// for them, the wait runs the children still queued meanwhile and sleeps otherwise.
+struct JobCounter
+{
+    std::atomic<int> pending;
+};
+
+struct Job
+{
+    JobFunction function;
+    void * user;
+    JobCounter * counter;
+    const char * name; // profiler marker
+};
+
+// One run of a job, in ms since job_system_init
+struct JobMarker
+{
+    const char * name;
+    int thread;
+    double start;
+    double end;
+};
+
+// Jobs pushed by a thread go in its deque, it takes them back newest first while idle
+// threads steal the oldest ones. Queue 0 belongs to the threads that are not workers.
+struct JobQueue
+{
+    std::mutex mutex;
+    std::deque<Job> jobs;
+    std::vector<JobMarker> markers;
+};
+
+// Fixed set of workers sharing the CPU work of the engine. Jobs must not block on I/O,
+// a blocked job holds its worker, the file reads stay on the ThreadPool. Jobs must not
+// touch GL either.
+struct JobSystem
+{
+    std::vector<JobQueue *> queues;
+    std::vector<std::thread> threads;
+    std::mutex sleepMutex;
+    std::condition_variable jobAdded;
+    std::mutex doneMutex;
+    std::condition_variable counterDone; // a counter reached zero
+    std::atomic<int> queued;
+    std::atomic<bool> stop;
+    bool profiling;
+    std::chrono::steady_clock::time_point start;
+};
+
+// threadCount -1 uses one worker per core minus the calling thread, with 0 the jobs only
+// run in the waits of the calling thread. With pinWorkers, worker i runs on core i + 1
+// and core 0 is left to the render thread.
+void job_system_init(JobSystem & system, int threadCount, bool pinWorkers);
+// Finish the queued jobs and join the workers
+void job_system_release(JobSystem & system);
+// Pin the calling thread to core, false where thread affinity is not supported
+bool job_system_pin_thread(int core);
+void job_counter_init(JobCounter & counter);
+// counter may be 0 for a job nobody waits for
+void job_system_run(JobSystem & system, const char * name, JobFunction function, void * user, JobCounter * counter);
+// Only runs the jobs of counter, so the caller never ends up behind a long job it does not
+// need, and sleeps while the others finish them
+void job_system_wait(JobSystem & system, JobCounter & counter);
+// Split [0, count) in ranges of grain items, run them and wait
+void job_system_parallel_for(JobSystem & system, const char * name, int count, int grain, JobRangeFunction function, void * user);
+void job_system_set_profiling(JobSystem & system, bool profiling);
+// Markers of the jobs run since the last call, then forget them
+void job_system_markers(JobSystem & system, std::vector<JobMarker> & markers);
+// Count and time of each job name since the last call
+void job_system_report(JobSystem & system);
+
+#endif // AOGL_JOBSYSTEM_H
@@ -0,0 +1,96 @@
+#include "ktx.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const unsigned char KTX_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+bool ktx_write(const char * path, GLenum internalFormat, GLenum baseFormat, int width, int height,
+               const std::vector< std::vector<unsigned char> > & levels)
+{
+    KtxHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+    header.endianness = KTX_ENDIANNESS;
+    // Compressed data : type and format are 0, the type size 1
+    header.glTypeSize = 1;
+    header.glInternalFormat = internalFormat;
+    header.glBaseInternalFormat = baseFormat;
+    header.pixelWidth = width;
+    header.pixelHeight = height;
+    header.numberOfFaces = 1;
+    header.numberOfMipmapLevels = (unsigned int)levels.size();
+
+    FILE * f = fopen(path, "wb");
+    if (!f)
+        return false;
+
+    static const unsigned char zeros[3] = {0};
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    for (size_t i = 0; ok && i < levels.size(); ++i)
+    {
+        unsigned int size = (unsigned int)levels[i].size();
+        unsigned int padding = (4 - size % 4) % 4;
+        ok = fwrite(&size, sizeof(size), 1, f) == 1;
+        ok = ok && (levels[i].empty() || fwrite(&levels[i][0], 1, size, f) == size);
+        ok = ok && fwrite(zeros, 1, padding, f) == padding;
+    }
+    ok = fclose(f) == 0 && ok;
+    return ok;
+}
+
+bool ktx_map(KtxView & view, const char * path)
+{
+    view.header = 0;
+    view.levelCount = 0;
+    if (!mapped_file_open(view.file, path))
+        return false;
+
+    const KtxHeader * header = (const KtxHeader *)view.file.data;
+    if (view.file.size < sizeof(KtxHeader) || memcmp(header->identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0)
+    {
+        fprintf(stderr, "Ktx file %s : not a ktx file\n", path);
+        ktx_unmap(view);
+        return false;
+    }
+    if (header->endianness != KTX_ENDIANNESS || header->glFormat != 0 || header->pixelDepth != 0
+        || header->numberOfArrayElements != 0 || header->numberOfFaces != 1
+        || header->numberOfMipmapLevels == 0 || header->numberOfMipmapLevels > KTX_MAX_LEVELS)
+    {
+        fprintf(stderr, "Ktx file %s : only compressed 2D textures are supported\n", path);
+        ktx_unmap(view);
+        return false;
+    }
+
+    size_t offset = sizeof(KtxHeader) + header->bytesOfKeyValueData;
+    for (unsigned int i = 0; i < header->numberOfMipmapLevels; ++i)
+    {
+        if (offset + 4 > view.file.size)
+            break;
+        unsigned int size;
+        memcpy(&size, view.file.data + offset, sizeof(size));
+        offset += 4;
+        if (offset + size > view.file.size)
+            break;
+        view.levels[i] = view.file.data + offset;
+        view.levelSizes[i] = size;
+        offset += (size + 3) & ~3u;
+        view.levelCount = i + 1;
+    }
+    if (view.levelCount != header->numberOfMipmapLevels)
+    {
+        fprintf(stderr, "Ktx file %s : truncated\n", path);
+        ktx_unmap(view);
+        return false;
+    }
+
+    view.header = header;
+    return true;
+}
+
+void ktx_unmap(KtxView & view)
+{
+    mapped_file_close(view.file);
+    view.header = 0;
+    view.levelCount = 0;
+}
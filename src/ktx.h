@@ -0,0 +1,51 @@
+#ifndef AOGL_KTX_H
+#define AOGL_KTX_H
+
+#include <vector>
+
+#include "glew/glew.h"
+
+#include "mappedfile.h"
+
+// KTX 1.1 container (.ktx) for the compressed 2D textures written by texcook : the
+// header, no key value data, then each mip level as its byte size followed by its
+// blocks padded to 4 bytes. Only little endian, single face, non array files are read.
+const unsigned int KTX_ENDIANNESS = 0x04030201;
+const unsigned int KTX_MAX_LEVELS = 16;
+
+struct KtxHeader
+{
+    unsigned char identifier[12];
+    unsigned int endianness;
+    unsigned int glType;
+    unsigned int glTypeSize;
+    unsigned int glFormat;
+    unsigned int glInternalFormat;
+    unsigned int glBaseInternalFormat;
+    unsigned int pixelWidth;
+    unsigned int pixelHeight;
+    unsigned int pixelDepth;
+    unsigned int numberOfArrayElements;
+    unsigned int numberOfFaces;
+    unsigned int numberOfMipmapLevels;
+    unsigned int bytesOfKeyValueData;
+};
+
+// Header and levels of a mapped ktx file, pointers are into the mapping
+struct KtxView
+{
+    MappedFile file;
+    const KtxHeader * header;
+    unsigned int levelCount;
+    const unsigned char * levels[KTX_MAX_LEVELS];
+    unsigned int levelSizes[KTX_MAX_LEVELS];
+};
+
+// Write a compressed texture, levels[0] is the base level, returns false on io error
+bool ktx_write(const char * path, GLenum internalFormat, GLenum baseFormat, int width, int height,
+               const std::vector< std::vector<unsigned char> > & levels);
+// Map path and check its header, returns false if it is not a compressed 2D ktx file
+bool ktx_map(KtxView & view, const char * path);
+void ktx_unmap(KtxView & view);
+
+#endif // AOGL_KTX_H
@@ -0,0 +1,101 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+
+bool mapped_file_open(MappedFile & file, const char * path)
+{
+    file.data = 0;
+    file.size = 0;
+    file.mapping = 0;
+    file.file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (file.file == INVALID_HANDLE_VALUE)
+    {
+        file.file = 0;
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file.file, &size) || size.QuadPart == 0)
+    {
+        mapped_file_close(file);
+        return false;
+    }
+    file.mapping = CreateFileMappingA(file.file, 0, PAGE_READONLY, 0, 0, 0);
+    if (!file.mapping)
+    {
+        mapped_file_close(file);
+        return false;
+    }
+    file.data = (const unsigned char *)MapViewOfFile(file.mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!file.data)
+    {
+        mapped_file_close(file);
+        return false;
+    }
+    file.size = size_t(size.QuadPart);
+    return true;
+}
+
+void mapped_file_close(MappedFile & file)
+{
+    if (file.data)
+        UnmapViewOfFile(file.data);
+    if (file.mapping)
+        CloseHandle(file.mapping);
+    if (file.file)
+        CloseHandle(file.file);
+    file.data = 0;
+    file.size = 0;
+    file.mapping = 0;
+    file.file = 0;
+}
+
+#else
+
+bool mapped_file_open(MappedFile & file, const char * path)
+{
+    file.data = 0;
+    file.size = 0;
+    file.fd = open(path, O_RDONLY);
+    if (file.fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(file.fd, &st) != 0 || st.st_size == 0)
+    {
+        mapped_file_close(file);
+        return false;
+    }
+    void * data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, file.fd, 0);
+    if (data == MAP_FAILED)
+    {
+        mapped_file_close(file);
+        return false;
+    }
+    // The whole file is uploaded right away
+    madvise(data, st.st_size, MADV_WILLNEED);
+    file.data = (const unsigned char *)data;
+    file.size = size_t(st.st_size);
+    return true;
+}
+
+void mapped_file_close(MappedFile & file)
+{
+    if (file.data)
+        munmap((void *)file.data, file.size);
+    if (file.fd >= 0)
+        close(file.fd);
+    file.data = 0;
+    file.size = 0;
+    file.fd = -1;
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef AOGL_MAPPEDFILE_H
+#define AOGL_MAPPEDFILE_H
+
+#include <stddef.h>
+
+// Read only memory mapping of a whole file
+struct MappedFile
+{
+    const unsigned char * data;
+    size_t size;
+#ifdef _WIN32
+    void * file;
+    void * mapping;
+#else
+    int fd;
+#endif
+};
+
+// Returns false and leaves file empty if the file can not be opened or mapped
+bool mapped_file_open(MappedFile & file, const char * path);
+void mapped_file_close(MappedFile & file);
+
+#endif // AOGL_MAPPEDFILE_H
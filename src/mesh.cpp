@@ -0,0 +1,81 @@
+#include "mesh.h"
+
+void vertex_format_set_attributes(const VertexFormat & format, GLintptr baseOffset)
+{
+    GLsizei stride = format.stride;
+
+    glEnableVertexAttribArray(MESH_POSITION);
+    glVertexAttribPointer(MESH_POSITION, 3, format.position == POSITION_FLOAT ? GL_FLOAT : GL_HALF_FLOAT,
+                          GL_FALSE, stride, (void*)baseOffset);
+
+    glEnableVertexAttribArray(MESH_NORMAL);
+    if (format.normal == NORMAL_FLOAT)
+        glVertexAttribPointer(MESH_NORMAL, 3, GL_FLOAT, GL_FALSE, stride, (void*)(baseOffset + format.normalOffset));
+    else
+        glVertexAttribPointer(MESH_NORMAL, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)(baseOffset + format.normalOffset));
+
+    glEnableVertexAttribArray(MESH_TEXCOORD);
+    switch (format.texcoord)
+    {
+    case TEXCOORD_FLOAT:
+        glVertexAttribPointer(MESH_TEXCOORD, 2, GL_FLOAT, GL_FALSE, stride, (void*)(baseOffset + format.texcoordOffset));
+        break;
+    case TEXCOORD_HALF:
+        glVertexAttribPointer(MESH_TEXCOORD, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)(baseOffset + format.texcoordOffset));
+        break;
+    default:
+        glVertexAttribPointer(MESH_TEXCOORD, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)(baseOffset + format.texcoordOffset));
+        break;
+    }
+}
+
+void mesh_init(Mesh & mesh, const MeshData & data, bool quantize)
+{
+    VertexFormat format = vertex_format_choose(data, quantize);
+    int vertexCount = int(data.positions.size() / 3);
+    GLenum indexType = quantize ? index_type_choose(vertexCount) : GL_UNSIGNED_INT;
+
+    std::vector<unsigned char> vertices;
+    std::vector<unsigned char> indices;
+    vertex_format_pack(format, data, vertices);
+    index_pack(indexType, data, indices);
+
+    mesh_init_packed(mesh, format, indexType, &vertices[0], vertexCount, &indices[0], int(data.indices.size()));
+}
+
+void mesh_init_packed(Mesh & mesh, const VertexFormat & format, GLenum indexType, const void * vertices, int vertexCount, const void * indices, int indexCount)
+{
+    mesh.format = format;
+    mesh.indexType = indexType;
+    mesh.vertexCount = vertexCount;
+    mesh.indexCount = indexCount;
+
+    glGenVertexArrays(1, &mesh.vao);
+    glGenBuffers(2, mesh.buffers);
+
+    glBindVertexArray(mesh.vao);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.buffers[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(indexCount) * index_type_size(indexType), indices, GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(vertexCount) * format.stride, vertices, GL_STATIC_DRAW);
+    vertex_format_set_attributes(format, 0);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void mesh_release(Mesh & mesh)
+{
+    glDeleteVertexArrays(1, &mesh.vao);
+    glDeleteBuffers(2, mesh.buffers);
+    mesh.vao = 0;
+    mesh.vertexCount = mesh.indexCount = 0;
+}
+
+void mesh_print_format(const char * name, const Mesh & mesh, int instanceCount)
+{
+    vertex_format_print(name, mesh.format, mesh.indexType, mesh.vertexCount, mesh.indexCount, instanceCount);
+}
@@ -0,0 +1,96 @@
+#ifndef AOGL_MESH_H
+#define AOGL_MESH_H
+
+#include <vector>
+
+#include "glew/glew.h"
+
+// Vertex attribute locations shared by every mesh
+enum MeshAttribute
+{
+    MESH_POSITION = 0,
+    MESH_NORMAL = 1,
+    MESH_TEXCOORD = 2
+};
+
+enum PositionFormat
+{
+    POSITION_FLOAT,  // 3 x GL_FLOAT, 12 bytes
+    POSITION_HALF    // 3 x GL_HALF_FLOAT padded to 8 bytes
+};
+
+enum NormalFormat
+{
+    NORMAL_FLOAT,    // 3 x GL_FLOAT, 12 bytes
+    NORMAL_PACKED    // GL_INT_2_10_10_10_REV, 4 bytes
+};
+
+enum TexCoordFormat
+{
+    TEXCOORD_FLOAT,  // 2 x GL_FLOAT, 8 bytes
+    TEXCOORD_HALF,   // 2 x GL_HALF_FLOAT, 4 bytes
+    TEXCOORD_UNORM16 // 2 x normalized GL_UNSIGNED_SHORT, 4 bytes, uvs in [0, 1] only
+};
+
+// Layout of the single interleaved vertex stream of a mesh
+struct VertexFormat
+{
+    unsigned char position;
+    unsigned char normal;
+    unsigned char texcoord;
+    unsigned char normalOffset;
+    unsigned char texcoordOffset;
+    unsigned char stride;
+};
+
+// Mesh as loaded, before packing. Positions and normals are xyz, uvs are xy.
+struct MeshData
+{
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<float> uvs;
+    std::vector<unsigned int> indices;
+};
+
+struct Mesh
+{
+    GLuint vao;
+    GLuint buffers[2]; // vertices, indices
+    VertexFormat format;
+    GLenum indexType;
+    int vertexCount;
+    int indexCount;
+};
+
+// Largest position error accepted when quantizing positions to half floats
+const float MESH_HALF_POSITION_TOLERANCE = 0.001f;
+
+void mesh_data_from_arrays(MeshData & data, const float * positions, const float * normals, const float * uvs, int vertexCount, const int * indices, int indexCount);
+// Average uv units per object space unit, square root of the uv area over the surface area.
+// Texture streaming scales it by the texture size to get the texel density of the mesh.
+float mesh_data_uv_density(const MeshData & data);
+
+// Pick the smallest formats that keep the mesh within tolerance. If quantize is false
+// the full float layout is returned.
+VertexFormat vertex_format_choose(const MeshData & data, bool quantize);
+VertexFormat vertex_format_make(PositionFormat position, NormalFormat normal, TexCoordFormat texcoord);
+// Setup the MESH_* attributes of the bound vao from the bound GL_ARRAY_BUFFER
+void vertex_format_set_attributes(const VertexFormat & format, GLintptr baseOffset);
+void vertex_format_pack(const VertexFormat & format, const MeshData & data, std::vector<unsigned char> & vertices);
+
+// 16 bit indices when every index fits
+GLenum index_type_choose(int vertexCount);
+void index_pack(GLenum indexType, const MeshData & data, std::vector<unsigned char> & indices);
+int index_type_size(GLenum indexType);
+
+void mesh_init(Mesh & mesh, const MeshData & data, bool quantize);
+// Upload vertices and indices already packed with format and indexType, as stored by cooked mesh files
+void mesh_init_packed(Mesh & mesh, const VertexFormat & format, GLenum indexType, const void * vertices, int vertexCount, const void * indices, int indexCount);
+void mesh_release(Mesh & mesh);
+
+// Print the chosen formats and the bytes fetched for instanceCount instances
+// with this layout against the float layout
+void vertex_format_print(const char * name, const VertexFormat & format, GLenum indexType, int vertexCount, int indexCount, int instanceCount);
+void mesh_print_format(const char * name, const Mesh & mesh, int instanceCount);
+
+#endif // AOGL_MESH_H
@@ -0,0 +1,185 @@
+#include "meshbatch.h"
+
+#include <stdio.h>
+
+bool mesh_batch_multi_draw_supported()
+{
+    // gl_DrawIDARB is needed to find the per draw data
+    return GLEW_ARB_multi_draw_indirect && GLEW_ARB_shader_draw_parameters;
+}
+
+void mesh_batch_init(MeshBatch & batch, const std::vector<const MeshData *> & meshes, bool quantize)
+{
+    // Gather everything to pick one format valid for all the meshes
+    MeshData merged;
+    GLuint maxVertexCount = 0;
+    batch.meshes.clear();
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+        const MeshData & data = *meshes[i];
+        MeshBatchEntry entry;
+        entry.firstIndex = GLuint(merged.indices.size());
+        entry.indexCount = GLuint(data.indices.size());
+        entry.baseVertex = GLint(merged.positions.size() / 3);
+        entry.vertexCount = GLuint(data.positions.size() / 3);
+        batch.meshes.push_back(entry);
+
+        merged.positions.insert(merged.positions.end(), data.positions.begin(), data.positions.end());
+        merged.normals.insert(merged.normals.end(), data.normals.begin(), data.normals.end());
+        merged.uvs.insert(merged.uvs.end(), data.uvs.begin(), data.uvs.end());
+        // Indices stay relative to their mesh, baseVertex does the offset
+        merged.indices.insert(merged.indices.end(), data.indices.begin(), data.indices.end());
+
+        if (entry.vertexCount > maxVertexCount)
+            maxVertexCount = entry.vertexCount;
+    }
+
+    batch.format = vertex_format_choose(merged, quantize);
+    batch.indexType = quantize ? index_type_choose(maxVertexCount) : GL_UNSIGNED_INT;
+
+    std::vector<unsigned char> vertices;
+    std::vector<unsigned char> indices;
+    vertex_format_pack(batch.format, merged, vertices);
+    index_pack(batch.indexType, merged, indices);
+
+    glGenVertexArrays(1, &batch.vao);
+    glGenBuffers(3, batch.buffers);
+
+    glBindVertexArray(batch.vao);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.buffers[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size(), &indices[0], GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ARRAY_BUFFER, batch.buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size(), &vertices[0], GL_STATIC_DRAW);
+    vertex_format_set_attributes(batch.format, 0);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    batch.commands.clear();
+    batch.commandCapacity = 0;
+    batch.commandsDirty = true;
+}
+
+void mesh_batch_release(MeshBatch & batch)
+{
+    glDeleteVertexArrays(1, &batch.vao);
+    glDeleteBuffers(3, batch.buffers);
+    batch.vao = 0;
+    batch.meshes.clear();
+    batch.commands.clear();
+    batch.commandCapacity = 0;
+}
+
+int mesh_batch_add_draw(MeshBatch & batch, int mesh, GLuint instanceCount, GLuint baseInstance)
+{
+    const MeshBatchEntry & entry = batch.meshes[mesh];
+    DrawElementsIndirectCommand command;
+    command.count = entry.indexCount;
+    command.instanceCount = instanceCount;
+    command.firstIndex = entry.firstIndex;
+    command.baseVertex = entry.baseVertex;
+    command.baseInstance = baseInstance;
+    batch.commands.push_back(command);
+    batch.commandsDirty = true;
+    return int(batch.commands.size()) - 1;
+}
+
+DrawElementsIndirectCommand & mesh_batch_edit_draw(MeshBatch & batch, int draw)
+{
+    batch.commandsDirty = true;
+    return batch.commands[draw];
+}
+
+void mesh_batch_clear_draws(MeshBatch & batch)
+{
+    batch.commands.clear();
+    batch.commandsDirty = true;
+}
+
+void mesh_batch_upload(MeshBatch & batch)
+{
+    if (!batch.commandsDirty || batch.commands.empty())
+        return;
+
+    size_t size = batch.commands.size() * sizeof(DrawElementsIndirectCommand);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch.buffers[2]);
+    if (batch.commands.size() > batch.commandCapacity)
+    {
+        batch.commandCapacity = batch.commands.size();
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, size, &batch.commands[0], GL_DYNAMIC_DRAW);
+    }
+    else
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, size, &batch.commands[0]);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    batch.commandsDirty = false;
+}
+
+void mesh_batch_draw(const MeshBatch & batch, GLuint program, GLint drawIdLocation)
+{
+    glBindVertexArray(batch.vao);
+    mesh_batch_submit(batch, program, drawIdLocation);
+}
+
+void mesh_batch_submit(const MeshBatch & batch, GLuint program, GLint drawIdLocation)
+{
+    if (batch.commands.empty())
+        return;
+
+    if (mesh_batch_multi_draw_supported())
+    {
+        // gl_DrawIDARB starts at 0, the offset may have been left set by another draw
+        if (drawIdLocation != -1)
+            glProgramUniform1i(program, drawIdLocation, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch.buffers[2]);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, batch.indexType, (void*)0, GLsizei(batch.commands.size()), 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        return;
+    }
+
+    int indexSize = index_type_size(batch.indexType);
+    for (size_t i = 0; i < batch.commands.size(); ++i)
+    {
+        const DrawElementsIndirectCommand & command = batch.commands[i];
+        if (command.instanceCount == 0)
+            continue;
+        if (drawIdLocation != -1)
+            glProgramUniform1i(program, drawIdLocation, int(i));
+        glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, command.count, batch.indexType,
+                                                      (void*)(size_t(command.firstIndex) * indexSize),
+                                                      command.instanceCount, command.baseVertex, command.baseInstance);
+    }
+    if (drawIdLocation != -1)
+        glProgramUniform1i(program, drawIdLocation, 0);
+}
+
+void mesh_batch_print(const MeshBatch & batch, const char ** names)
+{
+    GLuint totalVertices = 0;
+    GLuint totalIndices = 0;
+    for (size_t i = 0; i < batch.meshes.size(); ++i)
+    {
+        totalVertices += batch.meshes[i].vertexCount;
+        totalIndices += batch.meshes[i].indexCount;
+    }
+
+    GLuint instanceCount = 0;
+    GLuint drawnIndices = 0;
+    for (size_t i = 0; i < batch.commands.size(); ++i)
+    {
+        instanceCount += batch.commands[i].instanceCount;
+        drawnIndices += batch.commands[i].count * batch.commands[i].instanceCount;
+    }
+
+    fprintf(stdout, "Mesh batch : %d meshes, %d draws in one %s\n", int(batch.meshes.size()), int(batch.commands.size()),
+            mesh_batch_multi_draw_supported() ? "glMultiDrawElementsIndirect" : "loop of glDrawElementsInstancedBaseVertexBaseInstance");
+    for (size_t i = 0; i < batch.meshes.size(); ++i)
+        fprintf(stdout, "    %s : %d vertices at %d, %d indices at %d\n", names[i],
+                batch.meshes[i].vertexCount, batch.meshes[i].baseVertex, batch.meshes[i].indexCount, batch.meshes[i].firstIndex);
+    vertex_format_print("batch", batch.format, batch.indexType, totalVertices, totalIndices, 0);
+    if (instanceCount > 0)
+        fprintf(stdout, "    %d bytes per vertex, %.2f MB fetched per frame for %d instances\n", batch.format.stride,
+                double(drawnIndices) * batch.format.stride / (1024. * 1024.), instanceCount);
+}
@@ -0,0 +1,65 @@
+#ifndef AOGL_MESHBATCH_H
+#define AOGL_MESHBATCH_H
+
+#include <vector>
+
+#include "glew/glew.h"
+
+#include "mesh.h"
+
+// Layout expected by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Location of one mesh inside the shared buffers
+struct MeshBatchEntry
+{
+    GLuint firstIndex;
+    GLuint indexCount;
+    GLint baseVertex;
+    GLuint vertexCount;
+};
+
+// Static meshes merged into one vertex and one index buffer sharing a single
+// vertex format, drawn with one indirect call for every command
+struct MeshBatch
+{
+    GLuint vao;
+    GLuint buffers[3]; // vertices, indices, indirect commands
+    VertexFormat format;
+    GLenum indexType;
+    std::vector<MeshBatchEntry> meshes;
+    std::vector<DrawElementsIndirectCommand> commands;
+    size_t commandCapacity;
+    bool commandsDirty;
+};
+
+// True when the commands can go through a single glMultiDrawElementsIndirect
+bool mesh_batch_multi_draw_supported();
+
+// Merge meshes, the vertex format is chosen over all of them at once
+void mesh_batch_init(MeshBatch & batch, const std::vector<const MeshData *> & meshes, bool quantize);
+void mesh_batch_release(MeshBatch & batch);
+
+// Append a draw of mesh, returns the draw index seen as gl_DrawID by the shaders
+int mesh_batch_add_draw(MeshBatch & batch, int mesh, GLuint instanceCount, GLuint baseInstance);
+DrawElementsIndirectCommand & mesh_batch_edit_draw(MeshBatch & batch, int draw);
+void mesh_batch_clear_draws(MeshBatch & batch);
+void mesh_batch_upload(MeshBatch & batch);
+
+// Bind the batch vao and submit every command. Without multi draw indirect the
+// commands are issued one by one and drawIdLocation (if not -1) of program is set
+// to the draw index before each of them, with it drawIdLocation is set to 0.
+void mesh_batch_draw(const MeshBatch & batch, GLuint program, GLint drawIdLocation);
+// Same as mesh_batch_draw with the batch vao already bound
+void mesh_batch_submit(const MeshBatch & batch, GLuint program, GLint drawIdLocation);
+
+void mesh_batch_print(const MeshBatch & batch, const char ** names);
+
+#endif // AOGL_MESHBATCH_H
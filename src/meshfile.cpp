@@ -0,0 +1,173 @@
+#include "meshfile.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+static unsigned long long align_offset(unsigned long long offset)
+{
+    return (offset + MESH_FILE_ALIGNMENT - 1) & ~(unsigned long long)(MESH_FILE_ALIGNMENT - 1);
+}
+
+bool mesh_file_write(const char * path, const MeshData & data, const std::vector<Meshlet> & meshlets, unsigned int flags)
+{
+    MeshFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = MESH_FILE_MAGIC;
+    header.version = MESH_FILE_VERSION;
+    header.flags = flags;
+    header.vertexCount = (unsigned int)(data.positions.size() / 3);
+    header.indexCount = (unsigned int)data.indices.size();
+    header.format = vertex_format_choose(data, true);
+    header.indexType = index_type_choose(header.vertexCount);
+    header.uvDensity = mesh_data_uv_density(data);
+
+    for (int c = 0; c < 3; ++c)
+    {
+        header.boundsMin[c] = header.vertexCount ? data.positions[c] : 0.f;
+        header.boundsMax[c] = header.boundsMin[c];
+    }
+    for (size_t i = 0; i < data.positions.size(); ++i)
+    {
+        int c = int(i % 3);
+        if (data.positions[i] < header.boundsMin[c])
+            header.boundsMin[c] = data.positions[i];
+        if (data.positions[i] > header.boundsMax[c])
+            header.boundsMax[c] = data.positions[i];
+    }
+
+    std::vector<unsigned char> vertices;
+    std::vector<unsigned char> indices;
+    vertex_format_pack(header.format, data, vertices);
+    index_pack(header.indexType, data, indices);
+
+    header.vertexOffset = align_offset(sizeof(MeshFileHeader));
+    header.indexOffset = align_offset(header.vertexOffset + vertices.size());
+    header.meshletOffset = align_offset(header.indexOffset + indices.size());
+    header.meshletCount = (unsigned int)meshlets.size();
+
+    FILE * f = fopen(path, "wb");
+    if (!f)
+        return false;
+
+    static const unsigned char zeros[MESH_FILE_ALIGNMENT] = {0};
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    ok = ok && fwrite(zeros, 1, header.vertexOffset - sizeof(header), f) == header.vertexOffset - sizeof(header);
+    ok = ok && (vertices.empty() || fwrite(&vertices[0], 1, vertices.size(), f) == vertices.size());
+    unsigned long long gap = header.indexOffset - header.vertexOffset - vertices.size();
+    ok = ok && fwrite(zeros, 1, gap, f) == gap;
+    ok = ok && (indices.empty() || fwrite(&indices[0], 1, indices.size(), f) == indices.size());
+    gap = header.meshletOffset - header.indexOffset - indices.size();
+    ok = ok && fwrite(zeros, 1, gap, f) == gap;
+    ok = ok && (meshlets.empty() || fwrite(&meshlets[0], sizeof(Meshlet), meshlets.size(), f) == meshlets.size());
+    ok = fclose(f) == 0 && ok;
+    return ok;
+}
+
+// region fits in the file, computed without wrapping, and starts aligned
+static bool region_fits(unsigned long long offset, unsigned long long size, size_t fileSize)
+{
+    return offset % MESH_FILE_ALIGNMENT == 0 && offset <= fileSize && size <= fileSize - offset;
+}
+
+// Formats are one of the known layouts and every region lies in the file
+static bool check_layout(const MeshFileHeader & header, size_t fileSize, const char * path)
+{
+    const VertexFormat & format = header.format;
+    bool knownFormat = format.position <= POSITION_HALF && format.normal <= NORMAL_PACKED && format.texcoord <= TEXCOORD_UNORM16;
+    if (knownFormat)
+    {
+        VertexFormat expected = vertex_format_make(PositionFormat(format.position), NormalFormat(format.normal), TexCoordFormat(format.texcoord));
+        knownFormat = format.normalOffset == expected.normalOffset && format.texcoordOffset == expected.texcoordOffset
+            && format.stride == expected.stride;
+    }
+    if (!knownFormat || (header.indexType != GL_UNSIGNED_SHORT && header.indexType != GL_UNSIGNED_INT))
+    {
+        fprintf(stderr, "Mesh file %s : unknown vertex or index format\n", path);
+        return false;
+    }
+
+    unsigned long long vertexSize = (unsigned long long)header.vertexCount * format.stride;
+    unsigned long long indexSize = (unsigned long long)header.indexCount * index_type_size(header.indexType);
+    unsigned long long meshletSize = (unsigned long long)header.meshletCount * sizeof(Meshlet);
+    if (!region_fits(header.vertexOffset, vertexSize, fileSize) || !region_fits(header.indexOffset, indexSize, fileSize)
+        || !region_fits(header.meshletOffset, meshletSize, fileSize))
+    {
+        fprintf(stderr, "Mesh file %s : truncated\n", path);
+        return false;
+    }
+    return true;
+}
+
+// Indices and meshlets reach the gpu as is, anything out of range would be fetched there
+static bool check_contents(const MeshFileHeader & header, const unsigned char * data, const char * path)
+{
+    const void * indices = data + header.indexOffset;
+    for (unsigned int i = 0; i < header.indexCount; ++i)
+    {
+        unsigned int index = header.indexType == GL_UNSIGNED_SHORT ? ((const unsigned short *)indices)[i] : ((const unsigned int *)indices)[i];
+        if (index >= header.vertexCount)
+        {
+            fprintf(stderr, "Mesh file %s : index %u out of range\n", path, i);
+            return false;
+        }
+    }
+    const Meshlet * meshlets = (const Meshlet *)(data + header.meshletOffset);
+    for (unsigned int i = 0; i < header.meshletCount; ++i)
+    {
+        if ((unsigned long long)meshlets[i]._firstIndex + meshlets[i]._indexCount > header.indexCount)
+        {
+            fprintf(stderr, "Mesh file %s : meshlet %u out of range\n", path, i);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool mesh_file_map(MeshFileView & view, const char * path)
+{
+    view.header = 0;
+    view.vertices = 0;
+    view.indices = 0;
+    view.meshlets = 0;
+    if (!mapped_file_open(view.file, path))
+    {
+        fprintf(stderr, "Mesh file %s : can not open\n", path);
+        return false;
+    }
+
+    const MeshFileHeader * header = (const MeshFileHeader *)view.file.data;
+    if (view.file.size < sizeof(MeshFileHeader) || header->magic != MESH_FILE_MAGIC)
+    {
+        fprintf(stderr, "Mesh file %s : not a cooked mesh\n", path);
+        mesh_file_unmap(view);
+        return false;
+    }
+    if (header->version != MESH_FILE_VERSION)
+    {
+        fprintf(stderr, "Mesh file %s : version %u, expected %u, cook it again\n", path, header->version, MESH_FILE_VERSION);
+        mesh_file_unmap(view);
+        return false;
+    }
+
+    if (!check_layout(*header, view.file.size, path) || !check_contents(*header, view.file.data, path))
+    {
+        mesh_file_unmap(view);
+        return false;
+    }
+
+    view.header = header;
+    view.vertices = view.file.data + header->vertexOffset;
+    view.indices = view.file.data + header->indexOffset;
+    view.meshlets = (const Meshlet *)(view.file.data + header->meshletOffset);
+    return true;
+}
+
+void mesh_file_unmap(MeshFileView & view)
+{
+    mapped_file_close(view.file);
+    view.header = 0;
+    view.vertices = 0;
+    view.indices = 0;
+    view.meshlets = 0;
+}
@@ -0,0 +1,57 @@
+#ifndef AOGL_MESHFILE_H
+#define AOGL_MESHFILE_H
+
+#include "mesh.h"
+#include "meshlet.h"
+#include "mappedfile.h"
+
+// Cooked mesh file (.aogm) : a header followed by the packed vertex and index
+// buffers and the meshlets, each aligned on MESH_FILE_ALIGNMENT bytes, ready to be uploaded as is.
+// Bump MESH_FILE_VERSION whenever the layout of the file changes.
+const unsigned int MESH_FILE_MAGIC = 0x4D474F41; // "AOGM"
+const unsigned int MESH_FILE_VERSION = 4;
+const unsigned int MESH_FILE_ALIGNMENT = 16;
+
+// MeshFileHeader::flags
+enum MeshFileFlag
+{
+    MESH_FILE_OPTIMIZED = 1 // indices and vertices went through mesh_optimize
+};
+
+struct MeshFileHeader
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int vertexCount;
+    unsigned int indexCount;
+    VertexFormat format;
+    unsigned char padding[2];
+    unsigned int indexType;
+    float boundsMin[3];
+    float boundsMax[3];
+    unsigned int flags;
+    unsigned long long vertexOffset;
+    unsigned long long indexOffset;
+    unsigned long long meshletOffset;
+    unsigned int meshletCount;
+    float uvDensity; // mesh_data_uv_density, for texture streaming
+};
+
+// Header and buffers of a mapped mesh file, pointers are into the mapping
+struct MeshFileView
+{
+    MappedFile file;
+    const MeshFileHeader * header;
+    const void * vertices;
+    const void * indices;
+    const Meshlet * meshlets;
+};
+
+// Write data packed with the smallest valid formats, returns false on io error
+bool mesh_file_write(const char * path, const MeshData & data, const std::vector<Meshlet> & meshlets, unsigned int flags);
+// Map path and check it, returns false if it is not a valid mesh file of this version. Files
+// are not trusted : formats, regions, indices and meshlet ranges are all checked.
+bool mesh_file_map(MeshFileView & view, const char * path);
+void mesh_file_unmap(MeshFileView & view);
+
+#endif // AOGL_MESHFILE_H
@@ -0,0 +1,126 @@
+#include "meshlet.h"
+
+#include "glm/gtc/type_ptr.hpp" // glm::value_ptr
+
+#include "meshbatch.h" // DrawElementsIndirectCommand
+
+bool meshlet_culling_supported()
+{
+    return GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object);
+}
+
+void meshlet_culler_init(MeshletCuller & culler, const Mesh & mesh, const std::vector<Meshlet> & meshlets, GLuint program, GLuint baseInstance)
+{
+    culler.sourceIndices = mesh.buffers[1];
+    culler.sourceIndexType = mesh.indexType;
+    culler.meshletCount = int(meshlets.size());
+    culler.indexCount = mesh.indexCount;
+    culler.baseInstance = baseInstance;
+
+    glGenVertexArrays(1, &culler.vao);
+    glGenBuffers(3, culler.buffers);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, culler.buffers[0]);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, meshlets.size() * sizeof(Meshlet), &meshlets[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // Same vertices as the mesh, only the index buffer differs
+    glBindVertexArray(culler.vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, culler.buffers[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indexCount * sizeof(GLuint), 0, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.buffers[0]);
+    vertex_format_set_attributes(mesh.format, 0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    DrawElementsIndirectCommand command = {0, 1, 0, 0, baseInstance};
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culler.buffers[2]);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(command), &command, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    meshlet_culler_set_program(culler, program);
+}
+
+void meshlet_culler_set_program(MeshletCuller & culler, GLuint program)
+{
+    culler.program = program;
+    culler.meshletCountLocation = glGetUniformLocation(program, "MeshletCount");
+    culler.shortIndicesLocation = glGetUniformLocation(program, "ShortIndices");
+    culler.worldToViewLocation = glGetUniformLocation(program, "WorldToView");
+    culler.projectionLocation = glGetUniformLocation(program, "Projection");
+    culler.cameraPositionLocation = glGetUniformLocation(program, "CameraPosition");
+    culler.instanceTransformLocation = glGetUniformLocation(program, "InstanceTransform");
+    culler.instanceRotationLocation = glGetUniformLocation(program, "InstanceRotation");
+    culler.coneCullingLocation = glGetUniformLocation(program, "ConeCulling");
+    culler.occlusionCullingLocation = glGetUniformLocation(program, "OcclusionCulling");
+    culler.depthPyramidLocation = glGetUniformLocation(program, "DepthPyramid");
+}
+
+void meshlet_culler_release(MeshletCuller & culler)
+{
+    glDeleteVertexArrays(1, &culler.vao);
+    glDeleteBuffers(3, culler.buffers);
+    culler.vao = 0;
+    culler.meshletCount = 0;
+}
+
+void meshlet_culler_cull(MeshletCuller & culler, const MeshletCullParams & params)
+{
+    // Only the count is reset, the shader appends to it
+    DrawElementsIndirectCommand command = {0, 1, 0, 0, culler.baseInstance};
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culler.buffers[2]);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(command), &command);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    GLuint program = culler.program;
+    glUseProgram(program);
+    glProgramUniform1i(program, culler.meshletCountLocation, culler.meshletCount);
+    glProgramUniform1i(program, culler.shortIndicesLocation, culler.sourceIndexType == GL_UNSIGNED_SHORT);
+    glProgramUniformMatrix4fv(program, culler.worldToViewLocation, 1, GL_FALSE, glm::value_ptr(params.worldToView));
+    glProgramUniformMatrix4fv(program, culler.projectionLocation, 1, GL_FALSE, glm::value_ptr(params.projection));
+    glProgramUniform3fv(program, culler.cameraPositionLocation, 1, glm::value_ptr(params.cameraPosition));
+    glProgramUniform4fv(program, culler.instanceTransformLocation, 1, glm::value_ptr(params.instanceTransform));
+    glProgramUniform4f(program, culler.instanceRotationLocation,
+                       params.instanceRotation.x, params.instanceRotation.y, params.instanceRotation.z, params.instanceRotation.w);
+    glProgramUniform1i(program, culler.coneCullingLocation, params.coneCulling);
+    glProgramUniform1i(program, culler.occlusionCullingLocation, params.depthPyramid != 0);
+    glProgramUniform1i(program, culler.depthPyramidLocation, DEPTH_PYRAMID_UNIT);
+    if (params.depthPyramid)
+    {
+        glActiveTexture(GL_TEXTURE0 + DEPTH_PYRAMID_UNIT);
+        glBindTexture(GL_TEXTURE_2D, params.depthPyramid->texture);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESHLET_CULL_MESHLETS, culler.buffers[0]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESHLET_CULL_SOURCE_INDICES, culler.sourceIndices);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESHLET_CULL_CULLED_INDICES, culler.buffers[1]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESHLET_CULL_COMMAND, culler.buffers[2]);
+
+    // One work group per meshlet, wrapped on y past the dispatch limit
+    GLuint groupsX = culler.meshletCount < 65535 ? culler.meshletCount : 65535;
+    GLuint groupsY = (culler.meshletCount + 65534) / 65535;
+    glDispatchCompute(groupsX, groupsY, 1);
+
+    // The draw reads the count as a command and the indices as elements
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT);
+}
+
+void meshlet_culler_draw(const MeshletCuller & culler)
+{
+    glBindVertexArray(culler.vao);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culler.buffers[2]);
+    glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+int meshlet_culler_visible_indices(const MeshletCuller & culler)
+{
+    DrawElementsIndirectCommand command;
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culler.buffers[2]);
+    glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(command), &command);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    return int(command.count);
+}
@@ -0,0 +1,88 @@
+#ifndef AOGL_MESHLET_H
+#define AOGL_MESHLET_H
+
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include "mesh.h"
+#include "depthpyramid.h"
+
+// Meshlets are runs of consecutive triangles of a mesh index buffer, small enough
+// to be culled on their own. Built after mesh_optimize the runs are spatially compact.
+const int MESHLET_MAX_VERTICES = 64;
+const int MESHLET_MAX_TRIANGLES = 124; // at most the work group size of meshlet_cull.comp
+
+// Matches the std430 Meshlet struct of meshlet_cull.comp
+struct Meshlet
+{
+    glm::vec4 _sphere; // mesh space center, radius
+    glm::vec4 _cone; // axis, sine of the cone half angle, 1 when the meshlet can not be backface culled
+    GLuint _firstIndex;
+    GLuint _indexCount;
+    GLuint _padding[2];
+};
+
+// Split indices into meshlets and compute their bounding sphere and normal cone
+void meshlets_build(const MeshData & data, std::vector<Meshlet> & meshlets);
+
+// Storage block bindings of meshlet_cull.comp
+enum MeshletCullBinding
+{
+    MESHLET_CULL_MESHLETS = 0,
+    MESHLET_CULL_SOURCE_INDICES = 1,
+    MESHLET_CULL_CULLED_INDICES = 2,
+    MESHLET_CULL_COMMAND = 3
+};
+
+// Gpu culling of the meshlets of one instance of a mesh. The compute pass appends the
+// indices of visible meshlets to its own index buffer and writes the indirect draw count.
+struct MeshletCuller
+{
+    GLuint vao; // vertices of the mesh, culled indices
+    GLuint buffers[3]; // meshlets, culled indices, indirect command
+    GLuint sourceIndices; // index buffer of the mesh, not owned
+    GLenum sourceIndexType;
+    int meshletCount;
+    int indexCount;
+    GLuint baseInstance;
+
+    GLuint program;
+    GLint meshletCountLocation;
+    GLint shortIndicesLocation;
+    GLint worldToViewLocation;
+    GLint projectionLocation;
+    GLint cameraPositionLocation;
+    GLint instanceTransformLocation;
+    GLint instanceRotationLocation;
+    GLint coneCullingLocation;
+    GLint occlusionCullingLocation;
+    GLint depthPyramidLocation;
+};
+
+struct MeshletCullParams
+{
+    glm::mat4 worldToView;
+    glm::mat4 projection; // symmetric perspective
+    glm::vec3 cameraPosition;
+    glm::vec4 instanceTransform; // position, scale, as Instance
+    glm::quat instanceRotation;
+    bool coneCulling;
+    const DepthPyramid * depthPyramid; // null to skip the occlusion test
+};
+
+// Compute shaders and storage buffers, GL 4.3
+bool meshlet_culling_supported();
+// program is meshlet_cull.comp, baseInstance the instance of the mesh in the instance stream
+void meshlet_culler_init(MeshletCuller & culler, const Mesh & mesh, const std::vector<Meshlet> & meshlets, GLuint program, GLuint baseInstance);
+void meshlet_culler_release(MeshletCuller & culler);
+// Use another build of meshlet_cull.comp, after a reload
+void meshlet_culler_set_program(MeshletCuller & culler, GLuint program);
+// Dispatch the culling pass, the following meshlet_culler_draw calls draw what passed
+void meshlet_culler_cull(MeshletCuller & culler, const MeshletCullParams & params);
+void meshlet_culler_draw(const MeshletCuller & culler);
+// Index count written by the last culling pass, stalls on the gpu
+int meshlet_culler_visible_indices(const MeshletCuller & culler);
+
+#endif // AOGL_MESHLET_H
@@ -0,0 +1,95 @@
+#include "meshlet.h"
+
+#include <cmath>
+
+// Cpu side of meshlet.h, no GL calls so tools can use it
+
+static void meshlet_bounds(const MeshData & data, Meshlet & meshlet)
+{
+    const glm::vec3 * p = (const glm::vec3 *)&data.positions[0];
+    const unsigned int * indices = &data.indices[meshlet._firstIndex];
+
+    // Sphere around the box center, loose but cheap
+    glm::vec3 boxMin = p[indices[0]];
+    glm::vec3 boxMax = boxMin;
+    for (GLuint i = 1; i < meshlet._indexCount; ++i)
+    {
+        boxMin = glm::min(boxMin, p[indices[i]]);
+        boxMax = glm::max(boxMax, p[indices[i]]);
+    }
+    glm::vec3 center = (boxMin + boxMax) * 0.5f;
+    float radius = 0.f;
+    for (GLuint i = 0; i < meshlet._indexCount; ++i)
+        radius = glm::max(radius, glm::length(p[indices[i]] - center));
+    meshlet._sphere = glm::vec4(center, radius);
+
+    // Cone around the mean face normal, the meshlet is backfacing for a viewer when every
+    // face is, which the cull shader tests with the sine of the widest angle to the axis
+    glm::vec3 axis(0.f);
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet._indexCount / 3);
+    for (GLuint i = 0; i + 2 < meshlet._indexCount; i += 3)
+    {
+        glm::vec3 n = glm::cross(p[indices[i + 1]] - p[indices[i]], p[indices[i + 2]] - p[indices[i]]);
+        float length = glm::length(n);
+        if (length == 0.f)
+            continue;
+        normals.push_back(n / length);
+        axis += normals.back();
+    }
+    float axisLength = glm::length(axis);
+    meshlet._cone = glm::vec4(0.f, 0.f, 0.f, 1.f);
+    if (axisLength == 0.f)
+        return;
+    axis /= axisLength;
+    float minDot = 1.f;
+    for (size_t i = 0; i < normals.size(); ++i)
+        minDot = glm::min(minDot, glm::dot(axis, normals[i]));
+    if (minDot <= 0.f)
+        return;
+    meshlet._cone = glm::vec4(axis, std::sqrt(1.f - minDot * minDot));
+}
+
+void meshlets_build(const MeshData & data, std::vector<Meshlet> & meshlets)
+{
+    meshlets.clear();
+    size_t vertexCount = data.positions.size() / 3;
+    // Meshlet index + 1 of the last meshlet that used each vertex
+    std::vector<unsigned int> vertexMeshlet(vertexCount, 0);
+
+    Meshlet meshlet = {glm::vec4(0.f), glm::vec4(0.f), 0, 0, {0, 0}};
+    int meshletVertices = 0;
+    for (size_t i = 0; i + 2 < data.indices.size(); i += 3)
+    {
+        unsigned int stamp = unsigned(meshlets.size()) + 1;
+        int newVertices = 0;
+        for (int k = 0; k < 3; ++k)
+            newVertices += vertexMeshlet[data.indices[i + k]] != stamp;
+
+        if (meshletVertices + newVertices > MESHLET_MAX_VERTICES || meshlet._indexCount / 3 == GLuint(MESHLET_MAX_TRIANGLES))
+        {
+            meshlet_bounds(data, meshlet);
+            meshlets.push_back(meshlet);
+            meshlet._firstIndex = GLuint(i);
+            meshlet._indexCount = 0;
+            meshletVertices = 0;
+            stamp = unsigned(meshlets.size()) + 1;
+        }
+
+        for (int k = 0; k < 3; ++k)
+        {
+            unsigned int v = data.indices[i + k];
+            if (vertexMeshlet[v] != stamp)
+            {
+                vertexMeshlet[v] = stamp;
+                ++meshletVertices;
+            }
+        }
+        meshlet._indexCount += 3;
+    }
+    if (meshlet._indexCount > 0)
+    {
+        meshlet_bounds(data, meshlet);
+        meshlets.push_back(meshlet);
+    }
+}
@@ -0,0 +1,287 @@
+#include "meshopt.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "glm/glm.hpp"
+
+MeshOptStats meshopt_analyze(const std::vector<unsigned int> & indices, size_t vertexCount, int cacheSize)
+{
+    MeshOptStats stats = {0.f, 0.f};
+    if (indices.empty())
+        return stats;
+
+    // Fifo cache, timestamps tell whether a vertex is still among the last cacheSize misses
+    std::vector<unsigned int> cacheTime(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    unsigned int time = cacheSize + 1;
+    unsigned int misses = 0;
+    unsigned int vertices = 0;
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        unsigned int v = indices[i];
+        if (time - cacheTime[v] > unsigned(cacheSize))
+        {
+            cacheTime[v] = time++;
+            ++misses;
+        }
+        if (!referenced[v])
+        {
+            referenced[v] = true;
+            ++vertices;
+        }
+    }
+    stats.acmr = float(misses) / float(indices.size() / 3);
+    stats.atvr = float(misses) / float(vertices);
+    return stats;
+}
+
+// Vertex cache optimisation ------------------------------------------------------------------------------------------
+
+static const int FORSYTH_CACHE_SIZE = 32;
+
+static float forsyth_vertex_score(int cachePosition, unsigned int remainingTriangles)
+{
+    if (remainingTriangles == 0)
+        return -1.f;
+
+    float score = 0.f;
+    if (cachePosition >= 0)
+    {
+        // The last triangle's vertices get a fixed score so the next triangle does not
+        // simply share an edge with it, which would favour long thin strips
+        if (cachePosition < 3)
+            score = 0.75f;
+        else
+            score = std::pow(1.f - float(cachePosition - 3) / float(FORSYTH_CACHE_SIZE - 3), 1.5f);
+    }
+    // Boost vertices with few triangles left so they get finished instead of left alone
+    score += 2.f / std::sqrt(float(remainingTriangles));
+    return score;
+}
+
+void meshopt_vertex_cache(std::vector<unsigned int> & indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // Triangles of each vertex, the first remaining[v] entries are the ones not emitted yet
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (size_t i = 0; i < indices.size(); ++i)
+        ++remaining[indices[i]];
+    std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i)
+        adjacency[fill[indices[i]]++] = unsigned(i / 3);
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        vertexScore[v] = forsyth_vertex_score(-1, remaining[v]);
+    std::vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t)
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+    std::vector<bool> emitted(triangleCount, false);
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    std::vector<unsigned int> cache, newCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    int best = int(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+    size_t inputCursor = 0;
+    for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+    {
+        if (best < 0)
+        {
+            // Nothing left in the cache, restart from the next triangle in input order
+            while (emitted[inputCursor])
+                ++inputCursor;
+            best = int(inputCursor);
+        }
+
+        const unsigned int * tri = &indices[best * 3];
+        emitted[best] = true;
+        newCache.clear();
+        for (int k = 0; k < 3; ++k)
+        {
+            unsigned int v = tri[k];
+            result.push_back(v);
+            newCache.push_back(v);
+
+            // Move the triangle past the end of the remaining ones
+            unsigned int * list = &adjacency[adjacencyOffset[v]];
+            unsigned int count = remaining[v];
+            for (unsigned int j = 0; j < count; ++j)
+            {
+                if (list[j] == unsigned(best))
+                {
+                    std::swap(list[j], list[count - 1]);
+                    break;
+                }
+            }
+            --remaining[v];
+        }
+        for (size_t j = 0; j < cache.size(); ++j)
+        {
+            unsigned int v = cache[j];
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                newCache.push_back(v);
+        }
+
+        // Vertices pushed out of the cache lose their position score
+        for (size_t j = FORSYTH_CACHE_SIZE; j < newCache.size(); ++j)
+        {
+            cachePosition[newCache[j]] = -1;
+            vertexScore[newCache[j]] = forsyth_vertex_score(-1, remaining[newCache[j]]);
+        }
+        if (newCache.size() > size_t(FORSYTH_CACHE_SIZE))
+            newCache.resize(FORSYTH_CACHE_SIZE);
+        for (size_t j = 0; j < newCache.size(); ++j)
+        {
+            cachePosition[newCache[j]] = int(j);
+            vertexScore[newCache[j]] = forsyth_vertex_score(int(j), remaining[newCache[j]]);
+        }
+
+        // Only triangles touching the cache changed score, the best of them is next
+        best = -1;
+        float bestScore = -1.f;
+        for (size_t j = 0; j < newCache.size(); ++j)
+        {
+            unsigned int v = newCache[j];
+            const unsigned int * list = &adjacency[adjacencyOffset[v]];
+            for (unsigned int k = 0; k < remaining[v]; ++k)
+            {
+                unsigned int t = list[k];
+                float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                triangleScore[t] = score;
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    best = int(t);
+                }
+            }
+        }
+        cache.swap(newCache);
+    }
+    indices.swap(result);
+}
+
+// Overdraw optimisation ------------------------------------------------------------------------------------------
+
+struct MeshOptCluster
+{
+    size_t first;
+    size_t count;
+    float sortKey;
+    bool operator<(const MeshOptCluster & o) const { return sortKey > o.sortKey; }
+};
+
+void meshopt_overdraw(std::vector<unsigned int> & indices, const std::vector<float> & positions, int cacheSize)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+    const glm::vec3 * p = (const glm::vec3 *)&positions[0];
+    size_t vertexCount = positions.size() / 3;
+
+    // A cluster starts wherever the three vertices of a triangle miss the cache, cutting
+    // there does not change the cache behaviour whatever order the clusters end up in
+    std::vector<MeshOptCluster> clusters;
+    std::vector<unsigned int> cacheTime(vertexCount, 0);
+    unsigned int time = cacheSize + 1;
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        int misses = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            unsigned int v = indices[t * 3 + k];
+            if (time - cacheTime[v] > unsigned(cacheSize))
+            {
+                cacheTime[v] = time++;
+                ++misses;
+            }
+        }
+        if (misses == 3 || clusters.empty())
+        {
+            MeshOptCluster cluster = {t, 0, 0.f};
+            clusters.push_back(cluster);
+        }
+        ++clusters.back().count;
+    }
+
+    glm::vec3 meshCenter(0.f);
+    for (size_t v = 0; v < vertexCount; ++v)
+        meshCenter += p[v];
+    meshCenter /= float(vertexCount);
+
+    // Clusters far out along their own normal occlude more of the mesh than they are occluded
+    for (size_t c = 0; c < clusters.size(); ++c)
+    {
+        glm::vec3 center(0.f);
+        glm::vec3 normal(0.f);
+        float area = 0.f;
+        for (size_t t = clusters[c].first; t < clusters[c].first + clusters[c].count; ++t)
+        {
+            glm::vec3 a = p[indices[t * 3]], b = p[indices[t * 3 + 1]], c2 = p[indices[t * 3 + 2]];
+            glm::vec3 n = glm::cross(b - a, c2 - a);
+            float triangleArea = glm::length(n);
+            center += (a + b + c2) * (triangleArea / 3.f);
+            normal += n;
+            area += triangleArea;
+        }
+        float normalLength = glm::length(normal);
+        if (area > 0.f && normalLength > 0.f)
+            clusters[c].sortKey = glm::dot(center / area - meshCenter, normal / normalLength);
+    }
+    std::stable_sort(clusters.begin(), clusters.end());
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (size_t c = 0; c < clusters.size(); ++c)
+        result.insert(result.end(), indices.begin() + clusters[c].first * 3, indices.begin() + (clusters[c].first + clusters[c].count) * 3);
+    indices.swap(result);
+}
+
+// Vertex fetch optimisation ------------------------------------------------------------------------------------------
+
+void meshopt_vertex_fetch(MeshData & data)
+{
+    size_t vertexCount = data.positions.size() / 3;
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(vertexCount, unused);
+    unsigned int next = 0;
+    for (size_t i = 0; i < data.indices.size(); ++i)
+    {
+        unsigned int & r = remap[data.indices[i]];
+        if (r == unused)
+            r = next++;
+        data.indices[i] = r;
+    }
+
+    std::vector<float> positions(next * 3), normals(next * 3), uvs(next * 2);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        unsigned int r = remap[v];
+        if (r == unused)
+            continue;
+        std::copy(&data.positions[v * 3], &data.positions[v * 3] + 3, &positions[r * 3]);
+        std::copy(&data.normals[v * 3], &data.normals[v * 3] + 3, &normals[r * 3]);
+        std::copy(&data.uvs[v * 2], &data.uvs[v * 2] + 2, &uvs[r * 2]);
+    }
+    data.positions.swap(positions);
+    data.normals.swap(normals);
+    data.uvs.swap(uvs);
+}
+
+void mesh_optimize(MeshData & data)
+{
+    meshopt_vertex_cache(data.indices, data.positions.size() / 3);
+    meshopt_overdraw(data.indices, data.positions, MESHOPT_ANALYZE_CACHE_SIZE);
+    meshopt_vertex_fetch(data);
+}
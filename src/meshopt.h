@@ -0,0 +1,31 @@
+#ifndef AOGL_MESHOPT_H
+#define AOGL_MESHOPT_H
+
+#include <vector>
+
+#include "mesh.h"
+
+// Size of the fifo cache simulated by meshopt_analyze, close to what current gpus reuse
+const int MESHOPT_ANALYZE_CACHE_SIZE = 16;
+
+struct MeshOptStats
+{
+    float acmr; // vertex shader invocations per triangle, 0.5 is ideal for a grid
+    float atvr; // vertex shader invocations per referenced vertex, 1 is ideal
+};
+
+// Post-transform cache statistics of indices with a fifo cache of cacheSize entries
+MeshOptStats meshopt_analyze(const std::vector<unsigned int> & indices, size_t vertexCount, int cacheSize);
+
+// Reorder triangles for post-transform cache locality (Forsyth, linear speed vertex cache optimisation)
+void meshopt_vertex_cache(std::vector<unsigned int> & indices, size_t vertexCount);
+// Split cache ordered triangles into clusters where the cache restarts and sort the
+// clusters so the ones facing outward, likely to occlude the others, are drawn first
+void meshopt_overdraw(std::vector<unsigned int> & indices, const std::vector<float> & positions, int cacheSize);
+// Renumber vertices in first use order so vertex fetch walks memory linearly, unused vertices are dropped
+void meshopt_vertex_fetch(MeshData & data);
+
+// The three passes above in order
+void mesh_optimize(MeshData & data);
+
+#endif // AOGL_MESHOPT_H
@@ -0,0 +1,189 @@
+#include "mesh.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <cmath>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/packing.hpp" // glm::packHalf1x16, glm::packUnorm1x16
+
+// Cpu side of mesh.h : format selection and packing, no GL calls so tools can use it
+
+void mesh_data_from_arrays(MeshData & data, const float * positions, const float * normals, const float * uvs, int vertexCount, const int * indices, int indexCount)
+{
+    data.positions.assign(positions, positions + vertexCount * 3);
+    data.normals.assign(normals, normals + vertexCount * 3);
+    data.uvs.assign(uvs, uvs + vertexCount * 2);
+    data.indices.assign(indices, indices + indexCount);
+}
+
+float mesh_data_uv_density(const MeshData & data)
+{
+    if (data.uvs.empty())
+        return 0.f;
+    double uvArea = 0.;
+    double area = 0.;
+    for (size_t i = 0; i + 2 < data.indices.size(); i += 3)
+    {
+        unsigned int a = data.indices[i], b = data.indices[i + 1], c = data.indices[i + 2];
+        glm::vec3 pa(data.positions[a * 3], data.positions[a * 3 + 1], data.positions[a * 3 + 2]);
+        glm::vec3 pb(data.positions[b * 3], data.positions[b * 3 + 1], data.positions[b * 3 + 2]);
+        glm::vec3 pc(data.positions[c * 3], data.positions[c * 3 + 1], data.positions[c * 3 + 2]);
+        glm::vec2 ta(data.uvs[a * 2], data.uvs[a * 2 + 1]);
+        glm::vec2 tb(data.uvs[b * 2], data.uvs[b * 2 + 1]);
+        glm::vec2 tc(data.uvs[c * 2], data.uvs[c * 2 + 1]);
+        glm::vec2 u = tb - ta, v = tc - ta;
+        area += 0.5 * glm::length(glm::cross(pb - pa, pc - pa));
+        uvArea += 0.5 * std::fabs(u.x * v.y - u.y * v.x);
+    }
+    return area > 0. ? float(std::sqrt(uvArea / area)) : 0.f;
+}
+
+VertexFormat vertex_format_make(PositionFormat position, NormalFormat normal, TexCoordFormat texcoord)
+{
+    VertexFormat format;
+    format.position = position;
+    format.normal = normal;
+    format.texcoord = texcoord;
+    format.normalOffset = position == POSITION_FLOAT ? 12 : 8;
+    format.texcoordOffset = format.normalOffset + (normal == NORMAL_FLOAT ? 12 : 4);
+    format.stride = format.texcoordOffset + (texcoord == TEXCOORD_FLOAT ? 8 : 4);
+    return format;
+}
+
+static float half_error(float v)
+{
+    return std::fabs(glm::unpackHalf1x16(glm::packHalf1x16(v)) - v);
+}
+
+VertexFormat vertex_format_choose(const MeshData & data, bool quantize)
+{
+    if (!quantize)
+        return vertex_format_make(POSITION_FLOAT, NORMAL_FLOAT, TEXCOORD_FLOAT);
+
+    PositionFormat position = POSITION_HALF;
+    for (size_t i = 0; i < data.positions.size(); ++i)
+    {
+        if (half_error(data.positions[i]) > MESH_HALF_POSITION_TOLERANCE)
+        {
+            position = POSITION_FLOAT;
+            break;
+        }
+    }
+
+    // Uvs in [0, 1] go to unorm16, anything else to half when it is exact enough
+    // for a texel of a 4096 texture
+    TexCoordFormat texcoord = TEXCOORD_UNORM16;
+    for (size_t i = 0; i < data.uvs.size(); ++i)
+    {
+        float uv = data.uvs[i];
+        if (uv < 0.f || uv > 1.f)
+            texcoord = TEXCOORD_HALF;
+        if (half_error(uv) > 1.f / 4096.f)
+        {
+            texcoord = TEXCOORD_FLOAT;
+            break;
+        }
+    }
+
+    return vertex_format_make(position, NORMAL_PACKED, texcoord);
+}
+
+static GLuint pack_normal(const float * n)
+{
+    GLuint result = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        int v = int(std::floor(glm::clamp(n[i], -1.f, 1.f) * 511.f + 0.5f));
+        result |= GLuint(v & 0x3FF) << (10 * i);
+    }
+    return result;
+}
+
+void vertex_format_pack(const VertexFormat & format, const MeshData & data, std::vector<unsigned char> & vertices)
+{
+    size_t vertexCount = data.positions.size() / 3;
+    vertices.assign(vertexCount * format.stride, 0);
+
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        unsigned char * v = &vertices[i * format.stride];
+        const float * p = &data.positions[i*3];
+        const float * n = &data.normals[i*3];
+        const float * uv = &data.uvs[i*2];
+
+        if (format.position == POSITION_FLOAT)
+            memcpy(v, p, sizeof(float) * 3);
+        else
+        {
+            glm::uint16 h[4] = { glm::packHalf1x16(p[0]), glm::packHalf1x16(p[1]), glm::packHalf1x16(p[2]), glm::packHalf1x16(1.f) };
+            memcpy(v, h, sizeof(h));
+        }
+
+        if (format.normal == NORMAL_FLOAT)
+            memcpy(v + format.normalOffset, n, sizeof(float) * 3);
+        else
+        {
+            GLuint packed = pack_normal(n);
+            memcpy(v + format.normalOffset, &packed, sizeof(packed));
+        }
+
+        if (format.texcoord == TEXCOORD_FLOAT)
+            memcpy(v + format.texcoordOffset, uv, sizeof(float) * 2);
+        else
+        {
+            glm::uint16 t[2];
+            for (int c = 0; c < 2; ++c)
+                t[c] = format.texcoord == TEXCOORD_HALF ? glm::packHalf1x16(uv[c]) : glm::packUnorm1x16(uv[c]);
+            memcpy(v + format.texcoordOffset, t, sizeof(t));
+        }
+    }
+}
+
+GLenum index_type_choose(int vertexCount)
+{
+    return vertexCount <= 0x10000 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+int index_type_size(GLenum indexType)
+{
+    return indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+}
+
+void index_pack(GLenum indexType, const MeshData & data, std::vector<unsigned char> & indices)
+{
+    indices.resize(data.indices.size() * index_type_size(indexType));
+    if (indices.empty())
+        return;
+    if (indexType == GL_UNSIGNED_INT)
+    {
+        memcpy(&indices[0], &data.indices[0], indices.size());
+        return;
+    }
+    glm::uint16 * out = (glm::uint16 *)&indices[0];
+    for (size_t i = 0; i < data.indices.size(); ++i)
+        out[i] = glm::uint16(data.indices[i]);
+}
+
+void vertex_format_print(const char * name, const VertexFormat & format, GLenum indexType, int vertexCount, int indexCount, int instanceCount)
+{
+    static const char * positionNames[] = { "float", "half" };
+    static const char * normalNames[] = { "float", "2_10_10_10" };
+    static const char * texcoordNames[] = { "float", "half", "unorm16" };
+
+    const int floatStride = 32;
+    double vertexFetches = double(indexCount) * instanceCount;
+    double floatBytes = vertexFetches * floatStride + double(indexCount) * 4;
+    double packedBytes = vertexFetches * format.stride + double(indexCount) * index_type_size(indexType);
+
+    fprintf(stdout, "Mesh %s : %d vertices, position %s, normal %s, uv %s, %s indices\n",
+            name, vertexCount,
+            positionNames[format.position], normalNames[format.normal], texcoordNames[format.texcoord],
+            indexType == GL_UNSIGNED_SHORT ? "16 bit" : "32 bit");
+    if (instanceCount == 0)
+        return;
+    fprintf(stdout, "    %d bytes per vertex (float layout %d), %.2f MB fetched per draw of %d instances (float layout %.2f MB, %.0f%% saved)\n",
+            format.stride, floatStride,
+            packedBytes / (1024. * 1024.), instanceCount, floatBytes / (1024. * 1024.),
+            100. * (1. - packedBytes / floatBytes));
+}
@@ -0,0 +1,199 @@
+#include "objimport.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <map>
+
+#include "glm/glm.hpp"
+
+struct ObjCorner
+{
+    int v, vt, vn;
+    bool operator<(const ObjCorner & o) const
+    {
+        if (v != o.v) return v < o.v;
+        if (vt != o.vt) return vt < o.vt;
+        return vn < o.vn;
+    }
+};
+
+// OBJ indices are 1 based, negative ones count back from the last element. 0 and
+// indices past either end are out of range.
+static bool obj_index(long index, size_t count, int & result)
+{
+    long i = index < 0 ? long(count) + index : index - 1;
+    result = int(i);
+    return index != 0 && i >= 0 && i < long(count);
+}
+
+// Absent vt and vn are -1, returns 0 when an index is out of range
+static const char * obj_parse_corner(const char * s, ObjCorner & corner, size_t vCount, size_t vtCount, size_t vnCount)
+{
+    char * end;
+    if (!obj_index(strtol(s, &end, 10), vCount, corner.v))
+        return 0;
+    corner.vt = -1;
+    corner.vn = -1;
+    if (*end == '/')
+    {
+        s = end + 1;
+        if (*s != '/')
+        {
+            if (!obj_index(strtol(s, &end, 10), vtCount, corner.vt))
+                return 0;
+            s = end;
+        }
+        if (*s == '/' && !obj_index(strtol(s + 1, &end, 10), vnCount, corner.vn))
+            return 0;
+    }
+    return end;
+}
+
+// Whole line, newline included, however long it is. False at the end of the file.
+static bool obj_read_line(FILE * f, std::string & line)
+{
+    char chunk[1024];
+    line.clear();
+    while (fgets(chunk, sizeof(chunk), f))
+    {
+        line += chunk;
+        if (line[line.size() - 1] == '\n')
+            break;
+    }
+    return !line.empty();
+}
+
+bool obj_load(const char * path, MeshData & data)
+{
+    FILE * f = fopen(path, "rb");
+    if (!f)
+    {
+        fprintf(stderr, "OBJ %s : can not open\n", path);
+        return false;
+    }
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+    std::map<ObjCorner, unsigned int> vertices;
+    bool missingNormals = false;
+
+    data.positions.clear();
+    data.normals.clear();
+    data.uvs.clear();
+    data.indices.clear();
+
+    std::string line;
+    int lineNumber = 0;
+    while (obj_read_line(f, line))
+    {
+        ++lineNumber;
+        const char * s = line.c_str();
+        while (*s == ' ' || *s == '\t')
+            ++s;
+
+        if (s[0] == 'v' && s[1] == ' ')
+        {
+            glm::vec3 p;
+            sscanf(s + 2, "%f %f %f", &p.x, &p.y, &p.z);
+            positions.push_back(p);
+        }
+        else if (s[0] == 'v' && s[1] == 't' && s[2] == ' ')
+        {
+            glm::vec2 uv;
+            sscanf(s + 3, "%f %f", &uv.x, &uv.y);
+            uvs.push_back(uv);
+        }
+        else if (s[0] == 'v' && s[1] == 'n' && s[2] == ' ')
+        {
+            glm::vec3 n;
+            sscanf(s + 3, "%f %f %f", &n.x, &n.y, &n.z);
+            normals.push_back(n);
+        }
+        else if (s[0] == 'f' && s[1] == ' ')
+        {
+            unsigned int polygon[64];
+            int cornerCount = 0;
+            s += 2;
+            while (*s)
+            {
+                while (*s == ' ' || *s == '\t')
+                    ++s;
+                if (*s == '\r' || *s == '\n' || *s == 0)
+                    break;
+                if (cornerCount == 64)
+                {
+                    fprintf(stderr, "OBJ %s:%d : too many corners\n", path, lineNumber);
+                    fclose(f);
+                    return false;
+                }
+
+                ObjCorner corner;
+                s = obj_parse_corner(s, corner, positions.size(), uvs.size(), normals.size());
+                if (!s)
+                {
+                    fprintf(stderr, "OBJ %s:%d : index out of range\n", path, lineNumber);
+                    fclose(f);
+                    return false;
+                }
+
+                std::map<ObjCorner, unsigned int>::iterator it = vertices.find(corner);
+                if (it == vertices.end())
+                {
+                    unsigned int index = (unsigned int)vertices.size();
+                    it = vertices.insert(std::make_pair(corner, index)).first;
+
+                    glm::vec3 p = positions[corner.v];
+                    glm::vec2 uv = corner.vt >= 0 ? uvs[corner.vt] : glm::vec2(0.f);
+                    glm::vec3 n = corner.vn >= 0 ? normals[corner.vn] : glm::vec3(0.f);
+                    missingNormals = missingNormals || corner.vn < 0;
+                    data.positions.push_back(p.x); data.positions.push_back(p.y); data.positions.push_back(p.z);
+                    data.normals.push_back(n.x); data.normals.push_back(n.y); data.normals.push_back(n.z);
+                    data.uvs.push_back(uv.x); data.uvs.push_back(uv.y);
+                }
+                polygon[cornerCount++] = it->second;
+            }
+            for (int i = 2; i < cornerCount; ++i)
+            {
+                data.indices.push_back(polygon[0]);
+                data.indices.push_back(polygon[i - 1]);
+                data.indices.push_back(polygon[i]);
+            }
+        }
+    }
+    fclose(f);
+
+    if (missingNormals)
+    {
+        // Area weighted face normals accumulated on the vertices without one
+        std::vector<glm::vec3> generated(vertices.size(), glm::vec3(0.f));
+        const glm::vec3 * p = (const glm::vec3 *)&data.positions[0];
+        for (size_t i = 0; i + 2 < data.indices.size(); i += 3)
+        {
+            unsigned int a = data.indices[i], b = data.indices[i + 1], c = data.indices[i + 2];
+            glm::vec3 n = glm::cross(p[b] - p[a], p[c] - p[a]);
+            generated[a] += n;
+            generated[b] += n;
+            generated[c] += n;
+        }
+        for (std::map<ObjCorner, unsigned int>::const_iterator it = vertices.begin(); it != vertices.end(); ++it)
+        {
+            if (it->first.vn >= 0)
+                continue;
+            float length = glm::length(generated[it->second]);
+            glm::vec3 n = length > 0.f ? generated[it->second] / length : glm::vec3(0.f, 1.f, 0.f);
+            data.normals[it->second * 3 + 0] = n.x;
+            data.normals[it->second * 3 + 1] = n.y;
+            data.normals[it->second * 3 + 2] = n.z;
+        }
+    }
+
+    if (data.indices.empty())
+    {
+        fprintf(stderr, "OBJ %s : no faces\n", path);
+        return false;
+    }
+    return true;
+}
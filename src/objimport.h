@@ -0,0 +1,11 @@
+#ifndef AOGL_OBJIMPORT_H
+#define AOGL_OBJIMPORT_H
+
+#include "mesh.h"
+
+// Load positions, uvs and normals of every face of a Wavefront OBJ into data.
+// Polygons are triangulated as fans, identical v/vt/vn corners share one vertex
+// and missing normals are generated from the faces. Materials and groups are ignored.
+bool obj_load(const char * path, MeshData & data);
+
+#endif // AOGL_OBJIMPORT_H
@@ -0,0 +1,180 @@
+#include "programcache.h"
+#include "shadersource.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void make_directory(const char * path)
+{
+#ifdef _WIN32
+    _mkdir(path);
+#else
+    mkdir(path, 0755);
+#endif
+}
+
+// FNV-1a, 64 bits
+static unsigned long long hash_bytes(unsigned long long hash, const void * data, size_t size)
+{
+    const unsigned char * bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+static bool read_file(const char * path, std::vector<char> & data)
+{
+    FILE * f = fopen(path, "rb");
+    if (!f)
+        return false;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data.resize(size > 0 ? size : 0);
+    bool ok = size >= 0 && (data.empty() || fread(&data[0], 1, data.size(), f) == data.size());
+    fclose(f);
+    return ok;
+}
+
+static std::string program_path(const ProgramCache & cache, unsigned long long key)
+{
+    char name[32];
+    sprintf(name, "/%016llx.bin", key);
+    return cache.directory + name;
+}
+
+void program_cache_init(ProgramCache & cache, const char * directory, bool enabled)
+{
+    cache.directory = directory;
+    cache.hits = cache.misses = 0;
+    cache.loadTime = cache.savedTime = cache.compileTime = 0.0;
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    cache.enabled = enabled && formatCount > 0;
+    if (enabled && formatCount == 0)
+        fprintf(stderr, "Program cache : the driver has no program binary format, disabled\n");
+
+    const GLenum names[4] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+    cache.driver.clear();
+    for (int i = 0; i < 4; ++i)
+    {
+        const char * value = (const char *)glGetString(names[i]);
+        cache.driver += value ? value : "";
+        cache.driver += '\n';
+    }
+    if (cache.enabled)
+        make_directory(directory);
+}
+
+unsigned long long program_cache_key(const ProgramCache & cache, const ProgramStage * stages, const std::string * sources, int stageCount)
+{
+    unsigned long long key = hash_bytes(0xCBF29CE484222325ull, cache.driver.c_str(), cache.driver.size());
+    for (int i = 0; i < stageCount; ++i)
+    {
+        key = hash_bytes(key, &stages[i].type, sizeof(stages[i].type));
+        key = hash_bytes(key, sources[i].c_str(), sources[i].size());
+    }
+    return key;
+}
+
+GLuint program_cache_load(ProgramCache & cache, const ProgramStage * stages, int stageCount, unsigned long long & key)
+{
+    std::vector<std::string> sources(stageCount);
+    std::vector<std::string> files;
+    bool readable = true;
+    for (int i = 0; i < stageCount && readable; ++i)
+        readable = shader_source_expand(stages[i].path, stages[i].defines, sources[i], files);
+    key = readable ? program_cache_key(cache, stages, &sources[0], stageCount) : 0;
+    ++cache.misses;
+    if (!cache.enabled || key == 0)
+        return 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::string path = program_path(cache, key);
+    std::vector<char> file;
+    if (!read_file(path.c_str(), file) || file.size() < sizeof(ProgramCacheHeader))
+        return 0;
+    ProgramCacheHeader header;
+    memcpy(&header, &file[0], sizeof(header));
+    if (header.magic != PROGRAM_CACHE_MAGIC || header.version != PROGRAM_CACHE_VERSION || header.key != key
+        || sizeof(header) + header.length != file.size())
+    {
+        fprintf(stderr, "Program cache : %s is not a valid cached program, compiling\n", path.c_str());
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, &file[sizeof(header)], GLsizei(header.length));
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status == GL_FALSE)
+    {
+        // Drivers may refuse their own binaries after an update that did not change the strings
+        fprintf(stderr, "Program cache : %s refused by the driver, compiling\n", path.c_str());
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    --cache.misses;
+    ++cache.hits;
+    cache.loadTime += elapsed_ms(start);
+    cache.savedTime += header.compileTime;
+    return program;
+}
+
+void program_cache_store(ProgramCache & cache, unsigned long long key, GLuint program, double compileTime)
+{
+    cache.compileTime += compileTime;
+    if (!cache.enabled || key == 0)
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    std::vector<char> file(sizeof(ProgramCacheHeader) + length);
+    ProgramCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = PROGRAM_CACHE_MAGIC;
+    header.version = PROGRAM_CACHE_VERSION;
+    header.key = key;
+    header.compileTime = compileTime;
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, &file[sizeof(header)]);
+    if (written <= 0)
+        return;
+    header.format = format;
+    header.length = written;
+    memcpy(&file[0], &header, sizeof(header));
+    file.resize(sizeof(header) + written);
+
+    std::string path = program_path(cache, key);
+    FILE * f = fopen(path.c_str(), "wb");
+    bool ok = f && fwrite(&file[0], 1, file.size(), f) == file.size();
+    ok = f && fclose(f) == 0 && ok;
+    if (!ok)
+        fprintf(stderr, "Program cache : can not write %s\n", path.c_str());
+}
+
+void program_cache_report(const ProgramCache & cache)
+{
+    fprintf(stdout, "Program cache : %d hits loaded in %.2f ms instead of %.2f ms, %d misses compiled and linked in %.2f ms%s\n",
+            cache.hits, cache.loadTime, cache.savedTime, cache.misses, cache.compileTime, cache.enabled ? "" : " (disabled)");
+}
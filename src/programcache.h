@@ -0,0 +1,57 @@
+#ifndef AOGL_PROGRAMCACHE_H
+#define AOGL_PROGRAMCACHE_H
+
+#include <string>
+
+#include "glew/glew.h"
+
+const unsigned int PROGRAM_CACHE_MAGIC = 0x43504F41; // "AOPC"
+const unsigned int PROGRAM_CACHE_VERSION = 1;
+
+struct ProgramStage
+{
+    GLenum type;
+    const char * path;
+    const char * defines; // variant of the shader, see shader_source_expand, may be 0
+};
+
+// Header of a cached program file, followed by length bytes of glGetProgramBinary output
+struct ProgramCacheHeader
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned long long key;
+    unsigned int format;
+    unsigned int length;
+    double compileTime; // ms it took to compile and link the program when it was stored
+};
+
+// Linked programs saved with glGetProgramBinary, one file per program named after a hash of
+// its expanded stage sources and of the driver strings, so editing a shader or one it
+// includes, changing its defines or updating the driver misses instead of loading a stale
+// binary. A binary the driver refuses also misses.
+struct ProgramCache
+{
+    std::string directory;
+    std::string driver; // vendor, renderer and versions, part of every key
+    bool enabled; // false without binary formats or when disabled by the caller
+    int hits;
+    int misses;
+    double loadTime; // ms spent loading the hits
+    double savedTime; // ms the hits took to compile and link when they were stored
+    double compileTime; // ms spent compiling and linking the misses
+};
+
+// Call with a current context. enabled false only counts the misses.
+void program_cache_init(ProgramCache & cache, const char * directory, bool enabled);
+// Key of the program linked from stages with these expanded sources
+unsigned long long program_cache_key(const ProgramCache & cache, const ProgramStage * stages, const std::string * sources, int stageCount);
+// Program of stages from the cache, 0 on a miss. key identifies the program for program_cache_store,
+// it is 0 if a stage can not be read.
+GLuint program_cache_load(ProgramCache & cache, const ProgramStage * stages, int stageCount, unsigned long long & key);
+// Save a program linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT after a miss, compileTime in ms
+void program_cache_store(ProgramCache & cache, unsigned long long key, GLuint program, double compileTime);
+// Print the hits, misses and the time saved
+void program_cache_report(const ProgramCache & cache);
+
+#endif // AOGL_PROGRAMCACHE_H
@@ -0,0 +1,149 @@
+#include "renderqueue.h"
+
+#include <cmath>
+#include <string.h>
+
+static const int RENDER_KEY_PASS_SHIFT = 60;
+static const int RENDER_KEY_PROGRAM_SHIFT = 52;
+static const int RENDER_KEY_MATERIAL_SHIFT = 36;
+static const int RENDER_KEY_VAO_SHIFT = 24;
+static const int RENDER_KEY_DEPTH_SHIFT = 8;
+
+template <typename T>
+static unsigned long long render_queue_id(std::vector<T> & ids, T value, unsigned long long maxId)
+{
+    size_t id = 0;
+    while (id < ids.size() && ids[id] != value)
+        ++id;
+    if (id == ids.size())
+        ids.push_back(value);
+    // Past the key range everything shares the last id, the order is then only partial
+    return id < maxId ? id : maxId;
+}
+
+void render_queue_clear(RenderQueue & queue)
+{
+    queue.draws.clear();
+    queue.items.clear();
+}
+
+void render_queue_push(RenderQueue & queue, RenderPass pass, const RenderDraw & draw, float depth)
+{
+    unsigned long long program = render_queue_id(queue.programs, draw.program, 0xffull);
+    unsigned long long material = render_queue_id(queue.materials, (unsigned long long)draw.textures[0] << 32 | draw.textures[1], 0xffffull);
+    unsigned long long vao = render_queue_id(queue.vaos, draw.vao, 0xfffull);
+    // Logarithmic buckets, 4096 per octave covers up to the far plane in 16 bits
+    float bucket = std::log2(1.f + (depth > 0.f ? depth : 0.f)) * 4096.f;
+    unsigned long long depthBucket = bucket < 65535.f ? (unsigned long long)bucket : 0xffffull;
+
+    RenderItem item;
+    item.key = (unsigned long long)pass << RENDER_KEY_PASS_SHIFT
+             | program << RENDER_KEY_PROGRAM_SHIFT
+             | material << RENDER_KEY_MATERIAL_SHIFT
+             | vao << RENDER_KEY_VAO_SHIFT
+             | depthBucket << RENDER_KEY_DEPTH_SHIFT;
+    item.draw = unsigned(queue.draws.size());
+    queue.draws.push_back(draw);
+    queue.items.push_back(item);
+}
+
+void render_queue_sort(RenderQueue & queue)
+{
+    std::vector<RenderItem> & items = queue.items;
+    std::vector<RenderItem> & scratch = queue.sortScratch;
+    size_t count = items.size();
+    if (count < 2)
+        return;
+    scratch.resize(count);
+
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        size_t offsets[256];
+        memset(offsets, 0, sizeof(offsets));
+        for (size_t i = 0; i < count; ++i)
+            ++offsets[(items[i].key >> shift) & 0xff];
+        // Every key has the same byte here, nothing to move
+        if (offsets[(items[0].key >> shift) & 0xff] == count)
+            continue;
+
+        size_t sum = 0;
+        for (int b = 0; b < 256; ++b)
+        {
+            size_t c = offsets[b];
+            offsets[b] = sum;
+            sum += c;
+        }
+        for (size_t i = 0; i < count; ++i)
+            scratch[offsets[(items[i].key >> shift) & 0xff]++] = items[i];
+        items.swap(scratch);
+    }
+}
+
+RenderQueueStats render_queue_stats(const RenderQueue & queue)
+{
+    RenderQueueStats stats = {0, 0, 0};
+    GLuint program = 0;
+    GLuint vao = 0;
+    GLuint textures[2] = {0, 0};
+    for (size_t i = 0; i < queue.items.size(); ++i)
+    {
+        const RenderDraw & draw = queue.draws[queue.items[i].draw];
+        if (draw.program != program)
+        {
+            program = draw.program;
+            ++stats.programs;
+        }
+        if (draw.vao != vao)
+        {
+            vao = draw.vao;
+            ++stats.vaos;
+        }
+        for (int t = 0; t < 2; ++t)
+        {
+            if (draw.textures[t] != 0 && draw.textures[t] != textures[t])
+            {
+                textures[t] = draw.textures[t];
+                ++stats.textures;
+            }
+        }
+    }
+    return stats;
+}
+
+void render_queue_submit(const RenderQueue & queue, GlState & state)
+{
+    // Same walk as render_queue_stats, binding for real
+    for (size_t i = 0; i < queue.items.size(); ++i)
+    {
+        const RenderDraw & draw = queue.draws[queue.items[i].draw];
+        GLuint program = draw.program;
+        gl_state_use_program(state, program);
+        gl_state_bind_vertex_array(state, draw.vao);
+        for (int t = 0; t < 2; ++t)
+            if (draw.textures[t] != 0)
+                gl_state_bind_texture(state, t, GL_TEXTURE_2D, draw.textures[t]);
+        if (draw.rigidLocation != -1)
+            glProgramUniform1i(program, draw.rigidLocation, draw.rigid);
+
+        switch (draw.type)
+        {
+        case RENDER_DRAW_ELEMENTS:
+            if (draw.drawIdLocation != -1)
+                glProgramUniform1i(program, draw.drawIdLocation, draw.drawId);
+            glDrawElementsInstancedBaseInstance(GL_TRIANGLES, draw.count, draw.indexType, 0, draw.instanceCount, draw.baseInstance);
+            break;
+        case RENDER_DRAW_INDIRECT:
+            if (draw.drawIdLocation != -1)
+                glProgramUniform1i(program, draw.drawIdLocation, draw.drawId);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, draw.indirectBuffer);
+            glDrawElementsIndirect(GL_TRIANGLES, draw.indexType, 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            break;
+        case RENDER_DRAW_BATCH:
+            // The batch sets the draw id itself
+            mesh_batch_submit(*draw.batch, program, draw.drawIdLocation);
+            break;
+        }
+    }
+    gl_state_active_texture(state, 0);
+}
@@ -0,0 +1,82 @@
+#ifndef AOGL_RENDERQUEUE_H
+#define AOGL_RENDERQUEUE_H
+
+#include <vector>
+
+#include "glew/glew.h"
+
+#include "meshbatch.h"
+#include "glstate.h"
+
+// Passes in submission order, the highest bits of the sort key
+enum RenderPass
+{
+    RENDER_PASS_DEPTH = 0,
+    RENDER_PASS_GBUFFER = 1
+};
+
+enum RenderDrawType
+{
+    RENDER_DRAW_ELEMENTS, // one instanced glDrawElements of the whole index buffer
+    RENDER_DRAW_INDIRECT, // one glDrawElementsIndirect from indirectBuffer
+    RENDER_DRAW_BATCH // every command of batch
+};
+
+// Everything needed to issue a draw, the queue binds the state and skips what is already bound
+struct RenderDraw
+{
+    RenderDrawType type;
+    GLuint program;
+    GLuint vao;
+    GLuint textures[2]; // diffuse and specular units, 0 leaves the unit alone
+    GLint drawIdLocation; // DrawIdOffset, -1 if the program has none
+    GLint drawId;
+    GLint rigidLocation; // Rigid, -1 if the program has none
+    GLint rigid;
+
+    GLenum indexType;
+    GLsizei count;
+    GLsizei instanceCount;
+    GLuint baseInstance;
+    GLuint indirectBuffer;
+    const MeshBatch * batch;
+};
+
+// Sort key, high to low bits : pass 4, program 8, material 16, vao 12, depth 16, unused 8
+struct RenderItem
+{
+    unsigned long long key;
+    unsigned int draw;
+};
+
+// Binds a submission in the current item order would do
+struct RenderQueueStats
+{
+    int programs;
+    int vaos;
+    int textures;
+};
+
+// Programs, vaos and texture pairs get small ids the first time they are seen,
+// the ids stay valid across frames so the order is stable
+struct RenderQueue
+{
+    std::vector<RenderDraw> draws;
+    std::vector<RenderItem> items;
+    std::vector<RenderItem> sortScratch;
+    std::vector<GLuint> programs;
+    std::vector<GLuint> vaos;
+    std::vector<unsigned long long> materials;
+};
+
+void render_queue_clear(RenderQueue & queue);
+// depth is the view distance of the draw, front to back within equal state
+void render_queue_push(RenderQueue & queue, RenderPass pass, const RenderDraw & draw, float depth);
+// Stable lsd radix sort of the items by key
+void render_queue_sort(RenderQueue & queue);
+RenderQueueStats render_queue_stats(const RenderQueue & queue);
+// Binds through state, so what the previous draws of the frame left bound is not sent again.
+// Leaves unit 0 active.
+void render_queue_submit(const RenderQueue & queue, GlState & state);
+
+#endif // AOGL_RENDERQUEUE_H
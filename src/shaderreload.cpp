@@ -0,0 +1,326 @@
+#include "shaderreload.h"
+#include "shadersource.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void push_changed(ShaderReload * reload, const std::string & path)
+{
+    std::lock_guard<std::mutex> lock(reload->mutex);
+    reload->changed.push_back(path);
+}
+
+#ifdef __linux__
+// Editors either write the file in place or write another one and rename it over
+static void shader_reload_inotify(ShaderReload * reload, int fd, std::vector< std::pair<int, std::string> > watches)
+{
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (reload->running)
+    {
+        pollfd descriptor = {fd, POLLIN, 0};
+        if (poll(&descriptor, 1, 100) <= 0)
+            continue;
+        ssize_t size = read(fd, buffer, sizeof(buffer));
+        for (ssize_t offset = 0; offset < size; )
+        {
+            const inotify_event * event = (const inotify_event *)(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+            if (event->len == 0 || !(event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)))
+                continue;
+            for (size_t i = 0; i < watches.size(); ++i)
+                if (watches[i].first == event->wd)
+                    push_changed(reload, watches[i].second + "/" + event->name);
+        }
+    }
+    close(fd);
+}
+#else
+static void shader_reload_poll(ShaderReload * reload, std::vector<std::string> paths)
+{
+    std::vector<time_t> times(paths.size(), 0);
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        struct stat info;
+        if (stat(paths[i].c_str(), &info) == 0)
+            times[i] = info.st_mtime;
+    }
+    while (reload->running)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        for (size_t i = 0; i < paths.size(); ++i)
+        {
+            struct stat info;
+            if (stat(paths[i].c_str(), &info) == 0 && info.st_mtime != times[i])
+            {
+                times[i] = info.st_mtime;
+                push_changed(reload, paths[i]);
+            }
+        }
+    }
+}
+#endif
+
+static void cancel_build(ShaderReloadProgram & program)
+{
+    for (size_t i = 0; i < program.shaders.size(); ++i)
+        glDeleteShader(program.shaders[i]);
+    program.shaders.clear();
+    if (program.program)
+        glDeleteProgram(program.program);
+    program.program = 0;
+    program.state = SHADER_RELOAD_IDLE;
+}
+
+static void print_log(const char * what, const std::string & name, GLuint object, bool isProgram)
+{
+    GLint length = 0;
+    if (isProgram)
+        glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length);
+    else
+        glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+    std::vector<char> log(length + 1, 0);
+    if (isProgram)
+        glGetProgramInfoLog(object, length, 0, &log[0]);
+    else
+        glGetShaderInfoLog(object, length, 0, &log[0]);
+    fprintf(stderr, "Shader reload : %s %s failed, keeping the previous program\n%s\n", name.c_str(), what, &log[0]);
+}
+
+static bool completed(const ShaderReload & reload, GLuint object, bool isProgram)
+{
+    if (!reload.parallel)
+        return true;
+    GLint status = GL_FALSE;
+    if (isProgram)
+        glGetProgramiv(object, GL_COMPLETION_STATUS_KHR, &status);
+    else
+        glGetShaderiv(object, GL_COMPLETION_STATUS_KHR, &status);
+    return status == GL_TRUE;
+}
+
+// Expand the stages again, the includes may have changed too
+static bool expand_stages(ShaderReloadProgram & program)
+{
+    program.sources.resize(program.paths.size());
+    program.files.clear();
+    bool expanded = true;
+    for (size_t i = 0; i < program.paths.size(); ++i)
+    {
+        std::vector<std::string> files;
+        expanded = shader_source_expand(program.paths[i].c_str(), program.defines[i].c_str(), program.sources[i], files) && expanded;
+        program.files.insert(program.files.end(), files.begin(), files.end());
+    }
+    return expanded;
+}
+
+static void start_build(ShaderReloadProgram & program)
+{
+    // Sources changed again while building, the build of the older ones is dropped
+    cancel_build(program);
+    if (!expand_stages(program))
+        return;
+    program.start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < program.paths.size(); ++i)
+    {
+        GLuint shader = glCreateShader(program.types[i]);
+        const char * source = program.sources[i].c_str();
+        glShaderSource(shader, 1, &source, 0);
+        glCompileShader(shader);
+        program.shaders.push_back(shader);
+    }
+    program.state = SHADER_RELOAD_COMPILING;
+}
+
+static void poll_build(ShaderReload & reload, ShaderReloadProgram & program, GLuint * programs, std::vector<int> & swapped)
+{
+    if (program.state == SHADER_RELOAD_COMPILING)
+    {
+        for (size_t i = 0; i < program.shaders.size(); ++i)
+            if (!completed(reload, program.shaders[i], false))
+                return;
+        for (size_t i = 0; i < program.shaders.size(); ++i)
+        {
+            GLint status = GL_FALSE;
+            glGetShaderiv(program.shaders[i], GL_COMPILE_STATUS, &status);
+            if (status == GL_FALSE)
+            {
+                print_log("compilation", program.paths[i], program.shaders[i], false);
+                ++reload.failures;
+                cancel_build(program);
+                return;
+            }
+        }
+        program.program = glCreateProgram();
+        if (reload.cache)
+            glProgramParameteri(program.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        for (size_t i = 0; i < program.shaders.size(); ++i)
+            glAttachShader(program.program, program.shaders[i]);
+        glLinkProgram(program.program);
+        program.state = SHADER_RELOAD_LINKING;
+    }
+
+    if (!completed(reload, program.program, true))
+        return;
+    GLint status = GL_FALSE;
+    glGetProgramiv(program.program, GL_LINK_STATUS, &status);
+    if (status == GL_FALSE)
+    {
+        print_log("link", program.paths[0], program.program, true);
+        ++reload.failures;
+        cancel_build(program);
+        return;
+    }
+
+    double buildTime = elapsed_ms(program.start);
+    if (reload.cache)
+    {
+        std::vector<ProgramStage> stages(program.paths.size());
+        for (size_t i = 0; i < stages.size(); ++i)
+        {
+            stages[i].type = program.types[i];
+            stages[i].path = program.paths[i].c_str();
+            stages[i].defines = program.defines[i].c_str();
+        }
+        unsigned long long key = program_cache_key(*reload.cache, &stages[0], &program.sources[0], int(stages.size()));
+        program_cache_store(*reload.cache, key, program.program, buildTime);
+    }
+
+    // The old program may still be used by the commands in flight, GL deletes it after them
+    glDeleteProgram(programs[program.index]);
+    programs[program.index] = program.program;
+    swapped.push_back(program.index);
+    ++reload.reloads;
+    fprintf(stdout, "Shader reload : program %d rebuilt in %.2f ms\n", program.index, buildTime);
+
+    program.program = 0;
+    cancel_build(program);
+}
+
+void shader_reload_init(ShaderReload & reload, ProgramCache * cache)
+{
+    reload.cache = cache;
+    reload.running = false;
+    reload.reloads = reload.failures = 0;
+    reload.parallel = false;
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount; ++i)
+    {
+        const char * name = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        if (name && (strcmp(name, "GL_KHR_parallel_shader_compile") == 0 || strcmp(name, "GL_ARB_parallel_shader_compile") == 0))
+            reload.parallel = true;
+    }
+}
+
+void shader_reload_add(ShaderReload & reload, int index, const ProgramStage * stages, int stageCount)
+{
+    ShaderReloadProgram program;
+    program.index = index;
+    for (int i = 0; i < stageCount; ++i)
+    {
+        program.types.push_back(stages[i].type);
+        program.paths.push_back(stages[i].path);
+        program.defines.push_back(stages[i].defines ? stages[i].defines : "");
+    }
+    expand_stages(program);
+    program.state = SHADER_RELOAD_IDLE;
+    program.program = 0;
+    reload.programs.push_back(program);
+}
+
+bool shader_reload_watch(ShaderReload & reload, const char * directory)
+{
+    reload.directory = directory;
+#ifdef __linux__
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Shader reload : inotify unavailable, not watching %s\n", directory);
+        return false;
+    }
+    // The directory and its subdirectories, one level deep like shaders/tp2
+    std::vector<std::string> directories(1, reload.directory);
+    if (DIR * dir = opendir(directory))
+    {
+        while (dirent * entry = readdir(dir))
+        {
+            std::string path = reload.directory + "/" + entry->d_name;
+            struct stat info;
+            if (entry->d_name[0] != '.' && stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode))
+                directories.push_back(path);
+        }
+        closedir(dir);
+    }
+    std::vector< std::pair<int, std::string> > watches;
+    for (size_t i = 0; i < directories.size(); ++i)
+    {
+        int wd = inotify_add_watch(fd, directories[i].c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd >= 0)
+            watches.push_back(std::make_pair(wd, directories[i]));
+    }
+    if (watches.empty())
+    {
+        fprintf(stderr, "Shader reload : can not watch %s\n", directory);
+        close(fd);
+        return false;
+    }
+    reload.running = true;
+    reload.watcher = std::thread(shader_reload_inotify, &reload, fd, watches);
+#else
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < reload.programs.size(); ++i)
+        paths.insert(paths.end(), reload.programs[i].files.begin(), reload.programs[i].files.end());
+    reload.running = true;
+    reload.watcher = std::thread(shader_reload_poll, &reload, paths);
+#endif
+    fprintf(stdout, "Shader reload : watching %s, %s compilation\n", directory, reload.parallel ? "parallel" : "blocking");
+    return true;
+}
+
+void shader_reload_update(ShaderReload & reload, GLuint * programs, std::vector<int> & swapped)
+{
+    std::vector<std::string> changed;
+    {
+        std::lock_guard<std::mutex> lock(reload.mutex);
+        changed.swap(reload.changed);
+    }
+    for (size_t i = 0; i < reload.programs.size(); ++i)
+    {
+        ShaderReloadProgram & program = reload.programs[i];
+        bool dirty = false;
+        for (size_t j = 0; j < changed.size() && !dirty; ++j)
+            for (size_t k = 0; k < program.files.size() && !dirty; ++k)
+                dirty = changed[j] == program.files[k];
+        if (dirty)
+            start_build(program);
+        if (program.state != SHADER_RELOAD_IDLE)
+            poll_build(reload, program, programs, swapped);
+    }
+}
+
+void shader_reload_release(ShaderReload & reload)
+{
+    if (reload.running)
+    {
+        reload.running = false;
+        reload.watcher.join();
+    }
+    for (size_t i = 0; i < reload.programs.size(); ++i)
+        cancel_build(reload.programs[i]);
+}
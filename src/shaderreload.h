@@ -0,0 +1,71 @@
+#ifndef AOGL_SHADERRELOAD_H
+#define AOGL_SHADERRELOAD_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#include "glew/glew.h"
+
+#include "programcache.h"
+
+enum ShaderReloadState
+{
+    SHADER_RELOAD_IDLE,
+    SHADER_RELOAD_COMPILING, // shaders compiling, polled
+    SHADER_RELOAD_LINKING // program linking, polled
+};
+
+// A program the caller renders with, rebuilt from its stages when one of them changes
+struct ShaderReloadProgram
+{
+    int index; // in the caller's program array
+    std::vector<GLenum> types;
+    std::vector<std::string> paths;
+    std::vector<std::string> defines;
+    std::vector<std::string> files; // the stages and the files they include, when last expanded
+    ShaderReloadState state;
+    std::vector<std::string> sources; // being compiled
+    std::vector<GLuint> shaders;
+    GLuint program; // being built, 0 while idle
+    std::chrono::steady_clock::time_point start;
+};
+
+// Shader hot reload. A watcher thread waits for writes to the shader directory, with
+// inotify on Linux and by polling modification times elsewhere. At frame start the
+// programs of the changed files are rebuilt beside the ones in use : compiled and
+// linked with GL_KHR_parallel_shader_compile when the driver has it and polled every
+// frame, so the frame never waits on the compiler, then swapped in once linked. A
+// program that fails to build prints its log and the old one keeps rendering. Without
+// the extension each change is built in one go, a short hitch at the frame it lands.
+struct ShaderReload
+{
+    std::vector<ShaderReloadProgram> programs;
+    ProgramCache * cache; // reloaded programs are stored there for the next start, may be 0
+    bool parallel; // GL_KHR_parallel_shader_compile
+    std::string directory;
+    std::thread watcher;
+    std::atomic<bool> running;
+    std::mutex mutex;
+    std::vector<std::string> changed; // written by the watcher since the last update
+    int reloads;
+    int failures;
+};
+
+// Call with a current context, before shader_reload_add
+void shader_reload_init(ShaderReload & reload, ProgramCache * cache);
+// Rebuild programs[index] from stages when one of their files, or one they include, changes
+void shader_reload_add(ShaderReload & reload, int index, const ProgramStage * stages, int stageCount);
+// Start watching directory and its subdirectories, stage paths are compared as given
+// so they must start with directory. Returns false if it can not be watched.
+bool shader_reload_watch(ShaderReload & reload, const char * directory);
+// Start building the programs whose files changed, poll those being built and swap the
+// finished ones into programs, deleting the old ones. Call at frame start. Indices of
+// the programs swapped are added to swapped, their uniforms are back to defaults.
+void shader_reload_update(ShaderReload & reload, GLuint * programs, std::vector<int> & swapped);
+void shader_reload_release(ShaderReload & reload);
+
+#endif // AOGL_SHADERRELOAD_H
@@ -0,0 +1,138 @@
+#include "shadersource.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static bool read_text(const char * path, std::string & text)
+{
+    FILE * f = fopen(path, "rb");
+    if (!f)
+        return false;
+    text.clear();
+    char buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        text.append(buffer, count);
+    fclose(f);
+    return true;
+}
+
+static const char * skip_spaces(const char * c)
+{
+    while (*c == ' ' || *c == '\t')
+        ++c;
+    return c;
+}
+
+// "#include" then a name between quotes, false if the line is anything else
+static bool parse_include(const std::string & line, std::string & name)
+{
+    const char * c = skip_spaces(line.c_str());
+    if (*c != '#')
+        return false;
+    c = skip_spaces(c + 1);
+    if (strncmp(c, "include", 7) != 0)
+        return false;
+    c = skip_spaces(c + 7);
+    if (*c != '"')
+        return false;
+    const char * end = strchr(c + 1, '"');
+    if (!end)
+        return false;
+    name.assign(c + 1, end);
+    return true;
+}
+
+static bool is_version(const std::string & line)
+{
+    const char * c = skip_spaces(line.c_str());
+    if (*c != '#')
+        return false;
+    c = skip_spaces(c + 1);
+    return strncmp(c, "version", 7) == 0;
+}
+
+static void append_defines(const char * defines, std::string & source)
+{
+    const char * c = skip_spaces(defines);
+    while (*c)
+    {
+        const char * end = c;
+        while (*end && *end != ' ' && *end != '\t')
+            ++end;
+        std::string define(c, end);
+        size_t equal = define.find('=');
+        source += "#define ";
+        if (equal == std::string::npos)
+            source += define;
+        else
+            source += define.substr(0, equal) + " " + define.substr(equal + 1);
+        source += '\n';
+        c = skip_spaces(end);
+    }
+}
+
+// Files already expanded are skipped, which also ends include cycles
+static bool expand_file(const std::string & path, const char * defines, std::string & source, std::vector<std::string> & files)
+{
+    for (size_t i = 0; i < files.size(); ++i)
+        if (files[i] == path)
+            return true;
+    int file = int(files.size());
+    files.push_back(path);
+
+    std::string text;
+    if (!read_text(path.c_str(), text))
+    {
+        fprintf(stderr, "Shader source : can not read %s\n", path.c_str());
+        return false;
+    }
+    std::string directory;
+    size_t slash = path.find_last_of("/\\");
+    if (slash != std::string::npos)
+        directory = path.substr(0, slash + 1);
+
+    char lineDirective[64];
+    if (file > 0)
+    {
+        sprintf(lineDirective, "#line 1 %d\n", file);
+        source += lineDirective;
+    }
+    int lineNumber = 1;
+    for (size_t begin = 0; begin < text.size(); ++lineNumber)
+    {
+        size_t end = text.find('\n', begin);
+        if (end == std::string::npos)
+            end = text.size();
+        std::string line = text.substr(begin, end - begin);
+        begin = end + 1;
+
+        std::string name;
+        if (parse_include(line, name))
+        {
+            if (!expand_file(directory + name, 0, source, files))
+                return false;
+            sprintf(lineDirective, "#line %d %d\n", lineNumber + 1, file);
+            source += lineDirective;
+        }
+        else if (defines && *defines && is_version(line))
+        {
+            source += line + '\n';
+            append_defines(defines, source);
+            sprintf(lineDirective, "#line %d %d\n", lineNumber + 1, file);
+            source += lineDirective;
+        }
+        else
+        {
+            source += line + '\n';
+        }
+    }
+    return true;
+}
+
+bool shader_source_expand(const char * path, const char * defines, std::string & source, std::vector<std::string> & files)
+{
+    source.clear();
+    files.clear();
+    return expand_file(path, defines, source, files);
+}
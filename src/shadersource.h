@@ -0,0 +1,16 @@
+#ifndef AOGL_SHADERSOURCE_H
+#define AOGL_SHADERSOURCE_H
+
+#include <string>
+#include <vector>
+
+// GLSL sources with #include and #define permutations, expanded before compiling.
+// A line #include "file" is replaced by that file, found relative to the including one,
+// and each file is included once per expansion. defines lists NAME=VALUE or NAME
+// separated by spaces, each becomes a #define right after #version : a shader written
+// with #ifdef NAME around a constant and a uniform fallback gets the constant folded in
+// the variants that define NAME. #line directives keep compile logs pointing at the
+// right line, their source string number is the index of the file in files.
+bool shader_source_expand(const char * path, const char * defines, std::string & source, std::vector<std::string> & files);
+
+#endif // AOGL_SHADERSOURCE_H
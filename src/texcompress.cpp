@@ -0,0 +1,419 @@
+#include "texcompress.h"
+
+#include <string.h>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AOGL_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Cpu only, no GL calls so tools can use it
+
+void rgba_image_from_pixels(RgbaImage & image, const unsigned char * pixels, int width, int height, int components)
+{
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(size_t(width) * height * 4);
+    for (size_t i = 0; i < size_t(width) * height; ++i)
+    {
+        unsigned char * p = &image.pixels[i * 4];
+        const unsigned char * s = pixels + i * components;
+        p[0] = s[0];
+        p[1] = components > 1 ? s[1] : 0;
+        p[2] = components > 2 ? s[2] : 0;
+        p[3] = components > 3 ? s[3] : 255;
+    }
+}
+
+// Mip generation ------------------------------------------------------------------------------------------
+
+static void downsample_texel(const RgbaImage & source, int x, int y, unsigned char * out)
+{
+    int x1 = x * 2 + 1 < source.width ? x * 2 + 1 : source.width - 1;
+    int y1 = y * 2 + 1 < source.height ? y * 2 + 1 : source.height - 1;
+    const unsigned char * a = &source.pixels[(size_t(y * 2) * source.width + x * 2) * 4];
+    const unsigned char * b = &source.pixels[(size_t(y * 2) * source.width + x1) * 4];
+    const unsigned char * c = &source.pixels[(size_t(y1) * source.width + x * 2) * 4];
+    const unsigned char * d = &source.pixels[(size_t(y1) * source.width + x1) * 4];
+    for (int k = 0; k < 4; ++k)
+        out[k] = (unsigned char)((a[k] + b[k] + c[k] + d[k] + 2) >> 2);
+}
+
+void rgba_image_downsample(const RgbaImage & source, RgbaImage & destination)
+{
+    destination.width = source.width > 1 ? source.width / 2 : 1;
+    destination.height = source.height > 1 ? source.height / 2 : 1;
+    destination.pixels.resize(size_t(destination.width) * destination.height * 4);
+
+    for (int y = 0; y < destination.height; ++y)
+    {
+        unsigned char * out = &destination.pixels[size_t(y) * destination.width * 4];
+        int x = 0;
+#ifdef AOGL_SSE2
+        // Two destination texels per iteration from two rows of four source texels,
+        // only where the 2x2 footprints are inside the source
+        if (source.height > 1)
+        {
+            const unsigned char * row0 = &source.pixels[size_t(y * 2) * source.width * 4];
+            const unsigned char * row1 = row0 + size_t(source.width) * 4;
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i rounding = _mm_set1_epi16(2);
+            for (; x + 2 <= destination.width && x * 2 + 4 <= source.width; x += 2)
+            {
+                __m128i r0 = _mm_loadu_si128((const __m128i *)(row0 + x * 8));
+                __m128i r1 = _mm_loadu_si128((const __m128i *)(row1 + x * 8));
+                // Vertical sums of texels 0 1 and 2 3, 16 bits per channel
+                __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(r0, zero), _mm_unpacklo_epi8(r1, zero));
+                __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(r0, zero), _mm_unpackhi_epi8(r1, zero));
+                // Horizontal : (0 + 1, 2 + 3)
+                __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+                sum = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+                _mm_storel_epi64((__m128i *)(out + x * 4), _mm_packus_epi16(sum, zero));
+            }
+        }
+#endif
+        for (; x < destination.width; ++x)
+            downsample_texel(source, x, y, out + x * 4);
+    }
+}
+
+void rgba_image_mip_chain(const RgbaImage & base, std::vector<RgbaImage> & levels)
+{
+    levels.clear();
+    levels.push_back(base);
+    while (levels.back().width > 1 || levels.back().height > 1)
+    {
+        RgbaImage next;
+        rgba_image_downsample(levels.back(), next);
+        levels.push_back(next);
+    }
+}
+
+// Formats ------------------------------------------------------------------------------------------
+
+GLenum texture_codec_internal_format(TextureCodec codec)
+{
+    switch (codec)
+    {
+    case TEXTURE_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case TEXTURE_BC4: return GL_COMPRESSED_RED_RGTC1;
+    case TEXTURE_BC5: return GL_COMPRESSED_RG_RGTC2;
+    case TEXTURE_BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+    return 0;
+}
+
+GLenum texture_codec_base_format(TextureCodec codec)
+{
+    switch (codec)
+    {
+    case TEXTURE_BC1: return GL_RGB;
+    case TEXTURE_BC4: return GL_RED;
+    case TEXTURE_BC5: return GL_RG;
+    case TEXTURE_BC7: return GL_RGBA;
+    }
+    return 0;
+}
+
+int texture_codec_block_bytes(TextureCodec codec)
+{
+    return codec == TEXTURE_BC1 || codec == TEXTURE_BC4 ? 8 : 16;
+}
+
+const char * texture_codec_name(TextureCodec codec)
+{
+    static const char * names[] = { "BC1", "BC4", "BC5", "BC7" };
+    return names[codec];
+}
+
+// Block encoders ------------------------------------------------------------------------------------------
+
+// Mean and principal axis of n points of dimension components, by power iteration on the covariance
+static void principal_axis(const float * points, int n, int components, float * mean, float * axis)
+{
+    for (int c = 0; c < components; ++c)
+    {
+        mean[c] = 0.f;
+        for (int i = 0; i < n; ++i)
+            mean[c] += points[i * 4 + c];
+        mean[c] /= float(n);
+    }
+    float covariance[4][4] = {{0}};
+    for (int i = 0; i < n; ++i)
+        for (int a = 0; a < components; ++a)
+            for (int b = 0; b < components; ++b)
+                covariance[a][b] += (points[i * 4 + a] - mean[a]) * (points[i * 4 + b] - mean[b]);
+
+    for (int c = 0; c < components; ++c)
+        axis[c] = 1.f;
+    for (int iteration = 0; iteration < 8; ++iteration)
+    {
+        float next[4] = {0, 0, 0, 0};
+        float length = 0.f;
+        for (int a = 0; a < components; ++a)
+        {
+            for (int b = 0; b < components; ++b)
+                next[a] += covariance[a][b] * axis[b];
+            length += next[a] * next[a];
+        }
+        if (length == 0.f)
+            break;
+        length = std::sqrt(length);
+        for (int c = 0; c < components; ++c)
+            axis[c] = next[c] / length;
+    }
+}
+
+// Extremes of the points projected on the principal axis
+static void axis_endpoints(const float * points, int n, int components, float * e0, float * e1)
+{
+    float mean[4], axis[4];
+    principal_axis(points, n, components, mean, axis);
+    float tMin = 0.f, tMax = 0.f;
+    for (int i = 0; i < n; ++i)
+    {
+        float t = 0.f;
+        for (int c = 0; c < components; ++c)
+            t += (points[i * 4 + c] - mean[c]) * axis[c];
+        tMin = t < tMin ? t : tMin;
+        tMax = t > tMax ? t : tMax;
+    }
+    for (int c = 0; c < components; ++c)
+    {
+        e0[c] = mean[c] + axis[c] * tMax;
+        e1[c] = mean[c] + axis[c] * tMin;
+        e0[c] = e0[c] < 0.f ? 0.f : (e0[c] > 255.f ? 255.f : e0[c]);
+        e1[c] = e1[c] < 0.f ? 0.f : (e1[c] > 255.f ? 255.f : e1[c]);
+    }
+}
+
+static void load_block(const RgbaImage & image, int bx, int by, float * block)
+{
+    for (int y = 0; y < 4; ++y)
+    {
+        int sy = by * 4 + y < image.height ? by * 4 + y : image.height - 1;
+        for (int x = 0; x < 4; ++x)
+        {
+            int sx = bx * 4 + x < image.width ? bx * 4 + x : image.width - 1;
+            const unsigned char * p = &image.pixels[(size_t(sy) * image.width + sx) * 4];
+            for (int c = 0; c < 4; ++c)
+                block[(y * 4 + x) * 4 + c] = p[c];
+        }
+    }
+}
+
+static int nearest_entry(const float * texel, const float palette[][4], int entries, int components)
+{
+    int best = 0;
+    float bestError = 1e30f;
+    for (int e = 0; e < entries; ++e)
+    {
+        float error = 0.f;
+        for (int c = 0; c < components; ++c)
+        {
+            float d = texel[c] - palette[e][c];
+            error += d * d;
+        }
+        if (error < bestError)
+        {
+            bestError = error;
+            best = e;
+        }
+    }
+    return best;
+}
+
+static unsigned short pack_565(const float * c)
+{
+    int r = int(c[0] * 31.f / 255.f + 0.5f);
+    int g = int(c[1] * 63.f / 255.f + 0.5f);
+    int b = int(c[2] * 31.f / 255.f + 0.5f);
+    return (unsigned short)(r << 11 | g << 5 | b);
+}
+
+static void unpack_565(unsigned short v, float * c)
+{
+    int r = v >> 11 & 31, g = v >> 5 & 63, b = v & 31;
+    c[0] = float(r << 3 | r >> 2);
+    c[1] = float(g << 2 | g >> 4);
+    c[2] = float(b << 3 | b >> 2);
+}
+
+static void encode_bc1(const float * block, unsigned char * out)
+{
+    float e0[4], e1[4];
+    axis_endpoints(block, 16, 3, e0, e1);
+    unsigned short c0 = pack_565(e0);
+    unsigned short c1 = pack_565(e1);
+    // Four color mode needs c0 > c1
+    if (c0 < c1)
+    {
+        unsigned short t = c0; c0 = c1; c1 = t;
+    }
+
+    unsigned int indices = 0;
+    if (c0 != c1)
+    {
+        float palette[4][4];
+        unpack_565(c0, palette[0]);
+        unpack_565(c1, palette[1]);
+        for (int c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (2.f * palette[0][c] + palette[1][c]) / 3.f;
+            palette[3][c] = (palette[0][c] + 2.f * palette[1][c]) / 3.f;
+        }
+        for (int i = 0; i < 16; ++i)
+            indices |= unsigned(nearest_entry(block + i * 4, palette, 4, 3)) << (i * 2);
+    }
+
+    out[0] = (unsigned char)(c0 & 0xff);
+    out[1] = (unsigned char)(c0 >> 8);
+    out[2] = (unsigned char)(c1 & 0xff);
+    out[3] = (unsigned char)(c1 >> 8);
+    for (int k = 0; k < 4; ++k)
+        out[4 + k] = (unsigned char)(indices >> (k * 8));
+}
+
+// Eight value mode : r0 > r1, entries r0, r1 then six steps from r0 to r1
+static void encode_bc4(const float * block, int channel, unsigned char * out)
+{
+    float lo = 255.f, hi = 0.f;
+    for (int i = 0; i < 16; ++i)
+    {
+        float v = block[i * 4 + channel];
+        lo = v < lo ? v : lo;
+        hi = v > hi ? v : hi;
+    }
+    int r0 = int(hi + 0.5f);
+    int r1 = int(lo + 0.5f);
+
+    unsigned long long indices = 0;
+    if (r0 == r1)
+    {
+        // All index 0 decodes to r0
+    }
+    else
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            float t = (block[i * 4 + channel] - r1) / float(r0 - r1) * 7.f;
+            int step = int(t + 0.5f);
+            step = step < 0 ? 0 : (step > 7 ? 7 : step);
+            // step 7 is r0 (index 0), step 0 is r1 (index 1), step s in between is index 8 - s
+            int index = step == 7 ? 0 : (step == 0 ? 1 : 8 - step);
+            indices |= (unsigned long long)index << (i * 3);
+        }
+    }
+    out[0] = (unsigned char)r0;
+    out[1] = (unsigned char)r1;
+    for (int k = 0; k < 6; ++k)
+        out[2 + k] = (unsigned char)(indices >> (k * 8));
+}
+
+// Bit writer for the 128 bit bc7 blocks, least significant bit first
+static void write_bits(unsigned char * out, int & position, unsigned int value, int count)
+{
+    for (int i = 0; i < count; ++i, ++position)
+        if (value >> i & 1)
+            out[position >> 3] |= (unsigned char)(1 << (position & 7));
+}
+
+// Mode 6 : one subset, rgba 7 bit endpoints with a shared lsb per endpoint, 4 bit indices
+static void encode_bc7(const float * block, unsigned char * out)
+{
+    static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    float e[2][4];
+    axis_endpoints(block, 16, 4, e[0], e[1]);
+
+    // Quantize each endpoint, the p bit being the lsb the channels agree on most
+    int q[2][4];
+    int p[2];
+    for (int k = 0; k < 2; ++k)
+    {
+        int odd = 0;
+        for (int c = 0; c < 4; ++c)
+            odd += int(e[k][c] + 0.5f) & 1;
+        p[k] = odd >= 2 ? 1 : 0;
+        for (int c = 0; c < 4; ++c)
+        {
+            int v = int((e[k][c] - p[k]) * 0.5f + 0.5f);
+            q[k][c] = v < 0 ? 0 : (v > 127 ? 127 : v);
+        }
+    }
+
+    float palette[16][4];
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            int a = q[0][c] << 1 | p[0];
+            int b = q[1][c] << 1 | p[1];
+            palette[i][c] = float(((64 - weights[i]) * a + weights[i] * b + 32) >> 6);
+        }
+    }
+    int indices[16];
+    for (int i = 0; i < 16; ++i)
+        indices[i] = nearest_entry(block + i * 4, palette, 16, 4);
+
+    // The msb of the first index is implicit 0, swap the endpoints if it is set
+    if (indices[0] >= 8)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            int t = q[0][c]; q[0][c] = q[1][c]; q[1][c] = t;
+        }
+        int t = p[0]; p[0] = p[1]; p[1] = t;
+        for (int i = 0; i < 16; ++i)
+            indices[i] = 15 - indices[i];
+    }
+
+    memset(out, 0, 16);
+    int position = 0;
+    write_bits(out, position, 1 << 6, 7);
+    for (int c = 0; c < 4; ++c)
+    {
+        write_bits(out, position, q[0][c], 7);
+        write_bits(out, position, q[1][c], 7);
+    }
+    write_bits(out, position, p[0], 1);
+    write_bits(out, position, p[1], 1);
+    write_bits(out, position, indices[0], 3);
+    for (int i = 1; i < 16; ++i)
+        write_bits(out, position, indices[i], 4);
+}
+
+void texture_compress(const RgbaImage & image, TextureCodec codec, std::vector<unsigned char> & blocks)
+{
+    int blocksX = (image.width + 3) / 4;
+    int blocksY = (image.height + 3) / 4;
+    int blockBytes = texture_codec_block_bytes(codec);
+    blocks.assign(size_t(blocksX) * blocksY * blockBytes, 0);
+
+    float block[16 * 4];
+    for (int by = 0; by < blocksY; ++by)
+    {
+        for (int bx = 0; bx < blocksX; ++bx)
+        {
+            load_block(image, bx, by, block);
+            unsigned char * out = &blocks[(size_t(by) * blocksX + bx) * blockBytes];
+            switch (codec)
+            {
+            case TEXTURE_BC1:
+                encode_bc1(block, out);
+                break;
+            case TEXTURE_BC4:
+                encode_bc4(block, 0, out);
+                break;
+            case TEXTURE_BC5:
+                encode_bc4(block, 0, out);
+                encode_bc4(block, 1, out + 8);
+                break;
+            case TEXTURE_BC7:
+                encode_bc7(block, out);
+                break;
+            }
+        }
+    }
+}
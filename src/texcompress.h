@@ -0,0 +1,38 @@
+#ifndef AOGL_TEXCOMPRESS_H
+#define AOGL_TEXCOMPRESS_H
+
+#include <vector>
+
+#include "glew/glew.h"
+
+// Block compressed formats written by texcook, each picked for a usage
+enum TextureCodec
+{
+    TEXTURE_BC1, // rgb color, 4 bits per texel
+    TEXTURE_BC4, // single channel from red, masks and specular, 4 bits per texel
+    TEXTURE_BC5, // two channels from red and green, normals, 8 bits per texel
+    TEXTURE_BC7 // rgba color, mode 6 only, 8 bits per texel
+};
+
+struct RgbaImage
+{
+    int width;
+    int height;
+    std::vector<unsigned char> pixels; // 4 bytes per texel, rows packed
+};
+
+// Expand 1 to 4 channel pixels to rgba, missing channels are 0 and alpha 255
+void rgba_image_from_pixels(RgbaImage & image, const unsigned char * pixels, int width, int height, int components);
+// Half size box filter, odd sizes repeat their last row or column (SSE2 when available)
+void rgba_image_downsample(const RgbaImage & source, RgbaImage & destination);
+// base followed by every level down to 1x1
+void rgba_image_mip_chain(const RgbaImage & base, std::vector<RgbaImage> & levels);
+
+GLenum texture_codec_internal_format(TextureCodec codec);
+GLenum texture_codec_base_format(TextureCodec codec);
+int texture_codec_block_bytes(TextureCodec codec);
+const char * texture_codec_name(TextureCodec codec);
+// Encode every 4x4 block of image, edge blocks repeat the last row or column
+void texture_compress(const RgbaImage & image, TextureCodec codec, std::vector<unsigned char> & blocks);
+
+#endif // AOGL_TEXCOMPRESS_H
@@ -0,0 +1,102 @@
+#include "texturearray.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+TextureArraySlot texture_array_set_add(TextureArraySet & set, const char * path)
+{
+    TextureArraySlot slot = { -1, -1 };
+    KtxView * view = new KtxView();
+    if (!ktx_map(*view, path))
+    {
+        fprintf(stderr, "Texture %s : can not add it to an array, cook it with texcook\n", path);
+        delete view;
+        return slot;
+    }
+
+    const KtxHeader & header = *view->header;
+    for (size_t i = 0; i < set.arrays.size(); ++i)
+    {
+        TextureArray & array = set.arrays[i];
+        if (array.internalFormat == header.glInternalFormat && array.width == int(header.pixelWidth)
+            && array.height == int(header.pixelHeight) && array.levels == int(view->levelCount))
+        {
+            slot.array = int(i);
+            break;
+        }
+    }
+    if (slot.array < 0)
+    {
+        TextureArray array;
+        array.texture = 0;
+        array.handle = 0;
+        array.internalFormat = header.glInternalFormat;
+        array.width = header.pixelWidth;
+        array.height = header.pixelHeight;
+        array.levels = view->levelCount;
+        set.arrays.push_back(array);
+        slot.array = int(set.arrays.size() - 1);
+    }
+    TextureArray & array = set.arrays[slot.array];
+    slot.layer = int(array.layers.size());
+    array.layers.push_back(view);
+    return slot;
+}
+
+void texture_array_set_build(TextureArraySet & set, bool bindless)
+{
+    for (size_t i = 0; i < set.arrays.size(); ++i)
+    {
+        TextureArray & array = set.arrays[i];
+        int layerCount = int(array.layers.size());
+        glGenTextures(1, &array.texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, array.levels, array.internalFormat, array.width, array.height, layerCount);
+        for (int layer = 0; layer < layerCount; ++layer)
+        {
+            KtxView & view = *array.layers[layer];
+            for (int level = 0; level < array.levels; ++level)
+            {
+                int width = std::max(array.width >> level, 1);
+                int height = std::max(array.height >> level, 1);
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, array.internalFormat,
+                                          view.levelSizes[level], view.levels[level]);
+            }
+            ktx_unmap(view);
+            delete &view;
+        }
+        array.layers.clear();
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        // The handle freezes the texture state, it can not change afterwards
+        if (bindless)
+        {
+            array.handle = glGetTextureHandleARB(array.texture);
+            glMakeTextureHandleResidentARB(array.handle);
+        }
+        fprintf(stdout, "Texture array %d : %dx%d, %d levels, %d layers%s\n",
+                int(i), array.width, array.height, array.levels, layerCount, bindless ? ", bindless" : "");
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void texture_array_set_release(TextureArraySet & set)
+{
+    for (size_t i = 0; i < set.arrays.size(); ++i)
+    {
+        TextureArray & array = set.arrays[i];
+        if (array.handle)
+            glMakeTextureHandleNonResidentARB(array.handle);
+        if (array.texture)
+            glDeleteTextures(1, &array.texture);
+        for (size_t j = 0; j < array.layers.size(); ++j)
+        {
+            ktx_unmap(*array.layers[j]);
+            delete array.layers[j];
+        }
+    }
+    set.arrays.clear();
+}
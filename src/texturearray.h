@@ -0,0 +1,51 @@
+#ifndef AOGL_TEXTUREARRAY_H
+#define AOGL_TEXTUREARRAY_H
+
+#include <vector>
+
+#include "glew/glew.h"
+
+#include "ktx.h"
+
+// Units the material arrays stay bound to, no other pass uses them
+enum MaterialArrayUnit
+{
+    MATERIAL_DIFFUSE_ARRAY_UNIT = 11,
+    MATERIAL_SPECULAR_ARRAY_UNIT = 12
+};
+
+// Cooked textures of the same format, size and level count as the layers of one array
+struct TextureArray
+{
+    GLuint texture;
+    GLuint64 handle; // resident bindless handle, 0 without GL_ARB_bindless_texture
+    GLenum internalFormat;
+    int width;
+    int height;
+    int levels;
+    std::vector<KtxView *> layers; // mapped until texture_array_set_build
+};
+
+// Where a texture landed in a TextureArraySet, array is -1 if it could not be added
+struct TextureArraySlot
+{
+    int array;
+    int layer;
+};
+
+// Groups textures by format into arrays, so materials select theirs with a layer index
+// instead of a bind. Without bindless handles a shader can only see the arrays bound to
+// units, so callers keep one array per set; with them any number of arrays is reachable
+// through the handles stored in the materials.
+struct TextureArraySet
+{
+    std::vector<TextureArray> arrays;
+};
+
+// Map the cooked texture at path and append it to the first array it matches
+TextureArraySlot texture_array_set_add(TextureArraySet & set, const char * path);
+// Create and fill the arrays, unmap the files and make the handles resident if bindless is true
+void texture_array_set_build(TextureArraySet & set, bool bindless);
+void texture_array_set_release(TextureArraySet & set);
+
+#endif // AOGL_TEXTUREARRAY_H
@@ -0,0 +1,308 @@
+#include "textureloader.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "stb/stb_image.h"
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Queue the upload of a decoded or mapped request, called with the loader mutex held
+static void texture_upload_start(TextureRequest & request)
+{
+    static const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    static const GLenum internalFormats[] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+
+    UploadJob & job = request.upload;
+    if (request.compressed)
+    {
+        job.type = UPLOAD_KTX;
+        job.ktx = &request.ktx;
+    }
+    else if (request.pixels)
+    {
+        job.type = UPLOAD_TEXTURE_2D;
+        job.data = request.pixels;
+        job.width = request.width;
+        job.height = request.height;
+        job.format = formats[request.components - 1];
+        job.internalFormat = internalFormats[request.components - 1];
+    }
+    else
+    {
+        // Failed, reported by texture_loader_poll
+        return;
+    }
+    request.uploading = true;
+    uploader_push(*request.loader->uploader, job);
+}
+
+// Called with the loader mutex held
+static void texture_decode_done(TextureRequest & request)
+{
+    request.decoded = true;
+    if (request.loader->uploader)
+        texture_upload_start(request);
+    request.loader->decodedSignal.notify_all();
+}
+
+// stb_image keeps its failure reason per thread, read it on the worker that failed
+static void texture_decode_job(void * user)
+{
+    TextureRequest & request = *(TextureRequest *)user;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int comp;
+    request.pixels = stbi_load_from_memory(&request.file[0], int(request.file.size()),
+                                           &request.width, &request.height, &comp, request.components);
+    request.decodeTime = elapsed_ms(start);
+    if (!request.pixels)
+        request.failure = stbi_failure_reason();
+    std::vector<unsigned char>().swap(request.file);
+
+    std::lock_guard<std::mutex> lock(request.loader->mutex);
+    texture_decode_done(request);
+}
+
+// Pool task, the read blocks so it stays off the job workers
+static void texture_read_task(void * user)
+{
+    TextureRequest & request = *(TextureRequest *)user;
+    FILE * f = fopen(request.path, "rb");
+    long size = -1;
+    if (f)
+    {
+        fseek(f, 0, SEEK_END);
+        size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        if (size > 0)
+        {
+            request.file.resize(size);
+            if (fread(&request.file[0], 1, request.file.size(), f) != request.file.size())
+                size = -1;
+        }
+        fclose(f);
+    }
+    if (size > 0)
+    {
+        job_system_run(*request.loader->jobs, "texture decode", texture_decode_job, &request, &request.loader->decodes);
+        return;
+    }
+
+    request.failure = f ? "can not read file" : "can not open file";
+    std::vector<unsigned char>().swap(request.file);
+    std::lock_guard<std::mutex> lock(request.loader->mutex);
+    texture_decode_done(request);
+}
+
+// Levels come precomputed and already in the gpu format, no conversion nor mip generation
+static void ktx_upload(TextureRequest & request)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const KtxHeader & header = *request.ktx.header;
+    size_t size = 0;
+    glGenTextures(1, &request.texture);
+    glBindTexture(GL_TEXTURE_2D, request.texture);
+    for (unsigned int level = 0; level < request.ktx.levelCount; ++level)
+    {
+        int width = std::max(int(header.pixelWidth >> level), 1);
+        int height = std::max(int(header.pixelHeight >> level), 1);
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, header.glInternalFormat, width, height, 0,
+                               request.ktx.levelSizes[level], request.ktx.levels[level]);
+        size += request.ktx.levelSizes[level];
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, request.ktx.levelCount - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glFinish();
+    double uploadTime = elapsed_ms(start);
+
+    fprintf(stdout, "Texture %s : %dx%d cooked, %u levels, %zu bytes uploaded in %.2f ms\n",
+            request.path, request.width, request.height, request.ktx.levelCount, size, uploadTime);
+    ktx_unmap(request.ktx);
+    request.compressed = false;
+}
+
+void texture_loader_init(TextureLoader & loader, ThreadPool & pool, JobSystem & jobs)
+{
+    loader.pool = &pool;
+    loader.jobs = &jobs;
+    job_counter_init(loader.decodes);
+    loader.uploader = 0;
+}
+
+void texture_loader_release(TextureLoader & loader)
+{
+    // Let pending reads, decodes and uploads finish before their requests go away, the
+    // reads queue the decodes
+    thread_pool_wait(*loader.pool);
+    job_system_wait(*loader.jobs, loader.decodes);
+    if (loader.uploader)
+    {
+        uploader_wait(*loader.uploader);
+        while (texture_loader_poll(loader) > 0)
+            std::this_thread::yield();
+    }
+    for (size_t i = 0; i < loader.requests.size(); ++i)
+    {
+        TextureRequest * request = loader.requests[i];
+        if (request->texture)
+            glDeleteTextures(1, &request->texture);
+        stbi_image_free(request->pixels);
+        if (request->compressed)
+            ktx_unmap(request->ktx);
+        delete request;
+    }
+    loader.requests.clear();
+}
+
+int texture_loader_request(TextureLoader & loader, const char * path, int components)
+{
+    TextureRequest * request = new TextureRequest();
+    request->loader = &loader;
+    request->path = path;
+    request->components = components;
+    loader.requests.push_back(request);
+
+    // Prefer the cooked texture, mapping it is cheap enough for the main thread
+    std::string ktxPath(path);
+    const char * extension = strrchr(path, '.');
+    ktxPath.replace(extension ? extension - path : ktxPath.size(), std::string::npos, ".ktx");
+    if (ktx_map(request->ktx, ktxPath.c_str()))
+    {
+        request->compressed = true;
+        request->decoded = true;
+        request->width = request->ktx.header->pixelWidth;
+        request->height = request->ktx.header->pixelHeight;
+        return int(loader.requests.size() - 1);
+    }
+    thread_pool_push(*loader.pool, texture_read_task, request);
+    return int(loader.requests.size() - 1);
+}
+
+void texture_loader_upload(TextureLoader & loader)
+{
+    static const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    static const GLenum internalFormats[] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+
+    std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+    double waitTime = 0.;
+    for (size_t i = 0; i < loader.requests.size(); ++i)
+    {
+        TextureRequest & request = *loader.requests[i];
+        if (request.texture)
+            continue;
+
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            std::unique_lock<std::mutex> lock(loader.mutex);
+            while (!request.decoded)
+                loader.decodedSignal.wait(lock);
+            waitTime += elapsed_ms(start);
+        }
+
+        request.finished = true;
+        if (request.compressed)
+        {
+            ktx_upload(request);
+            continue;
+        }
+        if (!request.pixels)
+        {
+            fprintf(stderr, "Texture %s : %s\n", request.path, request.failure ? request.failure : "decode failed");
+            continue;
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        glGenTextures(1, &request.texture);
+        glBindTexture(GL_TEXTURE_2D, request.texture);
+        // Rows of 1 and 3 channel images are not 4 byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormats[request.components - 1], request.width, request.height, 0,
+                     formats[request.components - 1], GL_UNSIGNED_BYTE, request.pixels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        // glFinish so the time covers the transfer and the mip generation
+        glFinish();
+        double uploadTime = elapsed_ms(start);
+
+        stbi_image_free(request.pixels);
+        request.pixels = 0;
+        fprintf(stdout, "Texture %s : %dx%d, decoded in %.2f ms on a worker, uploaded in %.2f ms\n",
+                request.path, request.width, request.height, request.decodeTime, uploadTime);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    fprintf(stdout, "Textures : main thread waited %.2f ms on decodes, %.2f ms in total\n", waitTime, elapsed_ms(waitStart));
+}
+
+void texture_loader_attach(TextureLoader & loader, Uploader & uploader)
+{
+    std::lock_guard<std::mutex> lock(loader.mutex);
+    loader.uploader = &uploader;
+    for (size_t i = 0; i < loader.requests.size(); ++i)
+    {
+        TextureRequest & request = *loader.requests[i];
+        if (request.decoded && !request.uploading && !request.finished)
+            texture_upload_start(request);
+    }
+}
+
+int texture_loader_poll(TextureLoader & loader)
+{
+    uploader_poll(*loader.uploader);
+    int pending = 0;
+    std::lock_guard<std::mutex> lock(loader.mutex);
+    for (size_t i = 0; i < loader.requests.size(); ++i)
+    {
+        TextureRequest & request = *loader.requests[i];
+        if (request.finished)
+            continue;
+        if (request.decoded && !request.uploading)
+        {
+            fprintf(stderr, "Texture %s : %s\n", request.path, request.failure ? request.failure : "decode failed");
+            request.finished = true;
+            continue;
+        }
+        if (!request.uploading || !request.upload.ready)
+        {
+            ++pending;
+            continue;
+        }
+
+        request.texture = request.upload.object;
+        request.uploading = false;
+        request.finished = true;
+        if (request.compressed)
+        {
+            fprintf(stdout, "Texture %s : %dx%d cooked, %u levels uploaded in %.2f ms on the upload thread\n",
+                    request.path, request.width, request.height, request.ktx.levelCount, request.upload.uploadTime);
+            ktx_unmap(request.ktx);
+            request.compressed = false;
+        }
+        else
+        {
+            fprintf(stdout, "Texture %s : %dx%d, decoded in %.2f ms on a worker, uploaded in %.2f ms on the upload thread\n",
+                    request.path, request.width, request.height, request.decodeTime, request.upload.uploadTime);
+            stbi_image_free(request.pixels);
+            request.pixels = 0;
+        }
+    }
+    return pending;
+}
+
+GLuint texture_loader_texture(const TextureLoader & loader, int request)
+{
+    return loader.requests[request]->texture;
+}
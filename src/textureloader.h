@@ -0,0 +1,68 @@
+#ifndef AOGL_TEXTURELOADER_H
+#define AOGL_TEXTURELOADER_H
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+#include "glew/glew.h"
+
+#include "jobsystem.h"
+#include "threadpool.h"
+#include "ktx.h"
+#include "uploader.h"
+
+struct TextureLoader;
+
+struct TextureRequest
+{
+    TextureLoader * loader;
+    const char * path;
+    int components; // forced channel count, 1 to 4
+    std::vector<unsigned char> file; // read on the pool, freed once decoded
+    unsigned char * pixels; // freed after upload
+    int width;
+    int height;
+    bool decoded;
+    const char * failure;
+    double decodeTime; // ms, on the worker
+    bool compressed; // a cooked sibling .ktx was mapped instead of decoding path
+    KtxView ktx; // unmapped after upload
+    UploadJob upload;
+    bool uploading; // upload is queued on the loader uploader
+    bool finished; // texture created or failure reported
+    GLuint texture;
+};
+
+// Images are read on the thread pool as soon as they are requested and decoded from
+// memory by stb_image in jobs, the GL textures are created on the main thread by
+// texture_loader_upload. When texcook left a .ktx next to the image, its compressed
+// levels are mapped and uploaded as is. Once an uploader is attached, decoded images
+// go to its thread as soon as they are ready and texture_loader_poll picks the
+// finished textures up every frame instead.
+struct TextureLoader
+{
+    ThreadPool * pool;
+    JobSystem * jobs;
+    JobCounter decodes;
+    Uploader * uploader;
+    std::vector<TextureRequest *> requests;
+    std::mutex mutex;
+    std::condition_variable decodedSignal;
+};
+
+void texture_loader_init(TextureLoader & loader, ThreadPool & pool, JobSystem & jobs);
+// Delete the textures
+void texture_loader_release(TextureLoader & loader);
+// Map the .ktx cooked from path or queue the read and decode of path, returns the request index
+int texture_loader_request(TextureLoader & loader, const char * path, int components);
+// Upload every request in order as its decode completes, with repeat wrapping and
+// generated or cooked mipmaps, and log the decode and upload time of each. Failed requests get texture 0.
+void texture_loader_upload(TextureLoader & loader);
+// Hand every request, now and to come, to the upload thread of uploader
+void texture_loader_attach(TextureLoader & loader, Uploader & uploader);
+// Take the textures the uploader finished, returns the number of requests still pending
+int texture_loader_poll(TextureLoader & loader);
+GLuint texture_loader_texture(const TextureLoader & loader, int request);
+
+#endif // AOGL_TEXTURELOADER_H
@@ -0,0 +1,214 @@
+#include "texturestream.h"
+
+#include <stdio.h>
+#include <cmath>
+#include <algorithm>
+
+static int level_width(const StreamedTexture & t, int level)
+{
+    return std::max(int(t.ktx.header->pixelWidth >> level), 1);
+}
+
+static int level_height(const StreamedTexture & t, int level)
+{
+    return std::max(int(t.ktx.header->pixelHeight >> level), 1);
+}
+
+static void upload_level(StreamedTexture & t, int level)
+{
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, t.ktx.header->glInternalFormat, level_width(t, level), level_height(t, level), 0,
+                           t.ktx.levelSizes[level], t.ktx.levels[level]);
+    t.residentBytes += t.ktx.levelSizes[level];
+}
+
+// Replace the texture object by one holding levels first to the last. Mutable storage so
+// finer levels can be added in place later, levels can only be dropped by starting over.
+static void texture_create(StreamedTexture & t, int first)
+{
+    if (t.texture)
+        glDeleteTextures(1, &t.texture);
+    t.residentBytes = 0;
+    glGenTextures(1, &t.texture);
+    glBindTexture(GL_TEXTURE_2D, t.texture);
+    for (int level = first; level < int(t.ktx.levelCount); ++level)
+        upload_level(t, level);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, first);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, t.ktx.levelCount - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    t.residentLevel = first;
+}
+
+// Read one byte per page so the upload on the main thread does not wait on the disk
+static void texture_prefetch_task(void * user)
+{
+    StreamedTexture & t = *(StreamedTexture *)user;
+    int level;
+    {
+        std::lock_guard<std::mutex> lock(t.stream->mutex);
+        level = t.prefetchLevel;
+    }
+    const volatile unsigned char * data = t.ktx.levels[level];
+    unsigned char sink = 0;
+    for (unsigned int i = 0; i < t.ktx.levelSizes[level]; i += 4096)
+        sink ^= data[i];
+    (void)sink;
+
+    std::lock_guard<std::mutex> lock(t.stream->mutex);
+    t.prefetchedLevel = level;
+    t.prefetchLevel = -1;
+}
+
+// Drop the finest level of the least recently used texture holding more than it needs
+static bool texture_stream_evict(TextureStream & stream, const StreamedTexture * except)
+{
+    StreamedTexture * victim = 0;
+    for (size_t i = 0; i < stream.textures.size(); ++i)
+    {
+        StreamedTexture * t = stream.textures[i];
+        if (t == except || t->residentLevel >= t->tailLevel || t->residentLevel >= t->wantedLevel)
+            continue;
+        if (!victim || t->lastUsed < victim->lastUsed
+            || (t->lastUsed == victim->lastUsed && t->residentBytes > victim->residentBytes))
+            victim = t;
+    }
+    if (!victim)
+        return false;
+
+    stream.residentBytes -= victim->residentBytes;
+    texture_create(*victim, victim->residentLevel + 1);
+    stream.residentBytes += victim->residentBytes;
+    ++stream.evictions;
+    return true;
+}
+
+void texture_stream_init(TextureStream & stream, ThreadPool & pool, size_t budget)
+{
+    stream.pool = &pool;
+    stream.budget = budget;
+    stream.residentBytes = 0;
+    stream.frame = 0;
+    stream.uploads = 0;
+    stream.evictions = 0;
+}
+
+void texture_stream_release(TextureStream & stream)
+{
+    // Let pending prefetches finish before their mappings go away
+    thread_pool_wait(*stream.pool);
+    for (size_t i = 0; i < stream.textures.size(); ++i)
+    {
+        StreamedTexture * t = stream.textures[i];
+        glDeleteTextures(1, &t->texture);
+        ktx_unmap(t->ktx);
+        delete t;
+    }
+    stream.textures.clear();
+    stream.residentBytes = 0;
+}
+
+int texture_stream_add(TextureStream & stream, const char * path)
+{
+    StreamedTexture * t = new StreamedTexture();
+    if (!ktx_map(t->ktx, path))
+    {
+        fprintf(stderr, "Texture %s : can not stream it, cook it with texcook\n", path);
+        delete t;
+        return -1;
+    }
+    t->stream = &stream;
+    t->path = path;
+    t->tailLevel = int(t->ktx.levelCount) - 1;
+    while (t->tailLevel > 0 && std::max(level_width(*t, t->tailLevel - 1), level_height(*t, t->tailLevel - 1)) <= TEXTURE_STREAM_TAIL_SIZE)
+        --t->tailLevel;
+    t->wantedLevel = t->tailLevel;
+    t->prefetchLevel = -1;
+    t->prefetchedLevel = -1;
+    t->lastUsed = stream.frame;
+    texture_create(*t, t->tailLevel);
+    stream.residentBytes += t->residentBytes;
+    stream.textures.push_back(t);
+    return int(stream.textures.size() - 1);
+}
+
+int texture_stream_level_for(const TextureStream & stream, int texture, float uvDensity, float distance, float pixelsPerRadian)
+{
+    const StreamedTexture & t = *stream.textures[texture];
+    // Texels covered by one pixel, the level whose texels are about one pixel wide is sampled
+    float texelsPerWorld = uvDensity * float(std::max(t.ktx.header->pixelWidth, t.ktx.header->pixelHeight));
+    float worldPerPixel = std::max(distance, 1e-3f) / pixelsPerRadian;
+    float texelsPerPixel = texelsPerWorld * worldPerPixel;
+    if (texelsPerPixel <= 1.f)
+        return 0;
+    return std::min(int(std::log2(texelsPerPixel)), int(t.ktx.levelCount) - 1);
+}
+
+void texture_stream_use(TextureStream & stream, int texture, int level)
+{
+    StreamedTexture & t = *stream.textures[texture];
+    t.wantedLevel = std::min(t.wantedLevel, level);
+    t.lastUsed = stream.frame;
+}
+
+void texture_stream_update(TextureStream & stream)
+{
+    for (size_t i = 0; i < stream.textures.size(); ++i)
+    {
+        StreamedTexture & t = *stream.textures[i];
+        if (t.wantedLevel >= t.residentLevel)
+            continue;
+
+        int level = t.residentLevel - 1;
+        bool prefetched;
+        {
+            std::lock_guard<std::mutex> lock(stream.mutex);
+            prefetched = t.prefetchedLevel == level;
+            if (!prefetched && t.prefetchLevel < 0)
+            {
+                t.prefetchLevel = level;
+                thread_pool_push(*stream.pool, texture_prefetch_task, &t);
+            }
+        }
+        if (!prefetched)
+            continue;
+
+        size_t bytes = t.ktx.levelSizes[level];
+        while (stream.residentBytes + bytes > stream.budget && texture_stream_evict(stream, &t))
+            ;
+        if (stream.residentBytes + bytes > stream.budget)
+            continue;
+
+        size_t before = t.residentBytes;
+        glBindTexture(GL_TEXTURE_2D, t.texture);
+        upload_level(t, level);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        t.residentLevel = level;
+        stream.residentBytes += t.residentBytes - before;
+        ++stream.uploads;
+    }
+
+    // Start the next frame, textures not used anymore only need their tail
+    for (size_t i = 0; i < stream.textures.size(); ++i)
+        stream.textures[i]->wantedLevel = stream.textures[i]->tailLevel;
+    ++stream.frame;
+}
+
+GLuint texture_stream_texture(const TextureStream & stream, int texture)
+{
+    return stream.textures[texture]->texture;
+}
+
+TextureStreamStats texture_stream_stats(TextureStream & stream)
+{
+    TextureStreamStats stats;
+    stats.residentBytes = stream.residentBytes;
+    stats.uploads = stream.uploads;
+    stats.evictions = stream.evictions;
+    stream.uploads = 0;
+    stream.evictions = 0;
+    return stats;
+}
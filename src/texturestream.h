@@ -0,0 +1,72 @@
+#ifndef AOGL_TEXTURESTREAM_H
+#define AOGL_TEXTURESTREAM_H
+
+#include <vector>
+#include <mutex>
+
+#include "glew/glew.h"
+
+#include "threadpool.h"
+#include "ktx.h"
+
+// Levels of at most this size are uploaded when a texture is added and never evicted
+const int TEXTURE_STREAM_TAIL_SIZE = 64;
+
+struct TextureStream;
+
+struct StreamedTexture
+{
+    TextureStream * stream;
+    const char * path;
+    KtxView ktx; // mapped for the whole life of the texture, levels are uploaded from it
+    GLuint texture; // levels residentLevel to the last, GL_TEXTURE_BASE_LEVEL is residentLevel
+    int tailLevel; // finest level of the always resident tail
+    int residentLevel;
+    int wantedLevel; // finest level asked by texture_stream_use this frame
+    int prefetchLevel; // level whose pages a worker is reading, -1 when idle
+    int prefetchedLevel; // level whose pages are in memory, -1 if none
+    unsigned int lastUsed; // frame of the last texture_stream_use
+    size_t residentBytes;
+};
+
+struct TextureStreamStats
+{
+    size_t residentBytes;
+    int uploads; // levels streamed in since the last texture_stream_stats
+    int evictions; // levels evicted since the last texture_stream_stats
+};
+
+// Mip streaming of cooked textures within a fixed budget. Each texture starts with only its
+// coarse tail resident. Every frame the renderer tells which level each texture needs, the
+// missing levels are paged in from the mapped .ktx on the pool, then uploaded one level per
+// texture per frame. When a level does not fit in the budget, the finest levels of the least
+// recently used textures that have more than they need are evicted.
+struct TextureStream
+{
+    ThreadPool * pool;
+    std::vector<StreamedTexture *> textures;
+    size_t budget;
+    size_t residentBytes;
+    unsigned int frame;
+    int uploads;
+    int evictions;
+    std::mutex mutex;
+};
+
+void texture_stream_init(TextureStream & stream, ThreadPool & pool, size_t budget);
+// Delete the textures and unmap their files
+void texture_stream_release(TextureStream & stream);
+// Map a cooked .ktx and upload its tail, returns the texture index or -1 if path can not be mapped
+int texture_stream_add(TextureStream & stream, const char * path);
+// Finest level worth sampling for a surface with uvDensity uv units per world unit seen from
+// distance, with pixelsPerRadian the vertical viewport size over the vertical field of view
+int texture_stream_level_for(const TextureStream & stream, int texture, float uvDensity, float distance, float pixelsPerRadian);
+// Ask for level of texture this frame, the finest level asked wins
+void texture_stream_use(TextureStream & stream, int texture, int level);
+// Prefetch, upload and evict according to this frame's uses, then start a new frame
+void texture_stream_update(TextureStream & stream);
+// Texture object to bind, it changes when levels are evicted
+GLuint texture_stream_texture(const TextureStream & stream, int texture);
+TextureStreamStats texture_stream_stats(TextureStream & stream);
+
+#endif // AOGL_TEXTURESTREAM_H
@@ -0,0 +1,66 @@
+#include "threadpool.h"
+
+static void thread_pool_worker(ThreadPool * pool)
+{
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    for (;;)
+    {
+        while (pool->tasks.empty() && !pool->stop)
+            pool->taskAdded.wait(lock);
+        if (pool->tasks.empty())
+            return;
+
+        ThreadTask task = pool->tasks.front();
+        pool->tasks.pop_front();
+        ++pool->running;
+        lock.unlock();
+        task.function(task.user);
+        lock.lock();
+        --pool->running;
+        if (pool->tasks.empty() && pool->running == 0)
+            pool->taskDone.notify_all();
+    }
+}
+
+void thread_pool_init(ThreadPool & pool, int threadCount)
+{
+    if (threadCount <= 0)
+    {
+        threadCount = int(std::thread::hardware_concurrency()) - 1;
+        if (threadCount < 1)
+            threadCount = 1;
+    }
+    pool.running = 0;
+    pool.stop = false;
+    for (int i = 0; i < threadCount; ++i)
+        pool.threads.push_back(std::thread(thread_pool_worker, &pool));
+}
+
+void thread_pool_release(ThreadPool & pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.stop = true;
+    }
+    pool.taskAdded.notify_all();
+    for (size_t i = 0; i < pool.threads.size(); ++i)
+        pool.threads[i].join();
+    pool.threads.clear();
+}
+
+void thread_pool_push(ThreadPool & pool, ThreadTaskFunction function, void * user)
+{
+    ThreadTask task = {function, user};
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.tasks.push_back(task);
+    }
+    pool.taskAdded.notify_one();
+}
+
+void thread_pool_wait(ThreadPool & pool)
+{
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    while (!pool.tasks.empty() || pool.running > 0)
+        pool.taskDone.wait(lock);
+}
@@ -0,0 +1,39 @@
+#ifndef AOGL_THREADPOOL_H
+#define AOGL_THREADPOOL_H
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+typedef void (*ThreadTaskFunction)(void * user);
+
+struct ThreadTask
+{
+    ThreadTaskFunction function;
+    void * user;
+};
+
+// Fixed set of worker threads running tasks in push order. Tasks must not touch GL,
+// no context is current on them, only on the main and upload threads.
+struct ThreadPool
+{
+    std::vector<std::thread> threads;
+    std::deque<ThreadTask> tasks;
+    std::mutex mutex;
+    std::condition_variable taskAdded;
+    std::condition_variable taskDone;
+    int running;
+    bool stop;
+};
+
+// threadCount 0 uses one thread per core minus the main thread
+void thread_pool_init(ThreadPool & pool, int threadCount);
+// Finish the queued tasks and join the workers
+void thread_pool_release(ThreadPool & pool);
+void thread_pool_push(ThreadPool & pool, ThreadTaskFunction function, void * user);
+// Block until every task pushed so far has run
+void thread_pool_wait(ThreadPool & pool);
+
+#endif // AOGL_THREADPOOL_H
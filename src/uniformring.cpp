@@ -0,0 +1,56 @@
+#include "uniformring.h"
+
+#include <string.h>
+
+void uniform_ring_init(UniformRing & ring, size_t size)
+{
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    ring.size = size;
+    ring.stride = (size + alignment - 1) / alignment * alignment;
+    ring.slot = UNIFORM_RING_SLOT_COUNT - 1;
+    for (int i = 0; i < UNIFORM_RING_SLOT_COUNT; ++i)
+        ring.fences[i] = 0;
+    glGenBuffers(1, &ring.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ring.buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, ring.stride * UNIFORM_RING_SLOT_COUNT, 0, GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void uniform_ring_release(UniformRing & ring)
+{
+    for (int i = 0; i < UNIFORM_RING_SLOT_COUNT; ++i)
+        if (ring.fences[i])
+            glDeleteSync(ring.fences[i]);
+    glDeleteBuffers(1, &ring.buffer);
+    ring.buffer = 0;
+}
+
+GLintptr uniform_ring_push(UniformRing & ring, const void * data)
+{
+    int slot = (ring.slot + 1) % UNIFORM_RING_SLOT_COUNT;
+    ring.slot = slot;
+    if (ring.fences[slot])
+    {
+        while (glClientWaitSync(ring.fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+            ;
+        glDeleteSync(ring.fences[slot]);
+        ring.fences[slot] = 0;
+    }
+
+    // The slot fence already guarantees the GL is done with this range
+    GLintptr offset = GLintptr(slot * ring.stride);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ring.buffer);
+    void * p = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, ring.size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    memcpy(p, data, ring.size);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return offset;
+}
+
+void uniform_ring_fence(UniformRing & ring)
+{
+    if (ring.fences[ring.slot])
+        glDeleteSync(ring.fences[ring.slot]);
+    ring.fences[ring.slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,31 @@
+#ifndef AOGL_UNIFORMRING_H
+#define AOGL_UNIFORMRING_H
+
+#include <stddef.h>
+
+#include "glew/glew.h"
+
+// Frames the GL may still be reading when the CPU writes the next one
+const int UNIFORM_RING_SLOT_COUNT = 3;
+
+// Uniform buffer split in one slot per frame in flight, each slot guarded by a fence.
+// A frame writes the next slot unsynchronized once the GL is done with it, so the
+// upload never waits on the draws of the previous frame still reading their slot.
+struct UniformRing
+{
+    GLuint buffer;
+    size_t size;   // bytes written each frame
+    size_t stride; // size rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    GLsync fences[UNIFORM_RING_SLOT_COUNT];
+    int slot;      // written by the last push
+};
+
+void uniform_ring_init(UniformRing & ring, size_t size);
+void uniform_ring_release(UniformRing & ring);
+// Copy size bytes of data into the next slot and return its offset, to bind with
+// glBindBufferRange. Uses GL_COPY_WRITE_BUFFER, the uniform buffer binding is left alone.
+GLintptr uniform_ring_push(UniformRing & ring, const void * data);
+// After the last draw reading the slot of the last push
+void uniform_ring_fence(UniformRing & ring);
+
+#endif // AOGL_UNIFORMRING_H
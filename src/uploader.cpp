@@ -0,0 +1,266 @@
+#include "uploader.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+
+#include "GLFW/glfw3.h"
+
+static const GLbitfield UPLOADER_PERSISTENT_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Wait until the GL consumed the next slot, returns its index
+static int slot_acquire(Uploader & uploader)
+{
+    int slot = uploader.slot;
+    uploader.slot = (slot + 1) % UPLOADER_SLOT_COUNT;
+    if (uploader.slotFences[slot])
+    {
+        while (glClientWaitSync(uploader.slotFences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+            ;
+        glDeleteSync(uploader.slotFences[slot]);
+        uploader.slotFences[slot] = 0;
+    }
+    return slot;
+}
+
+// Copy into slot, leaves the ring bound to target
+static void slot_write(Uploader & uploader, int slot, GLenum target, const void * data, size_t size)
+{
+    GLintptr offset = GLintptr(slot) * UPLOADER_SLOT_BYTES;
+    glBindBuffer(target, uploader.ring);
+    if (uploader.persistent)
+    {
+        memcpy(uploader.mapped + offset, data, size);
+        return;
+    }
+    // The slot fence already guarantees the GL is done with this range
+    void * p = glMapBufferRange(target, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    memcpy(p, data, size);
+    glUnmapBuffer(target);
+}
+
+static void slot_release(Uploader & uploader, int slot)
+{
+    uploader.slotFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+static void upload_texture(Uploader & uploader, UploadJob & job)
+{
+    static const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    int components = int(std::find(formats, formats + 4, job.format) - formats) + 1;
+    size_t rowBytes = size_t(job.width) * components;
+    int slotRows = int(std::max(UPLOADER_SLOT_BYTES / rowBytes, size_t(1)));
+
+    glGenTextures(1, &job.object);
+    glBindTexture(GL_TEXTURE_2D, job.object);
+    // Rows of 1 and 3 channel images are not 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, job.internalFormat, job.width, job.height, 0, job.format, GL_UNSIGNED_BYTE, 0);
+    for (int y = 0; y < job.height; y += slotRows)
+    {
+        int rows = std::min(slotRows, job.height - y);
+        int slot = slot_acquire(uploader);
+        slot_write(uploader, slot, GL_PIXEL_UNPACK_BUFFER, (const unsigned char *)job.data + y * rowBytes, rows * rowBytes);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, job.width, rows, job.format, GL_UNSIGNED_BYTE,
+                        (const void *)(GLintptr(slot) * UPLOADER_SLOT_BYTES));
+        slot_release(uploader, slot);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+static void upload_ktx(Uploader & uploader, UploadJob & job)
+{
+    const KtxView & ktx = *job.ktx;
+    glGenTextures(1, &job.object);
+    glBindTexture(GL_TEXTURE_2D, job.object);
+    for (unsigned int level = 0; level < ktx.levelCount; ++level)
+    {
+        int width = std::max(int(ktx.header->pixelWidth >> level), 1);
+        int height = std::max(int(ktx.header->pixelHeight >> level), 1);
+        // Blocks can not be split by rows, a level larger than a slot goes straight from the mapping
+        if (ktx.levelSizes[level] > UPLOADER_SLOT_BYTES)
+        {
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, ktx.header->glInternalFormat, width, height, 0,
+                                   ktx.levelSizes[level], ktx.levels[level]);
+            continue;
+        }
+        int slot = slot_acquire(uploader);
+        slot_write(uploader, slot, GL_PIXEL_UNPACK_BUFFER, ktx.levels[level], ktx.levelSizes[level]);
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, ktx.header->glInternalFormat, width, height, 0,
+                               ktx.levelSizes[level], (const void *)(GLintptr(slot) * UPLOADER_SLOT_BYTES));
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        slot_release(uploader, slot);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, ktx.levelCount - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+static void uploader_thread(Uploader * u)
+{
+    Uploader & uploader = *u;
+    glfwMakeContextCurrent(uploader.context);
+
+    GLsizeiptr ringSize = GLsizeiptr(UPLOADER_SLOT_COUNT) * UPLOADER_SLOT_BYTES;
+    glGenBuffers(1, &uploader.ring);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploader.ring);
+    uploader.persistent = GLEW_ARB_buffer_storage != 0;
+    if (uploader.persistent)
+    {
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, ringSize, 0, UPLOADER_PERSISTENT_FLAGS);
+        uploader.mapped = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, ringSize, UPLOADER_PERSISTENT_FLAGS);
+    }
+    else
+    {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, ringSize, 0, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    for (;;)
+    {
+        UploadJob * job;
+        {
+            std::unique_lock<std::mutex> lock(uploader.mutex);
+            while (uploader.jobs.empty() && !uploader.stop)
+                uploader.jobAdded.wait(lock);
+            if (uploader.jobs.empty())
+                break;
+            job = uploader.jobs.front();
+            uploader.jobs.pop_front();
+            uploader.busy = true;
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        switch (job->type)
+        {
+        case UPLOAD_TEXTURE_2D:
+            upload_texture(uploader, *job);
+            break;
+        case UPLOAD_KTX:
+            upload_ktx(uploader, *job);
+            break;
+        }
+        job->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        // Fences are only seen by other contexts once flushed
+        glFlush();
+        job->uploadTime = elapsed_ms(start);
+
+        std::lock_guard<std::mutex> lock(uploader.mutex);
+        uploader.fenced.push_back(job);
+        uploader.busy = false;
+        uploader.jobDone.notify_all();
+    }
+
+    for (int i = 0; i < UPLOADER_SLOT_COUNT; ++i)
+        if (uploader.slotFences[i])
+            glDeleteSync(uploader.slotFences[i]);
+    if (uploader.persistent)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploader.ring);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &uploader.ring);
+    glFinish();
+    glfwMakeContextCurrent(0);
+}
+
+bool uploader_init(Uploader & uploader, GLFWwindow * share)
+{
+    // Only the context is needed, the window stays hidden
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    uploader.context = glfwCreateWindow(1, 1, "aogl uploads", 0, share);
+    glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+    if (!uploader.context)
+    {
+        fprintf(stderr, "Uploader : can not create a shared context\n");
+        return false;
+    }
+    uploader.busy = false;
+    uploader.stop = false;
+    uploader.ring = 0;
+    uploader.mapped = 0;
+    for (int i = 0; i < UPLOADER_SLOT_COUNT; ++i)
+        uploader.slotFences[i] = 0;
+    uploader.slot = 0;
+    uploader.persistent = false;
+    uploader.thread = std::thread(uploader_thread, &uploader);
+    return true;
+}
+
+void uploader_release(Uploader & uploader)
+{
+    {
+        std::lock_guard<std::mutex> lock(uploader.mutex);
+        uploader.stop = true;
+        uploader.jobAdded.notify_all();
+    }
+    uploader.thread.join();
+    // Jobs never handed back own their texture, the objects are shared with this context
+    for (size_t i = 0; i < uploader.fenced.size(); ++i)
+    {
+        UploadJob & job = *uploader.fenced[i];
+        glDeleteSync(job.fence);
+        glDeleteTextures(1, &job.object);
+        job.fence = 0;
+        job.object = 0;
+    }
+    uploader.fenced.clear();
+    glfwDestroyWindow(uploader.context);
+    uploader.context = 0;
+}
+
+void uploader_push(Uploader & uploader, UploadJob & job)
+{
+    job.object = 0;
+    job.fence = 0;
+    job.ready = false;
+    std::lock_guard<std::mutex> lock(uploader.mutex);
+    uploader.jobs.push_back(&job);
+    uploader.jobAdded.notify_one();
+}
+
+void uploader_wait(Uploader & uploader)
+{
+    std::unique_lock<std::mutex> lock(uploader.mutex);
+    while (!uploader.jobs.empty() || uploader.busy)
+        uploader.jobDone.wait(lock);
+}
+
+void uploader_poll(Uploader & uploader)
+{
+    std::lock_guard<std::mutex> lock(uploader.mutex);
+    for (size_t i = 0; i < uploader.fenced.size();)
+    {
+        UploadJob & job = *uploader.fenced[i];
+        GLenum status = glClientWaitSync(job.fence, 0, 0);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+        {
+            glDeleteSync(job.fence);
+            job.fence = 0;
+            job.ready = true;
+            uploader.fenced[i] = uploader.fenced.back();
+            uploader.fenced.pop_back();
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef AOGL_UPLOADER_H
+#define AOGL_UPLOADER_H
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "glew/glew.h"
+
+#include "ktx.h"
+
+struct GLFWwindow;
+
+// Staging ring split in slots, a job larger than a slot is copied through several
+const int UPLOADER_SLOT_COUNT = 4;
+const size_t UPLOADER_SLOT_BYTES = 4 * 1024 * 1024;
+
+enum UploadType
+{
+    UPLOAD_TEXTURE_2D, // GL_UNSIGNED_BYTE pixels, rows tightly packed, mipmaps generated
+    UPLOAD_KTX // every level of a mapped ktx file
+};
+
+// Filled by the caller, data or ktx must stay valid until ready is set. object is created
+// by the upload thread and may only be used by the render thread once ready is set.
+struct UploadJob
+{
+    UploadType type;
+    const void * data;
+    int width;
+    int height;
+    GLenum format;
+    GLenum internalFormat;
+    const KtxView * ktx;
+
+    GLuint object;
+    GLsync fence;
+    bool ready; // set by uploader_poll once the fence passed
+    double uploadTime; // ms, on the upload thread, copies and api calls
+};
+
+// Second GL context sharing objects with the render context, current on its own thread.
+// Jobs are copied through a ring of pixel unpack buffer slots, each slot guarded by a fence
+// so it is only overwritten once the GL has consumed it. The ring is persistently mapped
+// when GL_ARB_buffer_storage is available, mapped unsynchronized per copy otherwise.
+struct Uploader
+{
+    GLFWwindow * context;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable jobAdded;
+    std::condition_variable jobDone;
+    std::deque<UploadJob *> jobs;
+    bool busy;
+    std::vector<UploadJob *> fenced; // submitted, waiting on their fence
+    bool stop;
+
+    // Owned by the upload thread
+    GLuint ring;
+    unsigned char * mapped; // whole ring when persistent, 0 otherwise
+    GLsync slotFences[UPLOADER_SLOT_COUNT];
+    int slot;
+    bool persistent;
+};
+
+// Create the hidden shared context, call on the main thread with share current
+bool uploader_init(Uploader & uploader, GLFWwindow * share);
+// Finish the queued jobs, join the thread and destroy the context. Textures of jobs
+// not ready yet are deleted, call on the render thread.
+void uploader_release(Uploader & uploader);
+// Queue job, callable from any thread
+void uploader_push(Uploader & uploader, UploadJob & job);
+// Block until every job pushed so far has been submitted
+void uploader_wait(Uploader & uploader);
+// Mark the jobs whose fence passed as ready, call on the render thread
+void uploader_poll(Uploader & uploader);
+
+#endif // AOGL_UPLOADER_H
@@ -0,0 +1,63 @@
+#include "vertexpulling.h"
+
+#include <vector>
+
+void pulled_mesh_init(PulledMesh & mesh, const float * positions, const float * normals, const float * uvs, int vertexCount, const int * indices, int indexCount)
+{
+    std::vector<float> packed(vertexCount * 8);
+    for (int i = 0; i < vertexCount; ++i)
+    {
+        float * v = &packed[i * 8];
+        v[0] = positions[i*3];
+        v[1] = positions[i*3+1];
+        v[2] = positions[i*3+2];
+        v[3] = uvs[i*2];
+        v[4] = normals[i*3];
+        v[5] = normals[i*3+1];
+        v[6] = normals[i*3+2];
+        v[7] = uvs[i*2+1];
+    }
+
+    mesh.vertexCount = vertexCount;
+    mesh.indexCount = indexCount;
+
+    glGenBuffers(2, mesh.buffers);
+    glGenTextures(2, mesh.textures);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, mesh.buffers[0]);
+    glBufferData(GL_TEXTURE_BUFFER, packed.size() * sizeof(float), &packed[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, mesh.buffers[1]);
+    glBufferData(GL_TEXTURE_BUFFER, indexCount * sizeof(int), indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glBindTexture(GL_TEXTURE_BUFFER, mesh.textures[0]);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, mesh.buffers[0]);
+    glBindTexture(GL_TEXTURE_BUFFER, mesh.textures[1]);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, mesh.buffers[1]);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void pulled_mesh_release(PulledMesh & mesh)
+{
+    glDeleteTextures(2, mesh.textures);
+    glDeleteBuffers(2, mesh.buffers);
+    mesh.vertexCount = mesh.indexCount = 0;
+}
+
+void pulled_mesh_bind(const PulledMesh & mesh)
+{
+    glActiveTexture(GL_TEXTURE0 + PULL_MESH_VERTICES_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, mesh.textures[0]);
+    glActiveTexture(GL_TEXTURE0 + PULL_MESH_INDICES_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, mesh.textures[1]);
+}
+
+GLuint pull_instance_texture_create(GLuint instanceBuffer)
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, instanceBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    return texture;
+}
@@ -0,0 +1,35 @@
+#ifndef AOGL_VERTEXPULLING_H
+#define AOGL_VERTEXPULLING_H
+
+#include "glew/glew.h"
+
+// Texture units reserved for the vertex pulling path, must match the
+// samplers of shaders/tp2/aogl_pull.vert
+enum PullTextureUnit
+{
+    PULL_INSTANCES_UNIT = 3,
+    PULL_MESH_VERTICES_UNIT = 4,
+    PULL_MESH_INDICES_UNIT = 5
+};
+
+// Number of vertices generated from gl_VertexID for the procedural cube
+const int PULL_CUBE_VERTEX_COUNT = 36;
+
+// Mesh packed for vertex pulling : two RGBA32F texels per vertex
+// (position.xyz + u, normal.xyz + v) and one R32UI texel per index
+struct PulledMesh
+{
+    GLuint buffers[2];
+    GLuint textures[2];
+    int vertexCount;
+    int indexCount;
+};
+
+void pulled_mesh_init(PulledMesh & mesh, const float * positions, const float * normals, const float * uvs, int vertexCount, const int * indices, int indexCount);
+void pulled_mesh_release(PulledMesh & mesh);
+void pulled_mesh_bind(const PulledMesh & mesh);
+
+// Expose an instance buffer (see instances.h) to the shaders as a RGBA32F texture buffer
+GLuint pull_instance_texture_create(GLuint instanceBuffer);
+
+#endif // AOGL_VERTEXPULLING_H
@@ -0,0 +1,388 @@
+#include "virtualtexture.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+static const VtFileHeader & file_header(const VirtualTexture & texture)
+{
+    return *texture.file.header;
+}
+
+static void upload_page(VirtualTexture & texture, int slot, const unsigned char * record)
+{
+    const VtFileHeader & header = file_header(texture);
+    int x = (slot % texture.cachePages) * VT_PAGE_SIZE;
+    int y = (slot / texture.cachePages) * VT_PAGE_SIZE;
+    for (int layer = 0; layer < VT_LAYER_COUNT; ++layer)
+    {
+        glBindTexture(GL_TEXTURE_2D, texture.caches[layer]);
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, x, y, VT_PAGE_SIZE, VT_PAGE_SIZE, header.internalFormats[layer],
+                                  header.layerBytes[layer], record);
+        record += header.layerBytes[layer];
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+static void page_table_update(VirtualTexture & texture)
+{
+    const VtFileHeader & header = file_header(texture);
+    // Coarsest level first, a page that is not resident takes the entry of its parent
+    for (int level = int(header.levelCount) - 1; level >= 0; --level)
+    {
+        int side = int(header.pages >> level);
+        for (int y = 0; y < side; ++y)
+        {
+            for (int x = 0; x < side; ++x)
+            {
+                unsigned int index = vt_file_page_index(texture.file, level, x, y);
+                const VirtualPage & page = texture.pages[index];
+                unsigned char * entry = &texture.pageTableData[size_t(index) * 4];
+                if (page.state == VIRTUAL_PAGE_RESIDENT)
+                {
+                    entry[0] = (unsigned char)(page.slot % texture.cachePages);
+                    entry[1] = (unsigned char)(page.slot / texture.cachePages);
+                    entry[2] = (unsigned char)level;
+                    entry[3] = 1;
+                }
+                else if (level + 1 < int(header.levelCount))
+                {
+                    memcpy(entry, &texture.pageTableData[size_t(vt_file_page_index(texture.file, level + 1, x / 2, y / 2)) * 4], 4);
+                }
+                else
+                {
+                    entry[0] = entry[1] = entry[3] = 0;
+                    entry[2] = (unsigned char)level;
+                }
+            }
+        }
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture.pageTable);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    for (int level = 0; level < int(header.levelCount); ++level)
+    {
+        int side = int(header.pages >> level);
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, side, side, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE,
+                        &texture.pageTableData[size_t(texture.file.levelOffsets[level]) * 4]);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    texture.pageTableDirty = false;
+}
+
+// Free slot, or the one of the least recently used page the last feedback did not ask for
+static int slot_allocate(VirtualTexture & texture)
+{
+    int coarsest = int(file_header(texture).levelCount) - 1;
+    int victim = -1;
+    unsigned int victimUse = 0;
+    for (size_t i = 0; i < texture.slots.size(); ++i)
+    {
+        if (texture.slots[i] == VT_NO_PAGE)
+            return int(i);
+        const VirtualPage & page = texture.pages[texture.slots[i]];
+        if (texture.slots[i] >= texture.file.levelOffsets[coarsest] || page.lastUsed == texture.frame)
+            continue;
+        if (victim < 0 || page.lastUsed < victimUse)
+        {
+            victim = int(i);
+            victimUse = page.lastUsed;
+        }
+    }
+    if (victim >= 0)
+    {
+        VirtualPage & page = texture.pages[texture.slots[victim]];
+        page.state = VIRTUAL_PAGE_UNLOADED;
+        page.slot = -1;
+        texture.slots[victim] = VT_NO_PAGE;
+        ++texture.evictionCount;
+    }
+    return victim;
+}
+
+static void page_make_resident(VirtualTexture & texture, unsigned int index, int slot, const unsigned char * record)
+{
+    upload_page(texture, slot, record);
+    texture.pages[index].state = VIRTUAL_PAGE_RESIDENT;
+    texture.pages[index].slot = slot;
+    texture.slots[slot] = index;
+    texture.pageTableDirty = true;
+}
+
+// Copy the record out of the mapping so the page fault happens here, not on the main thread
+static void page_load_task(void * user)
+{
+    VirtualPageLoad & load = *(VirtualPageLoad *)user;
+    const VirtualTexture & texture = *load.texture;
+    const VtFileHeader & header = file_header(texture);
+    const unsigned char * record = vt_file_page(texture.file, texture.file.index[load.page]);
+    load.data.assign(record, record + header.layerBytes[VT_DIFFUSE] + header.layerBytes[VT_SPECULAR]);
+
+    std::lock_guard<std::mutex> lock(load.texture->mutex);
+    load.done = true;
+}
+
+// Mark the page of a feedback value and its ancestors as used, ask for the missing ones
+static void feedback_request(VirtualTexture & texture, GLuint value)
+{
+    const VtFileHeader & header = file_header(texture);
+    int x = int(value & 0xFFF);
+    int y = int((value >> 12) & 0xFFF);
+    int level = int(value >> 24);
+    if (level >= int(header.levelCount) || x >= int(header.pages >> level) || y >= int(header.pages >> level))
+        return;
+    for (; level < int(header.levelCount); ++level, x /= 2, y /= 2)
+    {
+        unsigned int index = vt_file_page_index(texture.file, level, x, y);
+        VirtualPage & page = texture.pages[index];
+        if (page.lastUsed == texture.frame)
+            break; // already seen in this feedback, so were its ancestors
+        page.lastUsed = texture.frame;
+        if (page.state == VIRTUAL_PAGE_UNLOADED)
+            texture.requests.push_back(index);
+        ++texture.requestCount;
+    }
+}
+
+static void feedback_read(VirtualTexture & texture)
+{
+    if (texture.feedbackRead == texture.feedbackWritten)
+        return;
+    int i = int(texture.feedbackRead % VIRTUAL_FEEDBACK_FRAMES);
+    GLenum status = glClientWaitSync(texture.feedbackFences[i], 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        return;
+    glDeleteSync(texture.feedbackFences[i]);
+    texture.feedbackFences[i] = 0;
+    ++texture.feedbackRead;
+    ++texture.frame;
+
+    size_t count = size_t(texture.feedbackWidth) * texture.feedbackHeight;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, texture.feedbackBuffers[i]);
+    const GLuint * values = (const GLuint *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, count * sizeof(GLuint), GL_MAP_READ_BIT);
+    if (values)
+    {
+        GLuint previous = VIRTUAL_FEEDBACK_NONE;
+        for (size_t p = 0; p < count; ++p)
+        {
+            // Neighbours mostly want the same page
+            if (values[p] == previous || values[p] == VIRTUAL_FEEDBACK_NONE)
+                continue;
+            previous = values[p];
+            feedback_request(texture, values[p]);
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+static GLuint texture_create(GLenum internalFormat, int levels, int width, int height, GLint filter)
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+bool virtual_texture_init(VirtualTexture & texture, ThreadPool & pool, const char * path, int cachePages, int width, int height)
+{
+    texture.pool = &pool;
+    texture.cachePages = cachePages;
+    texture.pageTable = 0;
+    texture.caches[VT_DIFFUSE] = texture.caches[VT_SPECULAR] = 0;
+    texture.feedbackTexture = texture.feedbackSmall = 0;
+    texture.feedbackFbos[0] = texture.feedbackFbos[1] = 0;
+    texture.feedbackWritten = texture.feedbackRead = 0;
+    texture.frame = 1;
+    texture.requestCount = texture.uploadCount = texture.evictionCount = 0;
+    if (!vt_file_map(texture.file, path))
+        return false;
+
+    const VtFileHeader & header = file_header(texture);
+    int coarsest = int(header.levelCount) - 1;
+    unsigned int coarsePages = 0;
+    for (unsigned int i = texture.file.levelOffsets[coarsest]; i < texture.file.indexCount; ++i)
+        coarsePages += texture.file.index[i] != VT_NO_PAGE;
+    // Slot coordinates are stored in bytes, the other levels need room to stream in
+    if (cachePages > 256 || coarsePages >= unsigned(cachePages * cachePages) || header.pages > 4096)
+    {
+        fprintf(stderr, "Virtual texture %s : %u pages always resident do not fit in %dx%d cache slots\n", path, coarsePages, cachePages, cachePages);
+        vt_file_unmap(texture.file);
+        return false;
+    }
+
+    texture.pageTable = texture_create(GL_RGBA8UI, header.levelCount, header.pages, header.pages, GL_NEAREST);
+    for (int layer = 0; layer < VT_LAYER_COUNT; ++layer)
+        texture.caches[layer] = texture_create(header.internalFormats[layer], 1, cachePages * VT_PAGE_SIZE, cachePages * VT_PAGE_SIZE, GL_LINEAR);
+
+    texture.pages.resize(texture.file.indexCount);
+    for (unsigned int i = 0; i < texture.file.indexCount; ++i)
+    {
+        texture.pages[i].state = texture.file.index[i] == VT_NO_PAGE ? VIRTUAL_PAGE_ABSENT : VIRTUAL_PAGE_UNLOADED;
+        texture.pages[i].slot = -1;
+        texture.pages[i].lastUsed = 0;
+    }
+    texture.slots.assign(size_t(cachePages) * cachePages, VT_NO_PAGE);
+    texture.pageTableData.resize(size_t(texture.file.indexCount) * 4);
+
+    // The coarsest level is the fallback of every other page, it is read right away
+    int slot = 0;
+    for (unsigned int i = texture.file.levelOffsets[coarsest]; i < texture.file.indexCount; ++i)
+        if (texture.pages[i].state == VIRTUAL_PAGE_UNLOADED)
+            page_make_resident(texture, i, slot++, vt_file_page(texture.file, texture.file.index[i]));
+    page_table_update(texture);
+
+    texture.feedbackWidth = std::max((width - (VIRTUAL_FEEDBACK_SCALE - 1)) / VIRTUAL_FEEDBACK_SCALE, 1);
+    texture.feedbackHeight = std::max((height - (VIRTUAL_FEEDBACK_SCALE - 1)) / VIRTUAL_FEEDBACK_SCALE, 1);
+    texture.feedbackTexture = texture_create(GL_R32UI, 1, width, height, GL_NEAREST);
+    texture.feedbackSmall = texture_create(GL_R32UI, 1, texture.feedbackWidth, texture.feedbackHeight, GL_NEAREST);
+    glGenFramebuffers(2, texture.feedbackFbos);
+    GLuint attachments[2] = { texture.feedbackTexture, texture.feedbackSmall };
+    for (int i = 0; i < 2; ++i)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, texture.feedbackFbos[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, attachments[i], 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            fprintf(stderr, "Virtual texture %s : feedback framebuffer %d incomplete\n", path, i);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenBuffers(VIRTUAL_FEEDBACK_FRAMES, texture.feedbackBuffers);
+    for (int i = 0; i < VIRTUAL_FEEDBACK_FRAMES; ++i)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, texture.feedbackBuffers[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size_t(texture.feedbackWidth) * texture.feedbackHeight * sizeof(GLuint), 0, GL_STREAM_READ);
+        texture.feedbackFences[i] = 0;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    fprintf(stdout, "Virtual texture %s : %u materials, %ux%u pages, %u levels, %dx%d cache slots, %.2f MB of cache\n",
+            path, header.materialCount, header.pages, header.pages, header.levelCount, cachePages, cachePages,
+            (texture.slots.size() * (header.layerBytes[VT_DIFFUSE] + header.layerBytes[VT_SPECULAR])) / (1024. * 1024.));
+    return true;
+}
+
+void virtual_texture_release(VirtualTexture & texture)
+{
+    if (!texture.file.header)
+        return;
+    // Let pending loads finish before their mapping goes away
+    thread_pool_wait(*texture.pool);
+    for (size_t i = 0; i < texture.loads.size(); ++i)
+        delete texture.loads[i];
+    texture.loads.clear();
+    for (int i = 0; i < VIRTUAL_FEEDBACK_FRAMES; ++i)
+        if (texture.feedbackFences[i])
+            glDeleteSync(texture.feedbackFences[i]);
+    glDeleteBuffers(VIRTUAL_FEEDBACK_FRAMES, texture.feedbackBuffers);
+    glDeleteFramebuffers(2, texture.feedbackFbos);
+    glDeleteTextures(1, &texture.feedbackTexture);
+    glDeleteTextures(1, &texture.feedbackSmall);
+    glDeleteTextures(1, &texture.pageTable);
+    glDeleteTextures(VT_LAYER_COUNT, texture.caches);
+    vt_file_unmap(texture.file);
+}
+
+glm::vec4 virtual_texture_rect(const VirtualTexture & texture, int material)
+{
+    const VtMaterial & m = texture.file.materials[material];
+    float pages = float(file_header(texture).pages);
+    return glm::vec4(m.x / pages, m.y / pages, m.pages / pages, m.pages / pages);
+}
+
+void virtual_texture_update(VirtualTexture & texture)
+{
+    feedback_read(texture);
+
+    // Coarse pages first, they are the fallback of the finer ones
+    if (!texture.requests.empty())
+    {
+        std::sort(texture.requests.begin(), texture.requests.end());
+        for (size_t i = texture.requests.size(); i-- > 0 && texture.loads.size() < size_t(VIRTUAL_TEXTURE_LOADS);)
+        {
+            VirtualPageLoad * load = new VirtualPageLoad();
+            load->texture = &texture;
+            load->page = texture.requests[i];
+            load->done = false;
+            texture.pages[load->page].state = VIRTUAL_PAGE_LOADING;
+            texture.loads.push_back(load);
+            thread_pool_push(*texture.pool, page_load_task, load);
+        }
+        texture.requests.clear();
+    }
+
+    int uploads = 0;
+    for (size_t i = 0; i < texture.loads.size() && uploads < VIRTUAL_TEXTURE_UPLOADS;)
+    {
+        VirtualPageLoad * load = texture.loads[i];
+        {
+            std::lock_guard<std::mutex> lock(texture.mutex);
+            if (!load->done)
+            {
+                ++i;
+                continue;
+            }
+        }
+        int slot = slot_allocate(texture);
+        if (slot < 0)
+        {
+            // Every slot is wanted, the page will be asked again
+            texture.pages[load->page].state = VIRTUAL_PAGE_UNLOADED;
+        }
+        else
+        {
+            page_make_resident(texture, load->page, slot, &load->data[0]);
+            ++texture.uploadCount;
+            ++uploads;
+        }
+        delete load;
+        texture.loads.erase(texture.loads.begin() + i);
+    }
+
+    if (texture.pageTableDirty)
+        page_table_update(texture);
+}
+
+void virtual_texture_feedback(VirtualTexture & texture)
+{
+    // Skip this frame if every readback is still in flight
+    if (texture.feedbackWritten - texture.feedbackRead >= unsigned(VIRTUAL_FEEDBACK_FRAMES))
+        return;
+    int i = int(texture.feedbackWritten % VIRTUAL_FEEDBACK_FRAMES);
+    // Keep one pixel per square, walking through the whole square over the frames
+    int jitter = int(texture.feedbackWritten % (VIRTUAL_FEEDBACK_SCALE * VIRTUAL_FEEDBACK_SCALE));
+    int x = jitter % VIRTUAL_FEEDBACK_SCALE;
+    int y = jitter / VIRTUAL_FEEDBACK_SCALE;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, texture.feedbackFbos[0]);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, texture.feedbackFbos[1]);
+    glBlitFramebuffer(x, y, x + texture.feedbackWidth * VIRTUAL_FEEDBACK_SCALE, y + texture.feedbackHeight * VIRTUAL_FEEDBACK_SCALE,
+                      0, 0, texture.feedbackWidth, texture.feedbackHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, texture.feedbackFbos[1]);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, texture.feedbackBuffers[i]);
+    glReadPixels(0, 0, texture.feedbackWidth, texture.feedbackHeight, GL_RED_INTEGER, GL_UNSIGNED_INT, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    texture.feedbackFences[i] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ++texture.feedbackWritten;
+}
+
+VirtualTextureStats virtual_texture_stats(VirtualTexture & texture)
+{
+    VirtualTextureStats stats;
+    stats.residentPages = 0;
+    for (size_t i = 0; i < texture.slots.size(); ++i)
+        stats.residentPages += texture.slots[i] != VT_NO_PAGE;
+    stats.cacheSlots = int(texture.slots.size());
+    stats.requests = texture.requestCount;
+    stats.uploads = texture.uploadCount;
+    stats.evictions = texture.evictionCount;
+    texture.requestCount = texture.uploadCount = texture.evictionCount = 0;
+    return stats;
+}
@@ -0,0 +1,121 @@
+#ifndef AOGL_VIRTUALTEXTURE_H
+#define AOGL_VIRTUALTEXTURE_H
+
+#include <vector>
+#include <mutex>
+
+#include "glew/glew.h"
+
+#include "glm/glm.hpp"
+
+#include "threadpool.h"
+#include "vtfile.h"
+
+// Units the virtual texture stays bound to, no other pass uses them
+enum VirtualTextureUnit
+{
+    VIRTUAL_PAGE_TABLE_UNIT = 13,
+    VIRTUAL_DIFFUSE_CACHE_UNIT = 14,
+    VIRTUAL_SPECULAR_CACHE_UNIT = 15
+};
+
+// Feedback of the geometry pass, one pixel out of each VIRTUAL_FEEDBACK_SCALE squared is read
+// back, a different one every frame. Pixels with no virtual texture keep VIRTUAL_FEEDBACK_NONE.
+// A feedback value is x | y << 12 | level << 24 with x, y the page at level, as aogl.frag packs it.
+const int VIRTUAL_FEEDBACK_SCALE = 8;
+const int VIRTUAL_FEEDBACK_FRAMES = 3; // readbacks in flight
+const GLuint VIRTUAL_FEEDBACK_NONE = 0xFFFFFFFF;
+// Pages read on the pool at once and uploaded per frame
+const int VIRTUAL_TEXTURE_LOADS = 16;
+const int VIRTUAL_TEXTURE_UPLOADS = 8;
+
+enum VirtualPageState
+{
+    VIRTUAL_PAGE_ABSENT, // no material there
+    VIRTUAL_PAGE_UNLOADED,
+    VIRTUAL_PAGE_LOADING, // read by a worker
+    VIRTUAL_PAGE_RESIDENT // in its cache slot
+};
+
+struct VirtualPage
+{
+    VirtualPageState state;
+    int slot; // cache slot while resident, -1 otherwise
+    unsigned int lastUsed; // last feedback read that asked for the page or one of its children
+};
+
+struct VirtualTexture;
+
+struct VirtualPageLoad
+{
+    VirtualTexture * texture;
+    unsigned int page; // index entry
+    std::vector<unsigned char> data; // the record, copied from the mapping by the worker
+    bool done;
+};
+
+struct VirtualTextureStats
+{
+    int residentPages;
+    int cacheSlots;
+    int requests; // pages seen in the feedback since the last virtual_texture_stats
+    int uploads;
+    int evictions;
+};
+
+// Sparse virtual texturing of every material of a .aovt cache. The physical caches are
+// two fixed textures, diffuse and specular, of cachePages squared slots, whatever the
+// number of materials. The page table holds for each page of each level the slot of
+// the page or, while it is not resident, the slot of its nearest resident ancestor, so
+// the geometry pass always has something to sample. The pages of the coarsest level are
+// loaded first and never evicted. Every frame the geometry pass writes the page each
+// pixel wants to the feedback texture, a subset of it is read back a few frames later,
+// the missing pages are read from the mapped cache on the pool, coarsest first, then
+// uploaded over the least recently used slots.
+struct VirtualTexture
+{
+    VtFileView file;
+    ThreadPool * pool;
+    int cachePages; // side of the caches in slots
+    GLuint pageTable; // GL_RGBA8UI, slot x, slot y, level of the page sampled, 1 if any
+    GLuint caches[VT_LAYER_COUNT];
+    std::vector<VirtualPage> pages; // one per index entry
+    std::vector<unsigned int> slots; // index entry held by each slot, VT_NO_PAGE when free
+    std::vector<unsigned char> pageTableData;
+    bool pageTableDirty;
+    std::vector<VirtualPageLoad *> loads;
+    std::vector<unsigned int> requests;
+    std::mutex mutex;
+    unsigned int frame; // feedbacks read so far
+
+    GLuint feedbackTexture; // GL_R32UI, full size, attached to the G-buffer
+    GLuint feedbackSmall;
+    GLuint feedbackFbos[2]; // read from the full size texture, draw to the small one
+    GLuint feedbackBuffers[VIRTUAL_FEEDBACK_FRAMES];
+    GLsync feedbackFences[VIRTUAL_FEEDBACK_FRAMES];
+    int feedbackWidth;
+    int feedbackHeight;
+    unsigned int feedbackWritten;
+    unsigned int feedbackRead;
+
+    int requestCount;
+    int uploadCount;
+    int evictionCount;
+};
+
+// Map the cache at path, create the textures and a feedback target of width by height,
+// and load the coarsest level. Returns false if the cache can not be read or its coarsest
+// level does not fit in cachePages squared slots.
+bool virtual_texture_init(VirtualTexture & texture, ThreadPool & pool, const char * path, int cachePages, int width, int height);
+void virtual_texture_release(VirtualTexture & texture);
+// Where material lies in the virtual texture : uv offset in xy, uv scale in zw
+glm::vec4 virtual_texture_rect(const VirtualTexture & texture, int material);
+// Read the oldest finished feedback, start loading the pages it asks for, upload the
+// pages loaded and update the page table. Call once per frame before the geometry pass.
+void virtual_texture_update(VirtualTexture & texture);
+// Queue the readback of this frame's feedback, call after the geometry pass. Changes
+// the read and draw framebuffer bindings.
+void virtual_texture_feedback(VirtualTexture & texture);
+VirtualTextureStats virtual_texture_stats(VirtualTexture & texture);
+
+#endif // AOGL_VIRTUALTEXTURE_H
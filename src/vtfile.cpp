@@ -0,0 +1,253 @@
+#include "vtfile.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+static bool is_power_of_two(unsigned int v)
+{
+    return v && (v & (v - 1)) == 0;
+}
+
+// Position of the nth cell along a Z order curve
+static void morton_decode(unsigned int n, unsigned int & x, unsigned int & y)
+{
+    x = y = 0;
+    for (int bit = 0; bit < 16; ++bit)
+    {
+        x |= ((n >> (2 * bit)) & 1) << bit;
+        y |= ((n >> (2 * bit + 1)) & 1) << bit;
+    }
+}
+
+// Blocks of page x, y of a level of ktx plus a frame of one block, wrapping around
+static void copy_page_blocks(const KtxView & ktx, int level, int x, int y, int blockBytes, unsigned char * out)
+{
+    const int pageBlocks = VT_PAGE_SIZE / 4;
+    const int contentBlocks = VT_PAGE_TEXELS / 4;
+    const int levelBlocks = std::max(int(ktx.header->pixelWidth >> level) / 4, 1);
+    const unsigned char * blocks = ktx.levels[level];
+    for (int by = 0; by < pageBlocks; ++by)
+    {
+        int sy = (y * contentBlocks + by - 1 + levelBlocks) % levelBlocks;
+        for (int bx = 0; bx < pageBlocks; ++bx)
+        {
+            int sx = (x * contentBlocks + bx - 1 + levelBlocks) % levelBlocks;
+            memcpy(out, blocks + (size_t(sy) * levelBlocks + sx) * blockBytes, blockBytes);
+            out += blockBytes;
+        }
+    }
+}
+
+bool vt_file_write(const char * path, const std::vector<const KtxView *> & diffuse, const std::vector<const KtxView *> & specular)
+{
+    if (diffuse.empty() || diffuse.size() != specular.size())
+    {
+        fprintf(stderr, "Virtual texture %s : needs a specular texture for each diffuse one\n", path);
+        return false;
+    }
+
+    VtFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = VT_FILE_MAGIC;
+    header.version = VT_FILE_VERSION;
+    header.materialCount = (unsigned int)diffuse.size();
+    header.internalFormats[VT_DIFFUSE] = diffuse[0]->header->glInternalFormat;
+    header.internalFormats[VT_SPECULAR] = specular[0]->header->glInternalFormat;
+
+    const int pageBlocks = VT_PAGE_SIZE / 4;
+    unsigned int smallest = ~0u;
+    unsigned int totalPages = 0;
+    std::vector< std::pair<unsigned int, int> > order(diffuse.size());
+    for (size_t i = 0; i < diffuse.size(); ++i)
+    {
+        const KtxView * layers[VT_LAYER_COUNT] = { diffuse[i], specular[i] };
+        unsigned int size = layers[0]->header->pixelWidth;
+        for (int l = 0; l < VT_LAYER_COUNT; ++l)
+        {
+            const KtxHeader & ktx = *layers[l]->header;
+            if (ktx.pixelWidth != size || ktx.pixelHeight != size || !is_power_of_two(size) || size < (unsigned int)VT_PAGE_TEXELS)
+            {
+                fprintf(stderr, "Virtual texture %s : material %d is not made of square power of two textures of the same size, at least %d wide\n",
+                        path, int(i), VT_PAGE_TEXELS);
+                return false;
+            }
+            if (ktx.glInternalFormat != header.internalFormats[l])
+            {
+                fprintf(stderr, "Virtual texture %s : material %d has a different block format\n", path, int(i));
+                return false;
+            }
+            unsigned int blocks = (size / 4) * (size / 4);
+            unsigned int layerBytes = layers[l]->levelSizes[0] / blocks * pageBlocks * pageBlocks;
+            if (i == 0)
+                header.layerBytes[l] = layerBytes;
+        }
+        unsigned int pages = size / VT_PAGE_TEXELS;
+        smallest = std::min(smallest, pages);
+        totalPages += pages * pages;
+        order[i] = std::make_pair(size, int(i));
+    }
+
+    header.levelCount = 1;
+    while ((1u << header.levelCount) <= smallest)
+        ++header.levelCount;
+    for (size_t i = 0; i < diffuse.size(); ++i)
+    {
+        if (diffuse[i]->levelCount < header.levelCount || specular[i]->levelCount < header.levelCount)
+        {
+            fprintf(stderr, "Virtual texture %s : material %d misses mip levels, cook it again with texcook\n", path, int(i));
+            return false;
+        }
+    }
+
+    // Largest first along a Z order curve : every square starts aligned on its size, no gaps
+    std::sort(order.rbegin(), order.rend());
+    header.pages = order[0].first / VT_PAGE_TEXELS;
+    while (header.pages * header.pages < totalPages)
+        header.pages *= 2;
+    std::vector<VtMaterial> materials(diffuse.size());
+    unsigned int cursor = 0;
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        VtMaterial & material = materials[order[i].second];
+        material.pages = order[i].first / VT_PAGE_TEXELS;
+        morton_decode(cursor, material.x, material.y);
+        cursor += material.pages * material.pages;
+    }
+
+    // Material owning each page, records are numbered in index order
+    std::vector<unsigned int> index;
+    std::vector<int> owners;
+    for (unsigned int level = 0; level < header.levelCount; ++level)
+    {
+        unsigned int side = header.pages >> level;
+        size_t first = index.size();
+        index.resize(first + side * side, VT_NO_PAGE);
+        owners.resize(index.size(), -1);
+        for (size_t m = 0; m < materials.size(); ++m)
+        {
+            unsigned int pages = materials[m].pages >> level;
+            for (unsigned int y = 0; y < pages; ++y)
+                for (unsigned int x = 0; x < pages; ++x)
+                    owners[first + ((materials[m].y >> level) + y) * side + (materials[m].x >> level) + x] = int(m);
+        }
+    }
+    for (size_t i = 0; i < index.size(); ++i)
+        if (owners[i] >= 0)
+            index[i] = header.pageCount++;
+
+    header.materialOffset = sizeof(VtFileHeader);
+    header.indexOffset = header.materialOffset + materials.size() * sizeof(VtMaterial);
+    header.pageOffset = (header.indexOffset + index.size() * sizeof(unsigned int) + 15) & ~15ull;
+
+    FILE * f = fopen(path, "wb");
+    if (!f)
+        return false;
+    static const unsigned char zeros[16] = {0};
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    ok = ok && fwrite(&materials[0], sizeof(VtMaterial), materials.size(), f) == materials.size();
+    ok = ok && fwrite(&index[0], sizeof(unsigned int), index.size(), f) == index.size();
+    size_t gap = size_t(header.pageOffset - header.indexOffset - index.size() * sizeof(unsigned int));
+    ok = ok && fwrite(zeros, 1, gap, f) == gap;
+
+    // Pages are written one by one, the cache may be much larger than memory
+    std::vector<unsigned char> record(header.layerBytes[VT_DIFFUSE] + header.layerBytes[VT_SPECULAR]);
+    size_t entry = 0;
+    for (unsigned int level = 0; level < header.levelCount && ok; ++level)
+    {
+        unsigned int side = header.pages >> level;
+        for (unsigned int y = 0; y < side; ++y)
+        {
+            for (unsigned int x = 0; x < side; ++x, ++entry)
+            {
+                int m = owners[entry];
+                if (m < 0)
+                    continue;
+                int px = int(x - (materials[m].x >> level));
+                int py = int(y - (materials[m].y >> level));
+                copy_page_blocks(*diffuse[m], level, px, py, header.layerBytes[VT_DIFFUSE] / (pageBlocks * pageBlocks), &record[0]);
+                copy_page_blocks(*specular[m], level, px, py, header.layerBytes[VT_SPECULAR] / (pageBlocks * pageBlocks),
+                                 &record[header.layerBytes[VT_DIFFUSE]]);
+                ok = ok && fwrite(&record[0], 1, record.size(), f) == record.size();
+            }
+        }
+    }
+    ok = fclose(f) == 0 && ok;
+    return ok;
+}
+
+bool vt_file_map(VtFileView & view, const char * path)
+{
+    view.header = 0;
+    view.materials = 0;
+    view.index = 0;
+    view.pages = 0;
+    view.indexCount = 0;
+    if (!mapped_file_open(view.file, path))
+    {
+        fprintf(stderr, "Virtual texture %s : can not open, cook it with vtcook\n", path);
+        return false;
+    }
+
+    const VtFileHeader * header = (const VtFileHeader *)view.file.data;
+    if (view.file.size < sizeof(VtFileHeader) || header->magic != VT_FILE_MAGIC)
+    {
+        fprintf(stderr, "Virtual texture %s : not a virtual texture cache\n", path);
+        vt_file_unmap(view);
+        return false;
+    }
+    if (header->version != VT_FILE_VERSION)
+    {
+        fprintf(stderr, "Virtual texture %s : version %u, expected %u, cook it again\n", path, header->version, VT_FILE_VERSION);
+        vt_file_unmap(view);
+        return false;
+    }
+    if (header->levelCount == 0 || header->levelCount > KTX_MAX_LEVELS || (header->pages >> (header->levelCount - 1)) == 0)
+    {
+        fprintf(stderr, "Virtual texture %s : bad level count %u\n", path, header->levelCount);
+        vt_file_unmap(view);
+        return false;
+    }
+
+    for (unsigned int level = 0; level < header->levelCount; ++level)
+    {
+        unsigned int side = header->pages >> level;
+        view.levelOffsets[level] = view.indexCount;
+        view.indexCount += side * side;
+    }
+    unsigned long long recordBytes = header->layerBytes[VT_DIFFUSE] + header->layerBytes[VT_SPECULAR];
+    if (header->materialOffset + header->materialCount * sizeof(VtMaterial) > view.file.size
+        || header->indexOffset + view.indexCount * sizeof(unsigned int) > view.file.size
+        || header->pageOffset + header->pageCount * recordBytes > view.file.size)
+    {
+        fprintf(stderr, "Virtual texture %s : truncated\n", path);
+        vt_file_unmap(view);
+        return false;
+    }
+
+    view.header = header;
+    view.materials = (const VtMaterial *)(view.file.data + header->materialOffset);
+    view.index = (const unsigned int *)(view.file.data + header->indexOffset);
+    view.pages = view.file.data + header->pageOffset;
+    return true;
+}
+
+void vt_file_unmap(VtFileView & view)
+{
+    mapped_file_close(view.file);
+    view.header = 0;
+    view.materials = 0;
+    view.index = 0;
+    view.pages = 0;
+    view.indexCount = 0;
+}
+
+unsigned int vt_file_page_index(const VtFileView & view, int level, int x, int y)
+{
+    return view.levelOffsets[level] + unsigned(y) * (view.header->pages >> level) + unsigned(x);
+}
+
+const unsigned char * vt_file_page(const VtFileView & view, unsigned int record)
+{
+    return view.pages + size_t(record) * (view.header->layerBytes[VT_DIFFUSE] + view.header->layerBytes[VT_SPECULAR]);
+}
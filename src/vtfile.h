@@ -0,0 +1,76 @@
+#ifndef AOGL_VTFILE_H
+#define AOGL_VTFILE_H
+
+#include <vector>
+
+#include "ktx.h"
+#include "mappedfile.h"
+
+// Tiled virtual texture cache (.aovt) written by vtcook : a header, where each material
+// lies in the virtual texture, an index of the pages of every level, then the pages.
+// A material is a diffuse and a specular cooked texture of the same square power of two
+// size, placed on a square of pages. A page record holds the blocks of both layers for
+// the same area, framed by one block of the neighbouring texels (wrapping around the
+// material) so pages filter without seams wherever they land in the physical cache.
+// Bump VT_FILE_VERSION whenever the layout of the file changes.
+const unsigned int VT_FILE_MAGIC = 0x54564F41; // "AOVT"
+const unsigned int VT_FILE_VERSION = 1;
+const int VT_PAGE_TEXELS = 128; // texels of content per page side
+const int VT_PAGE_BORDER = 4; // one block on each side
+const int VT_PAGE_SIZE = VT_PAGE_TEXELS + 2 * VT_PAGE_BORDER;
+const unsigned int VT_NO_PAGE = 0xFFFFFFFF;
+
+enum VtLayer
+{
+    VT_DIFFUSE = 0,
+    VT_SPECULAR = 1,
+    VT_LAYER_COUNT = 2
+};
+
+struct VtFileHeader
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int pages; // side of the virtual texture in pages at level 0, a power of two
+    unsigned int levelCount; // down to the level where the smallest material is one page
+    unsigned int materialCount;
+    unsigned int pageCount; // page records stored
+    unsigned int internalFormats[VT_LAYER_COUNT];
+    unsigned int layerBytes[VT_LAYER_COUNT]; // bytes of one page of each layer
+    unsigned long long materialOffset;
+    unsigned long long indexOffset;
+    unsigned long long pageOffset;
+};
+
+// Square of pages at level 0, halved at each level
+struct VtMaterial
+{
+    unsigned int x;
+    unsigned int y;
+    unsigned int pages;
+};
+
+// Header, materials, index and pages of a mapped cache, pointers are into the mapping
+struct VtFileView
+{
+    MappedFile file;
+    const VtFileHeader * header;
+    const VtMaterial * materials;
+    const unsigned int * index; // record of each page, level after level, VT_NO_PAGE where no material lies
+    const unsigned char * pages;
+    unsigned int levelOffsets[KTX_MAX_LEVELS]; // first index entry of each level
+    unsigned int indexCount;
+};
+
+// Lay the materials out and write their pages, diffuse[i] and specular[i] make material i.
+// Returns false and prints why if the textures do not fit the format or on io error.
+bool vt_file_write(const char * path, const std::vector<const KtxView *> & diffuse, const std::vector<const KtxView *> & specular);
+// Map path and check its header, returns false if it is not a valid cache of this version
+bool vt_file_map(VtFileView & view, const char * path);
+void vt_file_unmap(VtFileView & view);
+// Index entry of page x, y of level
+unsigned int vt_file_page_index(const VtFileView & view, int level, int x, int y);
+// Diffuse then specular blocks of a record, VT_PAGE_SIZE texels on each side
+const unsigned char * vt_file_page(const VtFileView & view, unsigned int record);
+
+#endif // AOGL_VTFILE_H
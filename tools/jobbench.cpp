@@ -0,0 +1,214 @@
+// jobbench : scalability of the job system from 1 to N cores
+//
+//   jobbench [--runs N] [--threads N] [--pin]
+//
+// Three workloads, each run with 1, 2 ... N threads (the calling thread plus N - 1
+// workers) and timed best of N runs :
+//   cull     parallel for testing 4M spheres against 6 planes, memory bound
+//   compute  parallel for of a long per item computation, compute bound
+//   nested   64 parent jobs each waiting on 64 children, the counters and the stealing
+// Speedup is against 1 thread, efficiency is speedup over the thread count.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+
+#include "jobsystem.h"
+
+static const int SPHERE_COUNT = 4 * 1024 * 1024;
+static const int COMPUTE_COUNT = 64 * 1024;
+static const int NESTED_PARENTS = 64;
+static const int NESTED_CHILDREN = 64;
+
+struct Sphere
+{
+    float x, y, z, radius;
+};
+
+struct Plane
+{
+    float x, y, z, d;
+};
+
+struct CullWork
+{
+    const Sphere * spheres;
+    const Plane * planes;
+    unsigned char * visible;
+};
+
+struct ComputeWork
+{
+    float * results;
+};
+
+struct NestedParent
+{
+    JobSystem * system;
+    ComputeWork * work;
+    int first; // first item of its children
+};
+
+struct NestedChild
+{
+    ComputeWork * work;
+    int item;
+};
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void cull_range(void * user, int begin, int end)
+{
+    CullWork & work = *(CullWork *)user;
+    for (int i = begin; i < end; ++i)
+    {
+        const Sphere & s = work.spheres[i];
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; ++p)
+        {
+            const Plane & plane = work.planes[p];
+            inside = plane.x * s.x + plane.y * s.y + plane.z * s.z + plane.d > -s.radius;
+        }
+        work.visible[i] = inside ? 1 : 0;
+    }
+}
+
+static float compute_item(int item)
+{
+    float value = float(item);
+    for (int k = 0; k < 256; ++k)
+        value = sinf(value) * 0.5f + cosf(value * 1.5f + float(k));
+    return value;
+}
+
+static void compute_range(void * user, int begin, int end)
+{
+    ComputeWork & work = *(ComputeWork *)user;
+    for (int i = begin; i < end; ++i)
+        work.results[i] = compute_item(i);
+}
+
+static void nested_child(void * user)
+{
+    NestedChild & child = *(NestedChild *)user;
+    compute_range(child.work, child.item, child.item + 1);
+}
+
+static void nested_parent(void * user)
+{
+    NestedParent & parent = *(NestedParent *)user;
+    NestedChild children[NESTED_CHILDREN];
+    JobCounter counter;
+    job_counter_init(counter);
+    for (int i = 0; i < NESTED_CHILDREN; ++i)
+    {
+        children[i].work = parent.work;
+        children[i].item = parent.first + i;
+        job_system_run(*parent.system, "nested child", nested_child, &children[i], &counter);
+    }
+    job_system_wait(*parent.system, counter);
+}
+
+static void run_nested(JobSystem & system, ComputeWork & work)
+{
+    NestedParent parents[NESTED_PARENTS];
+    JobCounter counter;
+    job_counter_init(counter);
+    for (int i = 0; i < NESTED_PARENTS; ++i)
+    {
+        parents[i].system = &system;
+        parents[i].work = &work;
+        parents[i].first = i * NESTED_CHILDREN;
+        job_system_run(system, "nested parent", nested_parent, &parents[i], &counter);
+    }
+    job_system_wait(system, counter);
+}
+
+int main(int argc, char ** argv)
+{
+    int runs = 5;
+    int maxThreads = int(std::thread::hardware_concurrency());
+    bool pin = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+            runs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            maxThreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--pin") == 0)
+            pin = true;
+        else
+        {
+            fprintf(stderr, "Usage: %s [--runs N] [--threads N] [--pin]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (runs < 1 || maxThreads < 1)
+    {
+        fprintf(stderr, "Usage: %s [--runs N] [--threads N] [--pin]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<Sphere> spheres(SPHERE_COUNT);
+    srand(1);
+    for (int i = 0; i < SPHERE_COUNT; ++i)
+    {
+        spheres[i].x = rand() / float(RAND_MAX) * 200.f - 100.f;
+        spheres[i].y = rand() / float(RAND_MAX) * 200.f - 100.f;
+        spheres[i].z = rand() / float(RAND_MAX) * 200.f - 100.f;
+        spheres[i].radius = rand() / float(RAND_MAX) * 2.f;
+    }
+    // A 90 degree frustum looking down -z, near 0.1 and far 100
+    const float c = 0.70710678f;
+    Plane planes[6] = {{c, 0, -c, 0}, {-c, 0, -c, 0}, {0, c, -c, 0}, {0, -c, -c, 0}, {0, 0, -1, -0.1f}, {0, 0, 1, 100.f}};
+    std::vector<unsigned char> visible(SPHERE_COUNT);
+    CullWork cull = {&spheres[0], planes, &visible[0]};
+    std::vector<float> results(COMPUTE_COUNT);
+    ComputeWork compute = {&results[0]};
+
+    const char * names[3] = {"cull", "compute", "nested"};
+    double baseline[3] = {0.0, 0.0, 0.0};
+    if (pin)
+        job_system_pin_thread(0);
+    fprintf(stdout, "%-8s %8s %10s %8s %10s\n", "workload", "threads", "ms", "speedup", "efficiency");
+    for (int threads = 1; threads <= maxThreads; ++threads)
+    {
+        JobSystem system;
+        job_system_init(system, threads - 1, pin);
+        for (int w = 0; w < 3; ++w)
+        {
+            double best = 0.0;
+            for (int run = 0; run < runs; ++run)
+            {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                if (w == 0)
+                    job_system_parallel_for(system, "cull", SPHERE_COUNT, 16 * 1024, cull_range, &cull);
+                else if (w == 1)
+                    job_system_parallel_for(system, "compute", COMPUTE_COUNT, 256, compute_range, &compute);
+                else
+                    run_nested(system, compute);
+                double time = elapsed_ms(start);
+                if (run == 0 || time < best)
+                    best = time;
+            }
+            if (threads == 1)
+                baseline[w] = best;
+            double speedup = baseline[w] / best;
+            fprintf(stdout, "%-8s %8d %10.2f %8.2f %9.0f%%\n", names[w], threads, best, speedup, 100.0 * speedup / threads);
+        }
+        job_system_release(system);
+    }
+
+    // Keep the results alive
+    size_t visibleCount = 0;
+    for (int i = 0; i < SPHERE_COUNT; ++i)
+        visibleCount += visible[i];
+    fprintf(stdout, "%d of %d spheres visible, checksum %f\n", int(visibleCount), SPHERE_COUNT, results[COMPUTE_COUNT - 1]);
+    return 0;
+}
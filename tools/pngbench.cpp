@@ -0,0 +1,136 @@
+// pngbench : time the bundled png decoder on a set of images
+//
+//   pngbench [--runs N] image.png...      e.g. pngbench textures/*.png
+//
+// The files are read once, then decoded from memory so only the decoder is timed :
+// first every image in turn on the main thread, then all of them at once on the
+// thread pool, the way aogl loads its textures at startup. Throughput is given in
+// MB of decoded pixels per second, best of N runs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+
+#include "stb/stb_image.h"
+
+#include "threadpool.h"
+
+struct BenchImage
+{
+    const char * path;
+    std::vector<unsigned char> file;
+    size_t decodedBytes;
+    bool failed;
+};
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool read_file(const char * path, std::vector<unsigned char> & data)
+{
+    FILE * f = fopen(path, "rb");
+    if (!f)
+        return false;
+    fseek(f, 0, SEEK_END);
+    data.resize(ftell(f));
+    fseek(f, 0, SEEK_SET);
+    bool ok = fread(data.data(), 1, data.size(), f) == data.size();
+    fclose(f);
+    return ok;
+}
+
+static void decode_task(void * user)
+{
+    BenchImage & image = *(BenchImage *)user;
+    int width, height, components;
+    unsigned char * pixels = stbi_load_from_memory(image.file.data(), int(image.file.size()), &width, &height, &components, 0);
+    if (!pixels)
+    {
+        fprintf(stderr, "Image %s : %s\n", image.path, stbi_failure_reason());
+        image.failed = true;
+        return;
+    }
+    image.decodedBytes = size_t(width) * height * components;
+    stbi_image_free(pixels);
+}
+
+int main(int argc, char ** argv)
+{
+    int runs = 5;
+    int argi = 1;
+    if (argc > 2 && strcmp(argv[1], "--runs") == 0)
+    {
+        runs = atoi(argv[2]);
+        argi = 3;
+    }
+    if (argi >= argc || runs < 1)
+    {
+        fprintf(stderr, "Usage: %s [--runs N] image.png...\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<BenchImage> images(argc - argi);
+    size_t fileBytes = 0;
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        images[i].path = argv[argi + i];
+        images[i].decodedBytes = 0;
+        images[i].failed = false;
+        if (!read_file(images[i].path, images[i].file))
+        {
+            fprintf(stderr, "Can not read %s\n", images[i].path);
+            return 1;
+        }
+        fileBytes += images[i].file.size();
+    }
+
+    // One thread, per image
+    double serialTime = 0.0;
+    size_t decodedBytes = 0;
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        double best = 0.0;
+        for (int run = 0; run < runs; ++run)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            decode_task(&images[i]);
+            double time = elapsed_ms(start);
+            if (run == 0 || time < best)
+                best = time;
+        }
+        if (images[i].failed)
+            return 1;
+        fprintf(stdout, "%s : %.2f ms, %.1f MB/s\n", images[i].path, best, images[i].decodedBytes / (best * 1000.0));
+        serialTime += best;
+        decodedBytes += images[i].decodedBytes;
+    }
+
+    // Every image at once on the pool
+    ThreadPool pool;
+    thread_pool_init(pool, 0);
+    double parallelTime = 0.0;
+    for (int run = 0; run < runs; ++run)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < images.size(); ++i)
+            thread_pool_push(pool, decode_task, &images[i]);
+        thread_pool_wait(pool);
+        double time = elapsed_ms(start);
+        if (run == 0 || time < parallelTime)
+            parallelTime = time;
+    }
+    int threadCount = int(pool.threads.size());
+    thread_pool_release(pool);
+    for (size_t i = 0; i < images.size(); ++i)
+        if (images[i].failed)
+            return 1;
+
+    fprintf(stdout, "%d images, %.1f MB compressed, %.1f MB decoded\n", int(images.size()), fileBytes / 1e6, decodedBytes / 1e6);
+    fprintf(stdout, "One thread : %.2f ms, %.1f MB/s\n", serialTime, decodedBytes / (serialTime * 1000.0));
+    fprintf(stdout, "Pool of %d threads : %.2f ms, %.1f MB/s\n", threadCount, parallelTime, decodedBytes / (parallelTime * 1000.0));
+    return 0;
+}
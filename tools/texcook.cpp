@@ -0,0 +1,102 @@
+// texcook : compress an image into a .ktx texture with its whole mip chain
+//
+//   texcook [--usage color|color-alpha|mask|normal] input output.ktx
+//
+// The usage picks the block format from the channels the shaders actually read :
+//   color        BC1, rgb, alpha dropped (default)
+//   color-alpha  BC7, rgba
+//   mask         BC4, red only, for specular and other single channel maps
+//   normal       BC5, red and green, z rebuilt in the shader
+// Mips are box filtered on the cpu from the uncompressed levels then each level is
+// compressed, so aogl uploads them as is instead of calling glGenerateMipmap.
+// Prints the sizes against the uncompressed rgba chain and the time of each step.
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "stb/stb_image.h"
+
+#include "texcompress.h"
+#include "ktx.h"
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char ** argv)
+{
+    TextureCodec codec = TEXTURE_BC1;
+    int argi = 1;
+    if (argc == 5 && strcmp(argv[1], "--usage") == 0)
+    {
+        if (strcmp(argv[2], "color") == 0)
+            codec = TEXTURE_BC1;
+        else if (strcmp(argv[2], "color-alpha") == 0)
+            codec = TEXTURE_BC7;
+        else if (strcmp(argv[2], "mask") == 0)
+            codec = TEXTURE_BC4;
+        else if (strcmp(argv[2], "normal") == 0)
+            codec = TEXTURE_BC5;
+        else
+        {
+            fprintf(stderr, "Unknown usage %s\n", argv[2]);
+            return 1;
+        }
+        argi = 3;
+    }
+    if (argc - argi != 2)
+    {
+        fprintf(stderr, "Usage: %s [--usage color|color-alpha|mask|normal] input output.ktx\n", argv[0]);
+        return 1;
+    }
+    const char * input = argv[argi];
+    const char * output = argv[argi + 1];
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int width, height, components;
+    unsigned char * pixels = stbi_load(input, &width, &height, &components, 0);
+    if (!pixels)
+    {
+        fprintf(stderr, "Texture %s : %s\n", input, stbi_failure_reason());
+        return 1;
+    }
+    RgbaImage base;
+    rgba_image_from_pixels(base, pixels, width, height, components);
+    stbi_image_free(pixels);
+    double decodeTime = elapsed_ms(start);
+
+    start = std::chrono::steady_clock::now();
+    std::vector<RgbaImage> images;
+    rgba_image_mip_chain(base, images);
+    double mipTime = elapsed_ms(start);
+
+    start = std::chrono::steady_clock::now();
+    std::vector< std::vector<unsigned char> > levels(images.size());
+    size_t rawSize = 0;
+    size_t compressedSize = 0;
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        texture_compress(images[i], codec, levels[i]);
+        rawSize += images[i].pixels.size();
+        compressedSize += levels[i].size();
+    }
+    double compressTime = elapsed_ms(start);
+
+    if (images.size() > KTX_MAX_LEVELS)
+    {
+        fprintf(stderr, "%s : %zu levels, at most %u are supported\n", input, images.size(), KTX_MAX_LEVELS);
+        return 1;
+    }
+    if (!ktx_write(output, texture_codec_internal_format(codec), texture_codec_base_format(codec), width, height, levels))
+    {
+        fprintf(stderr, "Can not write %s\n", output);
+        return 1;
+    }
+
+    fprintf(stdout, "%s : %dx%d, %d channels -> %s, %zu levels\n", output, width, height, components, texture_codec_name(codec), levels.size());
+    fprintf(stdout, "    %zu bytes, %zu uncompressed rgba (%.1f:1)\n", compressedSize, rawSize, double(rawSize) / double(compressedSize));
+    fprintf(stdout, "    decode %.2f ms, mips %.2f ms, compress %.2f ms\n", decodeTime, mipTime, compressTime);
+    return 0;
+}
@@ -0,0 +1,77 @@
+// vtcook : lay cooked textures out in a virtual texture and write its tiled page cache
+//
+//   vtcook output.aovt diffuse.ktx specular.ktx [diffuse.ktx specular.ktx...]
+//
+// Each pair of textures cooked by texcook makes a material, in argument order, so the
+// material index passed to the renderer is the pair index. The textures of a material
+// must be square powers of two of the same size, all diffuse textures of one block format
+// and all specular textures of another. For the demo :
+//
+//   vtcook textures/spnza.aovt textures/spnza_bricks_a_diff.ktx textures/spnza_bricks_a_spec.ktx
+//                              textures/spnza_bricks_b_diff.ktx textures/spnza_bricks_a_spec.ktx
+//
+// Pages are VT_PAGE_TEXELS wide plus a border of one block, copied from the compressed
+// levels as is. Prints the layout, the page count and the time taken.
+
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+#include "ktx.h"
+#include "vtfile.h"
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc < 4 || (argc - 2) % 2 != 0)
+    {
+        fprintf(stderr, "Usage: %s output.aovt diffuse.ktx specular.ktx [diffuse.ktx specular.ktx...]\n", argv[0]);
+        return 1;
+    }
+    const char * output = argv[1];
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int textureCount = argc - 2;
+    std::vector<KtxView> views(textureCount);
+    std::vector<const KtxView *> diffuse;
+    std::vector<const KtxView *> specular;
+    for (int i = 0; i < textureCount; ++i)
+    {
+        if (!ktx_map(views[i], argv[i + 2]))
+        {
+            fprintf(stderr, "Can not read %s, cook it with texcook\n", argv[i + 2]);
+            return 1;
+        }
+        if (i % 2 == 0)
+            diffuse.push_back(&views[i]);
+        else
+            specular.push_back(&views[i]);
+    }
+
+    bool ok = vt_file_write(output, diffuse, specular);
+    for (int i = 0; i < textureCount; ++i)
+        ktx_unmap(views[i]);
+    if (!ok)
+    {
+        fprintf(stderr, "Can not write %s\n", output);
+        return 1;
+    }
+
+    VtFileView view;
+    if (!vt_file_map(view, output))
+        return 1;
+    const VtFileHeader & header = *view.header;
+    for (unsigned int i = 0; i < header.materialCount; ++i)
+    {
+        const VtMaterial & material = view.materials[i];
+        fprintf(stdout, "Material %u : %s, %ux%u pages at %u %u\n", i, argv[2 + 2 * i], material.pages, material.pages, material.x, material.y);
+    }
+    fprintf(stdout, "%s : %ux%u pages of %d texels, %u levels, %u pages stored, %.2f MB, %.2f ms\n", output,
+            header.pages, header.pages, VT_PAGE_TEXELS, header.levelCount, header.pageCount, view.file.size / (1024. * 1024.), elapsed_ms(start));
+    vt_file_unmap(view);
+    return 0;
+}